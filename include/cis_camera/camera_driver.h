@@ -76,13 +76,26 @@
 #include <libuvc/libuvc.h>
 
 #include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
 #include <image_transport/image_transport.h>
 #include <image_transport/camera_publisher.h>
 #include <dynamic_reconfigure/server.h>
 #include <camera_info_manager/camera_info_manager.h>
+#include <pluginlib/class_loader.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+
+#include <atomic>
 
 #include <cis_camera/CISCameraConfig.h>
+#include <cis_camera/driver_settings.h>
+#include <cis_camera/message_pool.h>
+#include <cis_camera/thread_pool.h>
+#include <cis_camera/frame_workers.h>
+#include <cis_camera/frame_processor.h>
+#include <cis_camera/stage_timer.h>
+#include <cis_camera/HeightMap.h>
 
 
 namespace cis_camera
@@ -117,6 +130,64 @@ private:
     Running = 2,
   };
   
+  // Ordered sections of a frame, run in capture order when frames are processed concurrently.
+  // The ordered frame processor stages come first, one section each (see frameSection).
+  enum FrameSection
+  {
+    FrameSectionChange  = 0, // change-triggered publishing, compares to the last published depth
+    FrameSectionPublish = 1, // publishing all outputs of the frame
+    FrameSections       = 2,
+  };
+  
+  /**
+   * @brief FrameJob is a copied camera frame waiting for (or in) processFrame.
+   */
+  struct FrameJob
+  {
+    sensor_msgs::Image::Ptr image;
+    ros::Time               timestamp;
+    DriverSettingsConstPtr  settings;
+  };
+  
+  /**
+   * @brief FrameWorkspace holds the pooled messages and scratch buffers of one frame
+   * processing thread: the USB thread, or each frame worker.
+   */
+  struct FrameWorkspace
+  {
+    // Pooled Camera Info messages
+    MessagePool<sensor_msgs::CameraInfo> cinfo_pool;
+    MessagePool<sensor_msgs::CameraInfo> cinfo_ir_pool;
+    MessagePool<sensor_msgs::CameraInfo> cinfo_depth_pool;
+    MessagePool<sensor_msgs::CameraInfo> cinfo_color_pool;
+    
+    // Pooled images of the optional outputs
+    MessagePool<sensor_msgs::Image> ir_rect_pool;
+    MessagePool<sensor_msgs::Image> color_rect_pool;
+    MessagePool<sensor_msgs::Image> normals_pool;
+    MessagePool<sensor_msgs::Image> upsampled_pool;
+    
+    // Luma guide and sparse registered depth of the depth upsampling
+    std::vector<uint8_t>  upsample_guide;
+    std::vector<uint16_t> upsample_sparse;
+    
+    // Pooled laser scans and height maps, and the height map builder
+    MessagePool<sensor_msgs::LaserScan> scan_pool;
+    MessagePool<cis_camera::HeightMap>  heightmap_pool;
+    HeightMapBuilder                    heightmap_builder;
+    
+    // Pooled compact point clouds
+    MessagePool<sensor_msgs::PointCloud2> cloud_pool;
+    
+    // Workers for the data parallel parts of a frame, created on first use
+    int                           threads;
+    boost::shared_ptr<ThreadPool> pool;
+    
+    FrameWorkspace() : threads( 0 ) {}
+    
+    ThreadPool& workerPool();
+  };
+  
   // Flags controlling whether the sensor needs to be stopped (or reopened) when changing settings
   static const int ReconfigureClose   = 3; // Need to close and reopen sensor to change this setting
   static const int ReconfigureStop    = 1; // Need to stop the stream before changing this setting
@@ -127,13 +198,44 @@ private:
   void OpenCamera();
   void CloseCamera();
   
+  // Build a new settings snapshot and publish it to the frame path
+  void updateSettings();
+  DriverSettingsConstPtr loadSettings() const;
+  
+  // Build the prebuilt camera infos and depth rays, reusing calibration_ when unchanged
+  CalibrationConstPtr buildCalibration( const DriverSettings& settings );
+  void CalibrationTimerCallback( const ros::TimerEvent& event );
+  
+  // Auto-suspend of the USB stream without subscribers
+  int  countSubscribers() const;
+  void ImageConnectCallback( const image_transport::SingleSubscriberPublisher& pub );
+  void ConnectCallback( const ros::SingleSubscriberPublisher& pub );
+  void updateStreaming();
+  void SuspendTimerCallback( const ros::TimerEvent& event );
+  void suspendStreaming();
+  void resumeStreaming();
+  
   // Accept a reconfigure request from a client
   void ReconfigureCallback( CISCameraConfig &config, uint32_t level );
   
   // Accept a new image frame from the camera
-  void filterDepthImage( sensor_msgs::ImagePtr& msg );
+  bool checkDepthChange( const sensor_msgs::Image& depth, const DriverSettings& settings,
+                         sensor_msgs::Image::Ptr& mask );
   void ImageCallback( uvc_frame_t *frame );
   static void ImageCallbackAdapter( uvc_frame_t *frame, void *ptr );
+  void processFrame( FrameJob& job, FrameWorkspace& ws, FrameTicket& ticket );
+  
+  // Frame-level parallelism, whole frames on the frame workers
+  void startFrameWorkers();
+  void stopFrameWorkers();
+  
+  // Section index of the ticket, after one section per frame processor stage
+  size_t frameSection( FrameSection section ) const { return processors_.size() + section; }
+  
+  // Frame processor stages loaded with pluginlib
+  void loadProcessors();
+  bool runProcessors( FrameView& view, FrameTicket& ticket );
+  void ProcessorReportCallback( const ros::TimerEvent& event );
   
   enum uvc_extention_unit_control_number
   {
@@ -229,6 +331,9 @@ private:
   ros::Publisher pub_tof_t2_;
   
   ros::Timer temp_timer_;
+  ros::Timer calib_timer_;
+  ros::Timer suspend_timer_;
+  ros::Timer report_timer_;
   
   static void TemperatureCallback( void* ptr );
   
@@ -239,9 +344,14 @@ private:
   
   ros::NodeHandle nh_, priv_nh_;
   
+  // state_ and the camera controls are guarded by mutex_, which is also held by
+  // dynamic_reconfigure while ReconfigureCallback runs. The frame path never locks it.
   State                  state_;
   boost::recursive_mutex mutex_;
   
+  // Settings snapshot read by the frame path, swapped atomically (RCU style)
+  DriverSettingsConstPtr settings_;
+  
   uvc_context_t       *ctx_;
   uvc_device_t        *dev_;
   uvc_device_handle_t *devh_;
@@ -252,12 +362,33 @@ private:
   image_transport::CameraPublisher pub_color_;
   image_transport::CameraPublisher pub_depth_;
   image_transport::CameraPublisher pub_ir_;
+  image_transport::Publisher       pub_ir_rect_;
+  image_transport::Publisher       pub_color_rect_;
+  image_transport::Publisher       pub_normals_;
+  image_transport::CameraPublisher pub_upsampled_;
+  image_transport::Publisher       pub_change_mask_;
+  ros::Publisher                   pub_scan_;
+  ros::Publisher                   pub_heightmap_;
+  ros::Publisher                   pub_cloud_;
   
   dynamic_reconfigure::Server<CISCameraConfig> config_server_;
   
   CISCameraConfig config_;
   bool            config_changed_;
   
+  // Auto-suspend: suspended_ and stream_ctrl_ are guarded by mutex_, the
+  // resume time is handed to the frame path to measure the first frame
+  bool                  auto_suspend_;
+  double                suspend_grace_;
+  bool                  suspend_laser_off_;
+  bool                  suspended_;
+  uvc_stream_ctrl_t     stream_ctrl_;
+  std::atomic<bool>     resume_pending_;
+  std::atomic<uint64_t> resume_start_ns_;
+  
+  // Time between frames of the opened stream [s], guarded by mutex_
+  double frame_period_;
+  
   camera_info_manager::CameraInfoManager cinfo_manager_;
   camera_info_manager::CameraInfoManager cinfo_manager_ir_;
   camera_info_manager::CameraInfoManager cinfo_manager_depth_;
@@ -268,7 +399,36 @@ private:
   std::string camera_info_url_depth_;
   std::string camera_info_url_color_;
   
-  double r_gain_, g_gain_, b_gain_;
+  // Last calibration built by buildCalibration (guarded by mutex_)
+  CalibrationConstPtr calibration_;
+  
+  // Last published depth, tile sums and pooled masks of the change-triggered publishing,
+  // owned by the FrameSectionChange section of the frame path
+  MessagePool<sensor_msgs::Image> change_mask_pool_;
+  std::vector<uint16_t> change_reference_;
+  std::vector<uint32_t> change_sad_;
+  ros::Time             change_published_;
+  
+  // Frame processor stages, loaded once at startup. The loader outlives the stages.
+  struct ProcessorStage
+  {
+    std::string                       name;
+    boost::shared_ptr<FrameProcessor> processor;
+    bool                              ordered;
+  };
+  
+  pluginlib::ClassLoader<FrameProcessor> processor_loader_;
+  std::vector<ProcessorStage>            processors_;
+  StageTimer                             processor_timer_;
+  double                                 processor_report_;
+  
+  // Workspace of the frames processed on the USB thread
+  int            worker_threads_;
+  FrameWorkspace workspace_;
+  
+  // Frame workers with one workspace each, NULL without frame_workers
+  boost::shared_ptr<FrameWorkers<FrameJob> >     frame_workers_;
+  std::vector<boost::shared_ptr<FrameWorkspace> > worker_workspaces_;
   
 };
 
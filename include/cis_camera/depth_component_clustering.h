@@ -0,0 +1,105 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+
+#include <cis_camera/thread_pool.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief DepthComponentClustering clusters an organized camera cloud by connected
+ * components on the image grid. Two 4-neighbor pixels are connected when both are
+ * valid and their depths differ by at most depth_jump times the nearer depth.
+ * Rows are split into strips labeled in parallel with union-find, the strip
+ * borders are merged afterwards, so the cost is linear in pixels with no search tree.
+ */
+class DepthComponentClustering
+{
+public:
+
+  typedef pcl::PointXYZ           Point;
+  typedef pcl::PointCloud<Point>  Cloud;
+
+  DepthComponentClustering();
+
+  void setDepthJump( float depth_jump ) { depth_jump_ = depth_jump; }
+  void setMinClusterSize( int size ) { min_size_ = size; }
+  void setMaxClusterSize( int size ) { max_size_ = size; }
+
+  /**
+   * @brief segment finds the connected components of the valid pixels.
+   * @param cloud const Cloud& organized cloud in the camera frame (z is the depth)
+   * @param valid const std::vector<uint8_t>& non-zero for pixels to cluster
+   * @param clusters std::vector<pcl::PointIndices>& pixel indices per cluster, largest first
+   * @param pool ThreadPool* pool to label the strips on, NULL runs on the calling thread
+   */
+  void segment( const Cloud& cloud, const std::vector<uint8_t>& valid,
+                std::vector<pcl::PointIndices>& clusters, ThreadPool* pool = NULL );
+
+private:
+
+  int  find( int i ) const;
+  void unite( int a, int b );
+
+  bool connected( const Point& a, const Point& b ) const
+  {
+    float near = a.z < b.z ? a.z : b.z;
+    float diff = a.z - b.z;
+    return -depth_jump_ * near <= diff && diff <= depth_jump_ * near;
+  }
+
+  void labelStrip( const Cloud& cloud, const std::vector<uint8_t>& valid, int row_begin, int row_end );
+
+  float depth_jump_;
+  int   min_size_;
+  int   max_size_;
+
+  // Kept across frames
+  std::vector<int> parent_;
+  std::vector<int> root_;
+  std::vector<int> size_;
+  std::vector<int> cluster_of_root_;
+};
+
+};
@@ -0,0 +1,65 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <string>
+
+#include <ros/ros.h>
+
+#include <cis_camera/frame_processor.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief DepthEdgeFilter invalidates the depth on edges, where mixed pixels fly
+ * between foreground and background. The depth is blurred, edges are extracted
+ * with Sobel or Laplacian filters and an Otsu threshold, dilated, and cleared.
+ * It is the built-in depth filter, controlled by depth_filter, blur_mode,
+ * edge_mode and dilate_iterations of dynamic_reconfigure.
+ */
+class DepthEdgeFilter : public FrameProcessor
+{
+public:
+  
+  virtual void initialize( const std::string& name, ros::NodeHandle nh, ros::NodeHandle priv_nh ) {}
+  
+  virtual bool process( FrameView& frame );
+  
+  // No state between frames
+  virtual bool ordered() const { return false; }
+};
+
+};
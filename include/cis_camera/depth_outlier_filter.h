@@ -0,0 +1,96 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include <cis_camera/thread_pool.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief DepthOutlierFilter removes speckles from an organized camera cloud using
+ * fixed image neighborhoods instead of a k-nearest-neighbor search.
+ * For each pixel the mean absolute depth difference to the valid pixels of a
+ * 3x3 or 5x5 window is computed. As in pcl::StatisticalOutlierRemoval, pixels
+ * whose mean exceeds the global mean plus stddev_mul standard deviations, or
+ * with fewer than min_neighbors valid neighbors, are outliers and set to NaN.
+ * The inner loops run branch free over padded rows so the compiler vectorizes
+ * them, and row strips are processed on a ThreadPool.
+ */
+class DepthOutlierFilter
+{
+public:
+
+  typedef pcl::PointXYZ           Point;
+  typedef pcl::PointCloud<Point>  Cloud;
+
+  DepthOutlierFilter();
+
+  void setWindowSize( int size ) { radius_ = size < 5 ? 1 : 2; }
+  void setStddevMulThresh( double stddev_mul ) { stddev_mul_ = stddev_mul; }
+  void setMinNeighbors( int neighbors ) { min_neighbors_ = neighbors; }
+
+  /**
+   * @brief filter sets the outliers of an organized cloud to NaN in place.
+   * @param cloud Cloud& organized cloud in the camera frame (z is the depth)
+   * @param pool ThreadPool* pool to run the row strips on, NULL runs on the calling thread
+   * @return size_t number of removed points
+   */
+  size_t filter( Cloud& cloud, ThreadPool* pool = NULL );
+
+private:
+
+  void meanStrip( int width, int row_begin, int row_end, double& sum, double& sum_sq, size_t& count );
+
+  int    radius_;
+  double stddev_mul_;
+  int    min_neighbors_;
+
+  // Padded depth and validity images and the per pixel mean difference, kept across frames
+  std::vector<float> depth_;
+  std::vector<float> valid_;
+  std::vector<float> mean_;
+  std::vector<float> neighbors_;
+};
+
+};
@@ -0,0 +1,251 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <sensor_msgs/CameraInfo.h>
+
+#include <cis_camera/image_kernels.h>
+#include <cis_camera/height_map.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief Calibration holds everything derived from the camera calibration.
+ * It is rebuilt only when the calibration changes, i.e. on reconfigure of the
+ * distortion parameters or when the CameraInfoManagers load new camera infos,
+ * and is shared by every settings snapshot in between.
+ */
+struct Calibration
+{
+  // Prebuilt Camera Infos with frame IDs and reconfigured intrinsics applied.
+  // The frame path only stamps the header of pooled copies of these.
+  sensor_msgs::CameraInfoConstPtr cinfo;
+  sensor_msgs::CameraInfoConstPtr cinfo_ir;
+  sensor_msgs::CameraInfoConstPtr cinfo_depth;
+  sensor_msgs::CameraInfoConstPtr cinfo_color;
+
+  // Depth/IR image size
+  int depth_width;
+  int depth_height;
+
+  // Per-pixel ray of the depth camera, built from the same intrinsics as cinfo_depth.
+  // A depth pixel with distance d from the camera element lies at
+  // z = d * ray_inv_norm, x = z * ray_x, y = z * ray_y.
+  std::vector<float> ray_x;
+  std::vector<float> ray_y;
+  std::vector<float> ray_inv_norm;
+
+  // Color output size after color_output_scale and the way it is resampled:
+  // 1 = converted as is, 2 or 4 = binned in factor x factor blocks, 0 = area filter
+  int color_width;
+  int color_height;
+  int color_binning;
+
+  // Cached area filters, only built when color_binning is 0
+  AreaWeights color_area_x;
+  AreaWeights color_area_y;
+
+  // Fixed-point rectification tables, only built while the rectified output is enabled
+  RemapTable rect_ir;
+  RemapTable rect_color;
+
+  // Depth band to laser scan table, only built while the scan output is enabled
+  ScanTable scan;
+
+  // Depth pixel directions in the height map frame, only built while the height map is enabled
+  HeightMapTable      heightmap;
+  std::vector<double> heightmap_pose;
+
+  // Color camera model and filter weights of the depth upsampling, only built while it is enabled
+  PinholeModel        upsample_color;
+  BilateralKernel     upsample_kernel;
+  std::vector<double> upsample_translation;
+
+  Calibration() : depth_width(0), depth_height(0), color_width(0), color_height(0), color_binning(1) {}
+};
+
+typedef boost::shared_ptr<const Calibration> CalibrationConstPtr;
+
+
+/**
+ * @brief DriverSettings is an immutable snapshot of everything the frame path needs.
+ * A new snapshot is built on every reconfigure or state transition and published
+ * to the frame path through an atomic shared pointer. ImageCallback loads it once
+ * per frame and never touches the ROS parameter server or the driver mutex.
+ */
+struct DriverSettings
+{
+  // Image Sizes
+  int frame_width;
+  int frame_height;
+  int color_width;
+
+  // Time between frames of the opened stream [s], 1 / frame_rate
+  double frame_period;
+
+  // Frame IDs
+  std::string frame_id;
+  std::string frame_id_ir;
+  std::string frame_id_depth;
+  std::string frame_id_color;
+  std::string frame_id_scan;
+  std::string frame_id_heightmap;
+
+  // RGB Camera Color Gains
+  double r_gain;
+  double g_gain;
+  double b_gain;
+
+  // Color output scale relative to the color crop of the frame
+  double color_output_scale;
+
+  // Depth Conversion Values acquired from the ToF Camera
+  double depth_cnv_gain;
+  short  depth_offset;
+
+  // Depth Image Filter
+  bool depth_filter;
+  int  blur_mode;
+  int  edge_mode;
+  int  dilate_iterations;
+
+  // IR/Depth Camera Distortion Correction
+  bool   ir_dist_reconfig;
+  double ir_fx, ir_fy, ir_cx, ir_cy;
+  double ir_k1, ir_k2, ir_k3, ir_p1, ir_p2;
+
+  // RGB Camera Distortion Correction
+  bool   rgb_dist_reconfig;
+  double rgb_fx, rgb_fy, rgb_cx, rgb_cy;
+  double rgb_k1, rgb_k2, rgb_k3, rgb_p1, rgb_p2;
+
+  // Rectification on Driver Software
+  bool rectify_ir;
+  bool rectify_color;
+
+  // Laser Scan on Driver Software
+  bool   scan_enable;
+  int    scan_center_row;
+  int    scan_height;
+  double scan_range_min;
+  double scan_range_max;
+
+  // Height Map on Driver Software, the pose of the depth frame in the height map frame
+  // is x y z yaw pitch roll as in static_transform_publisher
+  bool                heightmap_enable;
+  std::vector<double> heightmap_pose;
+  HeightMapGrid       heightmap_grid;
+
+  // Change-Triggered Publishing
+  bool   change_trigger;
+  double change_threshold;
+  int    change_min_tiles;
+  double change_keepalive;
+
+  // Depth Upsampling to the Color Grid on Driver Software, depth_to_color is the
+  // origin of the depth optical frame in the color optical frame [m]
+  bool                upsample_enable;
+  int                 upsample_radius;
+  double              upsample_sigma_space;
+  double              upsample_sigma_range;
+  std::vector<double> depth_to_color;
+
+  // Surface Normals on Driver Software
+  bool   normals_enable;
+  int    normals_radius;
+  double normals_max_depth_change;
+
+  // Compact Point Cloud on Driver Software, cloud_encoding is a CloudEncoding
+  bool cloud_enable;
+  int  cloud_encoding;
+  bool cloud_drop_invalid;
+
+  // Calibration derived data, shared between snapshots while it does not change
+  CalibrationConstPtr calibration;
+
+  DriverSettings() :
+      frame_width(1920),
+      frame_height(960),
+      color_width(1280),
+      frame_period(1.0 / 30.0),
+      r_gain(1.0),
+      g_gain(1.0),
+      b_gain(1.0),
+      color_output_scale(1.0),
+      depth_cnv_gain(0.0),
+      depth_offset(0),
+      depth_filter(false),
+      blur_mode(0),
+      edge_mode(0),
+      dilate_iterations(1),
+      ir_dist_reconfig(false),
+      ir_fx(0.0), ir_fy(0.0), ir_cx(0.0), ir_cy(0.0),
+      ir_k1(0.0), ir_k2(0.0), ir_k3(0.0), ir_p1(0.0), ir_p2(0.0),
+      rgb_dist_reconfig(false),
+      rgb_fx(0.0), rgb_fy(0.0), rgb_cx(0.0), rgb_cy(0.0),
+      rgb_k1(0.0), rgb_k2(0.0), rgb_k3(0.0), rgb_p1(0.0), rgb_p2(0.0),
+      rectify_ir(false),
+      rectify_color(false),
+      scan_enable(false),
+      scan_center_row(240),
+      scan_height(10),
+      scan_range_min(0.1),
+      scan_range_max(10.0),
+      heightmap_enable(false),
+      change_trigger(false),
+      change_threshold(20.0),
+      change_min_tiles(4),
+      change_keepalive(1.0),
+      upsample_enable(false),
+      upsample_radius(3),
+      upsample_sigma_space(1.5),
+      upsample_sigma_range(12.0),
+      normals_enable(false),
+      normals_radius(2),
+      normals_max_depth_change(0.05),
+      cloud_enable(false),
+      cloud_encoding(0),
+      cloud_drop_invalid(false)
+  {}
+};
+
+typedef boost::shared_ptr<const DriverSettings> DriverSettingsConstPtr;
+
+};
@@ -0,0 +1,133 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include "cis_camera/image_kernels.h"
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief FrameGeometry is the layout of a raw frame: a UYVY color crop on the left and
+ * the interlaced depth (even rows) and IR (odd rows) on the right, all GRAY16.
+ */
+struct FrameGeometry
+{
+  int frame_width;
+  int frame_height;
+  int color_width;
+  
+  FrameGeometry( int width = 0, int height = 0, int color = 0 ) :
+      frame_width(width), frame_height(height), color_width(color)
+  {}
+  
+  int depthWidth()  const { return frame_width - color_width; }
+  int depthHeight() const { return frame_height / 2; }
+};
+
+
+/**
+ * @brief FixedFrameLayout is a frame geometry known at compile time, so kernels
+ * specialized on it have constant row counts, widths and strides.
+ */
+template <int FRAME_WIDTH_, int FRAME_HEIGHT_, int COLOR_WIDTH_>
+struct FixedFrameLayout
+{
+  static const int FRAME_WIDTH  = FRAME_WIDTH_;
+  static const int FRAME_HEIGHT = FRAME_HEIGHT_;
+  static const int COLOR_WIDTH  = COLOR_WIDTH_;
+  static const int DEPTH_WIDTH  = FRAME_WIDTH_ - COLOR_WIDTH_;
+  static const int DEPTH_HEIGHT = FRAME_HEIGHT_ / 2;
+  
+  static bool matches( const FrameGeometry& geometry )
+  {
+    return geometry.frame_width  == FRAME_WIDTH  &&
+           geometry.frame_height == FRAME_HEIGHT &&
+           geometry.color_width  == COLOR_WIDTH;
+  }
+};
+
+// Frame of the CIS ToF camera: 1280x960 color and 640x480 depth/IR
+typedef FixedFrameLayout<1920, 960, 1280> DefaultFrameLayout;
+
+
+/**
+ * @brief FrameKernels is the table of the per-frame stages of one frame geometry.
+ * The generic table takes the geometry at runtime; the DefaultFrameLayout table only
+ * specializes the binning by 2, which gains from constant bounds, and ignores it there.
+ */
+struct FrameKernels
+{
+  const char* name;
+  
+  /**
+   * @brief convert_color converts the color crop to BGR8, see convertUYVYToBGR8.
+   */
+  void (*convert_color)( const uint16_t* frame, const FrameGeometry& geometry,
+                         const ColorGains& gains, uint8_t* dst, int dst_step );
+  
+  /**
+   * @brief bin_color converts the color crop to BGR8 averaging factor x factor blocks, see binUYVYToBGR8.
+   */
+  void (*bin_color)( const uint16_t* frame, const FrameGeometry& geometry, int factor,
+                     const ColorGains& gains, uint8_t* dst, int dst_step );
+  
+  /**
+   * @brief deinterlace splits the depth and IR rows into images, correcting the depth, see correctDepth.
+   * @param inv_norm const float* inverse ray norms of the depth image
+   * @param depth uint16_t* output depth image [mm]
+   * @param ir uint16_t* output IR image
+   */
+  void (*deinterlace)( const uint16_t* frame, const FrameGeometry& geometry, const float* inv_norm,
+                       double scale, double offset, uint16_t* depth, uint16_t* ir );
+};
+
+/**
+ * @brief genericFrameKernels returns the kernels for any geometry, running the active PixelKernels.
+ */
+const FrameKernels& genericFrameKernels();
+
+/**
+ * @brief frameKernels returns the kernels with the binning by 2 of the active PixelKernels specialized on
+ * DefaultFrameLayout when the geometry is that layout and the level has it, otherwise the generic kernels.
+ * @param geometry const FrameGeometry& frame geometry
+ * @return const FrameKernels& kernels
+ */
+const FrameKernels& frameKernels( const FrameGeometry& geometry );
+
+};
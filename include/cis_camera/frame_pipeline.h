@@ -0,0 +1,248 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief FramePipeline runs a chain of stages on its own threads, one thread per
+ * stage, so a stage works on frame N + 1 while the next stage works on frame N.
+ * Each stage has a bounded input queue. When a stage falls behind, pushing onto
+ * its full queue drops the oldest queued frame, so the latency stays bounded and
+ * the newest frames win. Frames come from a fixed pool created by start() and
+ * return to it after the last stage or when dropped, so no frame is allocated
+ * while running.
+ */
+template <typename Frame>
+class FramePipeline
+{
+public:
+
+  typedef boost::shared_ptr<Frame> FramePtr;
+
+  /**
+   * @brief Stage processes a frame in place, false ends the frame at this stage.
+   */
+  typedef std::function<bool( Frame& )> Stage;
+
+  /**
+   * @param queue_size size_t number of frames waiting in front of each stage
+   */
+  explicit FramePipeline( size_t queue_size = 1 ) :
+      queue_size_( queue_size < 1 ? 1 : queue_size ),
+      stop_( true ),
+      dropped_( 0 ),
+      completed_( 0 )
+  {
+  }
+
+  ~FramePipeline() { stop(); }
+
+  /**
+   * @brief addStage appends a stage, call before start().
+   */
+  void addStage( const Stage& stage ) { stages_.push_back( stage ); }
+
+  /**
+   * @brief start fills the frame pool and starts one thread per stage.
+   * @param factory const std::function<FramePtr()>& creates the frames of the pool
+   */
+  void start( const std::function<FramePtr()>& factory )
+  {
+    stop();
+
+    // Every stage holds at most queue_size waiting frames and one in work, plus one being filled
+    pool_.clear();
+    for ( size_t i = 0; i < stages_.size() * ( queue_size_ + 1 ) + 1; i++ )
+      pool_.push_back( factory() );
+
+    queues_.clear();
+    for ( size_t i = 0; i < stages_.size(); i++ )
+      queues_.push_back( boost::shared_ptr<Queue>( new Queue ) );
+
+    stop_ = false;
+    for ( size_t i = 0; i < stages_.size(); i++ )
+      threads_.push_back( std::thread( &FramePipeline::run, this, i ) );
+  }
+
+  /**
+   * @brief stop lets the stages finish their current frame and joins the threads.
+   * Queued frames are discarded.
+   */
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      stop_ = true;
+    }
+
+    for ( size_t i = 0; i < queues_.size(); i++ )
+      queues_[i]->ready.notify_all();
+
+    for ( size_t i = 0; i < threads_.size(); i++ )
+      threads_[i].join();
+    threads_.clear();
+  }
+
+  bool running() const { return not threads_.empty(); }
+
+  /**
+   * @brief acquire takes a free frame from the pool to fill in.
+   * @return FramePtr frame, to be handed to push() or release()
+   */
+  FramePtr acquire()
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    FramePtr frame;
+    if ( not pool_.empty() )
+    {
+      frame = pool_.back();
+      pool_.pop_back();
+    }
+    return frame;
+  }
+
+  /**
+   * @brief release returns an acquired frame which is not pushed to the pool.
+   */
+  void release( const FramePtr& frame )
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    pool_.push_back( frame );
+  }
+
+  /**
+   * @brief push hands a filled frame to the first stage.
+   */
+  void push( const FramePtr& frame ) { enqueue( 0, frame ); }
+
+  // Frames dropped from full queues and frames through all stages
+  size_t dropped() const
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return dropped_;
+  }
+
+  size_t completed() const
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return completed_;
+  }
+
+private:
+
+  struct Queue
+  {
+    std::deque<FramePtr>    frames;
+    std::condition_variable ready;
+  };
+
+  void enqueue( size_t stage, const FramePtr& frame )
+  {
+    Queue& queue = *queues_[ stage ];
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+
+      // Drop the oldest frame, the stage is behind
+      if ( queue_size_ <= queue.frames.size() )
+      {
+        pool_.push_back( queue.frames.front() );
+        queue.frames.pop_front();
+        dropped_++;
+      }
+      queue.frames.push_back( frame );
+    }
+    queue.ready.notify_one();
+  }
+
+  void run( size_t stage )
+  {
+    Queue& queue = *queues_[ stage ];
+
+    while ( true )
+    {
+      FramePtr frame;
+      {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        queue.ready.wait( lock, [&]() { return stop_ || not queue.frames.empty(); } );
+        if ( stop_ )
+          return;
+
+        frame = queue.frames.front();
+        queue.frames.pop_front();
+      }
+
+      bool next = stages_[ stage ]( *frame );
+
+      if ( next && stage + 1 < stages_.size() )
+      {
+        enqueue( stage + 1, frame );
+        continue;
+      }
+
+      std::lock_guard<std::mutex> lock( mutex_ );
+      pool_.push_back( frame );
+      if ( next )
+        completed_++;
+    }
+  }
+
+  size_t                                  queue_size_;
+  std::vector<Stage>                      stages_;
+  std::vector<boost::shared_ptr<Queue> >  queues_;
+  std::vector<std::thread>                threads_;
+  std::vector<FramePtr>                   pool_;
+
+  // One lock for the queues, the pool and the counters, taken only between stages
+  mutable std::mutex  mutex_;
+  bool                stop_;
+  size_t              dropped_;
+  size_t              completed_;
+};
+
+};
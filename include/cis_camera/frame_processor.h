@@ -0,0 +1,126 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include <ros/ros.h>
+
+#include <cis_camera/driver_settings.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief ImagePlane is a view of an image plane owned by the frame, no pixel is copied.
+ * step is the distance between rows in elements of T.
+ */
+template <typename T>
+struct ImagePlane
+{
+  T*  data;
+  int width;
+  int height;
+  int step;
+
+  ImagePlane() : data( NULL ), width( 0 ), height( 0 ), step( 0 ) {}
+  ImagePlane( T* data, int width, int height, int step ) :
+      data( data ), width( width ), height( height ), step( step ) {}
+
+  T*   row( int v ) const { return data + v * step; }
+  bool empty() const { return data == NULL; }
+};
+
+/**
+ * @brief FrameView is what a FrameProcessor sees of a frame: views of the planes of the
+ * images about to be published, plus the settings snapshot and calibration of the frame.
+ * depth, ir and color may be modified in place; the following stages, the driver
+ * outputs (scan, normals, clouds, ...) and the published images all see the changes.
+ * raw is the frame as received and stays read-only.
+ */
+struct FrameView
+{
+  ros::Time stamp;
+
+  ImagePlane<const uint16_t> raw;    // 16UC1 combined frame, e.g. 1920x960
+  ImagePlane<uint16_t>       depth;  // 16UC1 depth from the camera plane [mm], 0 = invalid
+  ImagePlane<uint16_t>       ir;     // 16UC1 IR
+  ImagePlane<uint8_t>        color;  // bgr8, width in pixels, step in bytes
+
+  const DriverSettings* settings;
+  const Calibration*    calibration;
+
+  FrameView() : settings( NULL ), calibration( NULL ) {}
+};
+
+/**
+ * @brief FrameProcessor is a processing stage run inside the driver on every frame,
+ * loaded with pluginlib ("cis_camera::FrameProcessor" classes listed in the processors
+ * parameter) and run in the listed order after the depth correction.
+ * With frame_workers, frames are processed concurrently: an ordered() stage runs for one
+ * frame at a time in capture order, other stages may run for several frames at once.
+ */
+class FrameProcessor
+{
+public:
+
+  virtual ~FrameProcessor() {}
+
+  /**
+   * @brief initialize is called once after loading, before the first frame.
+   * @param name const std::string& stage name, also the namespace of priv_nh
+   * @param nh ros::NodeHandle node handle of the driver, e.g. to advertise results
+   * @param priv_nh ros::NodeHandle private node handle of the stage
+   */
+  virtual void initialize( const std::string& name, ros::NodeHandle nh, ros::NodeHandle priv_nh ) = 0;
+
+  /**
+   * @brief process runs the stage on a frame.
+   * @param frame FrameView& views of the frame planes
+   * @return bool false drops the frame, nothing of it is published
+   */
+  virtual bool process( FrameView& frame ) = 0;
+
+  /**
+   * @brief ordered tells whether the stage keeps state between frames and must see
+   * the frames one at a time in capture order.
+   */
+  virtual bool ordered() const { return true; }
+};
+
+};
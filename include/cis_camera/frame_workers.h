@@ -0,0 +1,363 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief FrameSequencer orders sections of frames processed concurrently.
+ * Every frame has a sequence number and passes each section once, in the
+ * order of the sections. A frame enters a section only after every earlier
+ * frame left it, so a stateful stage (a temporal filter, the change-triggered
+ * reference, publishing) sees the frames in capture order.
+ */
+class FrameSequencer
+{
+public:
+
+  explicit FrameSequencer( size_t sections = 1 ) : next_( sections, 0 ) {}
+
+  size_t sections() const { return next_.size(); }
+
+  /**
+   * @brief reset restarts every section at sequence 0, call while no frame is in flight.
+   */
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    std::fill( next_.begin(), next_.end(), 0 );
+  }
+
+  /**
+   * @brief enter blocks until every frame before sequence left section.
+   */
+  void enter( size_t section, uint64_t sequence )
+  {
+    std::unique_lock<std::mutex> lock( mutex_ );
+    turn_.wait( lock, [&]() { return next_[ section ] == sequence; } );
+  }
+
+  /**
+   * @brief leave lets the frame after sequence enter section.
+   */
+  void leave( size_t section, uint64_t sequence )
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      next_[ section ] = sequence + 1;
+    }
+    turn_.notify_all();
+  }
+
+private:
+
+  std::mutex              mutex_;
+  std::condition_variable turn_;
+  std::vector<uint64_t>   next_;
+};
+
+
+/**
+ * @brief FrameTicket is the passage of one frame through the ordered sections
+ * of a FrameSequencer. Sections are run in increasing order; sections a frame
+ * skips (e.g. a frame dropped early) are passed when a later section is run or
+ * when the ticket is finished, so later frames never wait for it. Without a
+ * sequencer the sections simply run in place.
+ */
+class FrameTicket
+{
+public:
+
+  FrameTicket() : sequencer_( NULL ), sequence_( 0 ), section_( 0 ) {}
+
+  FrameTicket( FrameSequencer* sequencer, uint64_t sequence ) :
+      sequencer_( sequencer ), sequence_( sequence ), section_( 0 ) {}
+
+  ~FrameTicket() { finish(); }
+
+  uint64_t sequence() const { return sequence_; }
+
+  /**
+   * @brief ordered runs fn in section once every earlier frame left the section.
+   */
+  void ordered( size_t section, const std::function<void()>& fn )
+  {
+    if ( not sequencer_ )
+    {
+      fn();
+      return;
+    }
+
+    pass( section );
+
+    sequencer_->enter( section, sequence_ );
+    try
+    {
+      fn();
+    }
+    catch ( ... )
+    {
+      sequencer_->leave( section, sequence_ );
+      section_ = section + 1;
+      throw;
+    }
+    sequencer_->leave( section, sequence_ );
+    section_ = section + 1;
+  }
+
+  /**
+   * @brief finish passes all remaining sections.
+   */
+  void finish()
+  {
+    if ( sequencer_ )
+      pass( sequencer_->sections() );
+  }
+
+private:
+
+  FrameTicket( const FrameTicket& );
+  FrameTicket& operator=( const FrameTicket& );
+
+  // Passes the sections before section which the frame did not run
+  void pass( size_t section )
+  {
+    for ( ; section_ < section; section_++ )
+    {
+      sequencer_->enter( section_, sequence_ );
+      sequencer_->leave( section_, sequence_ );
+    }
+  }
+
+  FrameSequencer* sequencer_;
+  uint64_t        sequence_;
+  size_t          section_;
+};
+
+
+/**
+ * @brief FrameWorkers processes consecutive frames concurrently, one whole
+ * frame per worker thread. Frames get sequence numbers in push() order and
+ * the process function orders its stateful stages with the FrameTicket, so
+ * the results can be published strictly in capture order.
+ * At most max_in_flight frames are queued or in work; they come from a fixed
+ * pool created by start(), and acquire() returns NULL while all of them are
+ * in flight, so the producer drops the newest frame instead of queueing up.
+ */
+template <typename Frame>
+class FrameWorkers
+{
+public:
+
+  typedef boost::shared_ptr<Frame> FramePtr;
+
+  /**
+   * @brief Process runs the whole pipeline of a frame on worker thread worker.
+   */
+  typedef std::function<void( Frame&, size_t worker, FrameTicket& )> Process;
+
+  /**
+   * @param workers size_t number of worker threads
+   * @param max_in_flight size_t frames queued or in work, at least workers
+   * @param sections size_t number of ordered sections of a frame
+   */
+  FrameWorkers( size_t workers, size_t max_in_flight, size_t sections ) :
+      workers_( workers < 1 ? 1 : workers ),
+      max_in_flight_( max_in_flight < workers_ ? workers_ : max_in_flight ),
+      sequencer_( sections ),
+      stop_( true ),
+      sequence_( 0 ),
+      dropped_( 0 ),
+      completed_( 0 )
+  {
+  }
+
+  ~FrameWorkers() { stop(); }
+
+  size_t workers() const { return workers_; }
+  size_t maxInFlight() const { return max_in_flight_; }
+
+  /**
+   * @brief start fills the frame pool and starts the workers.
+   * @param process const Process& pipeline run on every frame
+   * @param factory const std::function<FramePtr()>& creates the frames of the pool
+   */
+  void start( const Process& process, const std::function<FramePtr()>& factory )
+  {
+    stop();
+
+    process_ = process;
+
+    pool_.clear();
+    for ( size_t i = 0; i < max_in_flight_; i++ )
+      pool_.push_back( factory() );
+
+    queue_.clear();
+    sequence_ = 0;
+    sequencer_.reset();
+
+    stop_ = false;
+    for ( size_t i = 0; i < workers_; i++ )
+      threads_.push_back( std::thread( &FrameWorkers::run, this, i ) );
+  }
+
+  /**
+   * @brief stop lets the workers finish their current frame and joins them.
+   * Queued frames are discarded.
+   */
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      stop_ = true;
+    }
+    ready_.notify_all();
+
+    for ( size_t i = 0; i < threads_.size(); i++ )
+      threads_[i].join();
+    threads_.clear();
+  }
+
+  bool running() const { return not threads_.empty(); }
+
+  /**
+   * @brief acquire takes a free frame from the pool to fill in.
+   * @return FramePtr frame to be handed to push(), NULL while max_in_flight frames are in flight
+   */
+  FramePtr acquire()
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    FramePtr frame;
+    if ( not pool_.empty() )
+    {
+      frame = pool_.back();
+      pool_.pop_back();
+    }
+    else
+    {
+      dropped_++;
+    }
+    return frame;
+  }
+
+  /**
+   * @brief push hands a filled frame to the next free worker.
+   */
+  void push( const FramePtr& frame )
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      queue_.push_back( Item( frame, sequence_++ ) );
+    }
+    ready_.notify_one();
+  }
+
+  // Frames dropped because max_in_flight frames were in flight, and frames processed
+  size_t dropped() const
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return dropped_;
+  }
+
+  size_t completed() const
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return completed_;
+  }
+
+private:
+
+  typedef std::pair<FramePtr, uint64_t> Item;
+
+  void run( size_t worker )
+  {
+    while ( true )
+    {
+      Item item;
+      {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        ready_.wait( lock, [&]() { return stop_ || not queue_.empty(); } );
+        if ( stop_ )
+          return;
+
+        // The queue is in sequence order, so the frames before this one are already in work
+        item = queue_.front();
+        queue_.pop_front();
+      }
+
+      {
+        FrameTicket ticket( &sequencer_, item.second );
+        process_( *item.first, worker, ticket );
+      }
+
+      std::lock_guard<std::mutex> lock( mutex_ );
+      pool_.push_back( item.first );
+      completed_++;
+    }
+  }
+
+  const size_t             workers_;
+  const size_t             max_in_flight_;
+  Process                  process_;
+  FrameSequencer           sequencer_;
+  std::vector<std::thread> threads_;
+  std::vector<FramePtr>    pool_;
+  std::deque<Item>         queue_;
+
+  // One lock for the queue, the pool and the counters, taken only between frames
+  mutable std::mutex      mutex_;
+  std::condition_variable ready_;
+  bool                    stop_;
+  uint64_t                sequence_;
+  size_t                  dropped_;
+  size_t                  completed_;
+};
+
+};
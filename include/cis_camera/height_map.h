@@ -0,0 +1,134 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <cis_camera/thread_pool.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief HeightMapTable holds the direction of every depth pixel in the grid frame.
+ * A pixel with corrected depth d [mm] lies at origin + d * dir in the grid frame [m],
+ * so the static extrinsic and the undistortion are applied once per calibration.
+ */
+struct HeightMapTable
+{
+  int   width;
+  int   height;
+  float origin[3];
+
+  std::vector<float> dir_x;
+  std::vector<float> dir_y;
+  std::vector<float> dir_z;
+
+  HeightMapTable() : width(0), height(0) { origin[0] = origin[1] = origin[2] = 0.0f; }
+
+  bool empty() const { return dir_x.empty(); }
+};
+
+/**
+ * @brief HeightMapGrid describes the cells of the height map in the grid frame.
+ * Cell ( ix, iy ) covers x in origin_x + [ ix, ix + 1 ) * resolution and the same for y.
+ * Points below min_z or above max_z are ignored (floor noise, ceilings).
+ */
+struct HeightMapGrid
+{
+  float resolution;
+  float origin_x;
+  float origin_y;
+  float min_z;
+  float max_z;
+  int   cells_x;
+  int   cells_y;
+
+  HeightMapGrid() :
+      resolution(0.05f), origin_x(0.0f), origin_y(-2.0f), min_z(-1.0f), max_z(2.0f), cells_x(80), cells_y(80) {}
+
+  size_t cells() const { return static_cast<size_t>( cells_x ) * cells_y; }
+};
+
+/**
+ * @brief buildHeightMapTable builds the grid frame direction of every depth pixel.
+ * @param ray_x const float* undistorted x / z of every depth pixel
+ * @param ray_y const float* undistorted y / z of every depth pixel
+ * @param width int depth image width
+ * @param height int depth image height
+ * @param rotation const double* row major 3x3 rotation of the depth frame in the grid frame
+ * @param translation const double* position of the depth frame in the grid frame [m]
+ * @param table HeightMapTable& table to fill
+ */
+void buildHeightMapTable( const float* ray_x, const float* ray_y, int width, int height,
+                          const double* rotation, const double* translation, HeightMapTable& table );
+
+/**
+ * @brief HeightMapBuilder projects a corrected depth image into a HeightMapGrid.
+ * Every cell gets the maximum height and the number of depth pixels hitting it.
+ * Row strips are accumulated into private grids on a ThreadPool and merged
+ * cell range wise, so the whole map is built in one parallel pass over the depth.
+ */
+class HeightMapBuilder
+{
+public:
+
+  /**
+   * @brief build fills max_height and hits of grid.cells() cells from a depth image.
+   * Cells without hits get NaN as height.
+   * @param depth const uint16_t* corrected depth image [mm] of table.width x table.height
+   * @param table const HeightMapTable& pixel directions in the grid frame
+   * @param grid const HeightMapGrid& grid to build
+   * @param pool ThreadPool* pool to run on, NULL to run on the calling thread
+   * @param max_height float* output heights [m]
+   * @param hits uint16_t* output hit counts, saturated at 65535
+   */
+  void build( const uint16_t* depth, const HeightMapTable& table, const HeightMapGrid& grid,
+              ThreadPool* pool, float* max_height, uint16_t* hits );
+
+private:
+
+  void accumulateStrip( const uint16_t* depth, const HeightMapTable& table, const HeightMapGrid& grid,
+                        size_t row_begin, size_t row_end, float* max_height, uint32_t* hits ) const;
+
+  // Private grids of each strip, reused between frames
+  std::vector< std::vector<float> >    part_height_;
+  std::vector< std::vector<uint32_t> > part_hits_;
+};
+
+};
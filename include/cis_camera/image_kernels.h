@@ -0,0 +1,457 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief ColorGains holds the software color gains applied in the YUV422 to BGR8 conversion.
+ */
+struct ColorGains
+{
+  float r;
+  float g;
+  float b;
+  
+  ColorGains( float r_gain = 1.0f, float g_gain = 1.0f, float b_gain = 1.0f ) :
+      r(r_gain), g(g_gain), b(b_gain)
+  {}
+};
+
+
+/**
+ * @brief RemapTable is a fixed-point remap table for bilinear image rectification.
+ * For every output pixel it holds the integer source position of the top-left
+ * neighbour and the fractional position in 1/REMAP_SCALE units. Pixels which map
+ * outside of the source image are marked with a negative x and become zero.
+ */
+struct RemapTable
+{
+  static const int REMAP_BITS  = 5;
+  static const int REMAP_SCALE = 1 << REMAP_BITS;
+  
+  int width;       // output size
+  int height;
+  int src_width;   // source size the table was built for
+  int src_height;
+  
+  std::vector<int16_t> xy;    // source x, y of the top-left neighbour, 2 per pixel
+  std::vector<uint8_t> frac;  // fractional x, y in 1/REMAP_SCALE units, 2 per pixel
+  
+  RemapTable() : width(0), height(0), src_width(0), src_height(0) {}
+  
+  bool empty() const { return xy.empty(); }
+};
+
+
+/**
+ * @brief AreaWeights is a cached one-dimensional area (box) resampling filter.
+ * Output sample i is the weighted sum of the source samples
+ * index[ begin[i] ] ... index[ begin[i+1] - 1 ] with the corresponding weights.
+ */
+struct AreaWeights
+{
+  std::vector<int>   begin;
+  std::vector<int>   index;
+  std::vector<float> weight;
+
+  bool empty() const { return begin.empty(); }
+};
+
+
+/**
+ * @brief ScanTable maps a horizontal band of depth pixels to laser scan beams.
+ * For every pixel of the band it holds the beam its ray falls into and the factor
+ * turning the depth along the optical axis [mm] into the range in the scan plane [m].
+ */
+struct ScanTable
+{
+  int   width;       // depth image width
+  int   row_begin;   // first row of the band
+  int   rows;        // number of rows in the band
+  int   beams;
+  float angle_min;
+  float angle_increment;
+  
+  std::vector<uint16_t> beam;
+  std::vector<float>    range_scale;
+  
+  ScanTable() : width(0), row_begin(0), rows(0), beams(0), angle_min(0.0f), angle_increment(0.0f) {}
+  
+  bool empty() const { return beam.empty(); }
+};
+
+
+/**
+ * @brief PinholeModel is a camera matrix with plumb bob distortion for projecting points.
+ */
+struct PinholeModel
+{
+  float fx, fy, cx, cy;
+  float k1, k2, p1, p2, k3;
+  
+  PinholeModel() : fx(1.0f), fy(1.0f), cx(0.0f), cy(0.0f), k1(0.0f), k2(0.0f), p1(0.0f), p2(0.0f), k3(0.0f) {}
+};
+
+
+/**
+ * @brief BilateralKernel is a precomputed joint bilateral filter: the spatial weights
+ * of a ( 2 * radius + 1 )^2 window and the range weights of every luma difference.
+ */
+struct BilateralKernel
+{
+  int   radius;
+  float sigma_space;
+  float sigma_range;
+  
+  std::vector<float> spatial;
+  float              range[256];
+  
+  BilateralKernel() : radius(0), sigma_space(0.0f), sigma_range(0.0f) {}
+  
+  bool empty() const { return spatial.empty(); }
+};
+
+
+/**
+ * @brief buildAreaWeights builds the area filter which resamples src_size samples to dst_size samples.
+ * @param src_size int number of source samples
+ * @param dst_size int number of output samples
+ * @param weights AreaWeights& filter to fill
+ */
+void buildAreaWeights( int src_size, int dst_size, AreaWeights& weights );
+
+/**
+ * @brief convertUYVYToBGR8 converts a UYVY (YUV422) plane to BGR8.
+ * Runs the active PixelKernels version (see pixel_kernels.h).
+ * @param src const uint16_t* first UYVY pixel of the source plane (one 16 bit word per pixel)
+ * @param src_stride int distance between source rows in pixels
+ * @param width int image width, must be even
+ * @param height int image height
+ * @param gains const ColorGains& software color gains
+ * @param dst uint8_t* output BGR8 image
+ * @param dst_step int distance between output rows in bytes
+ */
+void convertUYVYToBGR8( const uint16_t* src, int src_stride, int width, int height,
+                        const ColorGains& gains, uint8_t* dst, int dst_step );
+
+/**
+ * @brief convertUYVYToBGR8Scalar is the portable version of convertUYVYToBGR8.
+ */
+void convertUYVYToBGR8Scalar( const uint16_t* src, int src_stride, int width, int height,
+                              const ColorGains& gains, uint8_t* dst, int dst_step );
+
+/**
+ * @brief binUYVYToBGR8 converts a UYVY plane to BGR8 while averaging factor x factor pixel blocks.
+ * Runs the active PixelKernels version.
+ * @param src const uint16_t* first UYVY pixel of the source plane
+ * @param src_stride int distance between source rows in pixels
+ * @param width int source width
+ * @param height int source height
+ * @param factor int binning factor (2 or 4)
+ * @param gains const ColorGains& software color gains
+ * @param dst uint8_t* output BGR8 image of ( width / factor ) x ( height / factor ) pixels
+ * @param dst_step int distance between output rows in bytes
+ */
+void binUYVYToBGR8( const uint16_t* src, int src_stride, int width, int height, int factor,
+                    const ColorGains& gains, uint8_t* dst, int dst_step );
+
+/**
+ * @brief binUYVYToBGR8Scalar is the portable version of binUYVYToBGR8.
+ */
+void binUYVYToBGR8Scalar( const uint16_t* src, int src_stride, int width, int height, int factor,
+                          const ColorGains& gains, uint8_t* dst, int dst_step );
+
+/**
+ * @brief correctDepth converts raw depth samples to depth along the optical axis [mm].
+ * Each output is round( ( src * scale + offset ) * inv_norm ) limited to 0 - 65535, so a
+ * row of depth samples can be read straight from the interlaced frame.
+ * Runs the active PixelKernels version.
+ * @param src const uint16_t* raw depth samples
+ * @param inv_norm const float* inverse norm of the ray of every sample
+ * @param count int number of samples
+ * @param scale double depth conversion gain of the raw samples
+ * @param offset double depth offset [mm]
+ * @param dst uint16_t* output depth [mm]
+ */
+void correctDepth( const uint16_t* src, const float* inv_norm, int count,
+                   double scale, double offset, uint16_t* dst );
+
+/**
+ * @brief correctDepthScalar is the portable version of correctDepth.
+ */
+void correctDepthScalar( const uint16_t* src, const float* inv_norm, int count,
+                         double scale, double offset, uint16_t* dst );
+
+/**
+ * @brief resizeUYVYToBGR8 converts a UYVY plane to BGR8 while resampling it with an area filter.
+ * @param src const uint16_t* first UYVY pixel of the source plane
+ * @param src_stride int distance between source rows in pixels
+ * @param weights_x const AreaWeights& horizontal filter
+ * @param weights_y const AreaWeights& vertical filter
+ * @param gains const ColorGains& software color gains
+ * @param dst uint8_t* output BGR8 image
+ * @param dst_step int distance between output rows in bytes
+ */
+void resizeUYVYToBGR8( const uint16_t* src, int src_stride,
+                       const AreaWeights& weights_x, const AreaWeights& weights_y,
+                       const ColorGains& gains, uint8_t* dst, int dst_step );
+
+/**
+ * @brief buildRemapTable converts floating point source coordinate maps
+ * (e.g. from cv::initUndistortRectifyMap) into a fixed-point RemapTable.
+ * @param map_x const float* source x coordinate of every output pixel
+ * @param map_y const float* source y coordinate of every output pixel
+ * @param width int output width
+ * @param height int output height
+ * @param src_width int source width
+ * @param src_height int source height
+ * @param table RemapTable& table to fill
+ */
+void buildRemapTable( const float* map_x, const float* map_y,
+                      int width, int height, int src_width, int src_height,
+                      RemapTable& table );
+
+/**
+ * @brief remapMono16 rectifies a 16 bit single channel image with a RemapTable.
+ * The source stride is given in pixels, so an interlaced plane of the raw frame
+ * can be rectified in place without deinterleaving it first.
+ * @param src const uint16_t* first pixel of the source plane
+ * @param src_stride int distance between source rows in pixels
+ * @param table const RemapTable& remap table
+ * @param dst uint16_t* output image of table.width x table.height pixels
+ */
+void remapMono16( const uint16_t* src, int src_stride, const RemapTable& table, uint16_t* dst );
+
+/**
+ * @brief buildScanTable builds the ScanTable of a band of depth rows from the undistorted rays.
+ * The scan frame looks along the optical axis with y to the left, so a pixel with
+ * ray x = x / z lies at the angle atan( -x / z ) and the range z * sqrt( 1 + x * x ).
+ * The beams cover the angles of the band evenly, one beam per depth column.
+ * @param ray_x const float* undistorted x / z of every depth pixel
+ * @param width int depth image width
+ * @param height int depth image height
+ * @param row_begin int first row of the band
+ * @param rows int number of rows in the band
+ * @param table ScanTable& table to fill
+ */
+void buildScanTable( const float* ray_x, int width, int height, int row_begin, int rows, ScanTable& table );
+
+/**
+ * @brief projectDepthToScan takes the minimum range of each beam over the band of a depth image.
+ * Zero depths and ranges outside [ range_min, range_max ] are ignored, beams without
+ * a valid pixel become +Inf as in depthimage_to_laserscan.
+ * @param depth const uint16_t* depth image [mm] of table.width columns
+ * @param table const ScanTable& scan table
+ * @param range_min float minimum valid range [m]
+ * @param range_max float maximum valid range [m]
+ * @param ranges float* output ranges, table.beams values
+ */
+void projectDepthToScan( const uint16_t* depth, const ScanTable& table,
+                         float range_min, float range_max, float* ranges );
+
+/**
+ * @brief computeDepthNormals computes unit surface normals of rows [ row_begin, row_end ) of a depth image.
+ * The tangents are central differences of the 3D points radius pixels left/right and
+ * above/below, falling back to one-sided differences when a side is invalid.
+ * Zero depths and neighbors deeper or closer than max_depth_change * depth are invalid,
+ * so normals never straddle holes or depth edges. Pixels without both tangents
+ * get NaN normals, as in pcl::IntegralImageNormalEstimation. Normals face the camera.
+ * Rows of a strip only read their neighbors, so strips can run in parallel.
+ * @param depth const uint16_t* depth image [mm]
+ * @param ray_x const float* undistorted x / z of every depth pixel
+ * @param ray_y const float* undistorted y / z of every depth pixel
+ * @param width int depth image width
+ * @param height int depth image height
+ * @param row_begin int first row to compute
+ * @param row_end int row after the last row to compute
+ * @param radius int distance of the neighbors [px]
+ * @param max_depth_change float maximum relative depth change to a neighbor
+ * @param normals float* output normals, 3 floats (x, y, z) per pixel of the whole image
+ */
+void computeDepthNormals( const uint16_t* depth, const float* ray_x, const float* ray_y,
+                          int width, int height, int row_begin, int row_end,
+                          int radius, float max_depth_change, float* normals );
+
+/**
+ * @brief extractUYVYLuma samples the luma of a UYVY image at the nearest source pixel of a dst size grid.
+ * @param src const uint16_t* top left of the UYVY image, one 16 bit word per pixel
+ * @param src_stride int source row stride in words
+ * @param src_width int source width
+ * @param src_height int source height
+ * @param dst_width int output width
+ * @param dst_height int output height
+ * @param luma uint8_t* output luma image
+ */
+void extractUYVYLuma( const uint16_t* src, int src_stride, int src_width, int src_height,
+                      int dst_width, int dst_height, uint8_t* luma );
+
+/**
+ * @brief registerDepth reprojects a depth image into another camera as a sparse depth image.
+ * Every depth pixel is moved by translation into the target optical frame and splatted
+ * to its nearest target pixel, keeping the nearest depth where pixels collide.
+ * @param depth const uint16_t* depth image [mm]
+ * @param ray_x const float* undistorted x / z of every depth pixel
+ * @param ray_y const float* undistorted y / z of every depth pixel
+ * @param width int depth image width
+ * @param height int depth image height
+ * @param translation const float* depth optical frame origin in the target optical frame [m]
+ * @param model const PinholeModel& target camera
+ * @param dst_width int target image width
+ * @param dst_height int target image height
+ * @param sparse uint16_t* output target depth [mm], 0 where no pixel landed
+ */
+void registerDepth( const uint16_t* depth, const float* ray_x, const float* ray_y, int width, int height,
+                    const float* translation, const PinholeModel& model,
+                    int dst_width, int dst_height, uint16_t* sparse );
+
+/**
+ * @brief buildBilateralKernel precomputes the spatial and range weights of a joint bilateral filter.
+ * @param radius int window radius [px]
+ * @param sigma_space float spatial standard deviation [px]
+ * @param sigma_range float luma standard deviation [levels]
+ * @param kernel BilateralKernel& kernel to fill
+ */
+void buildBilateralKernel( int radius, float sigma_space, float sigma_range, BilateralKernel& kernel );
+
+/**
+ * @brief jointBilateralUpsample fills rows [ row_begin, row_end ) of a dense depth image from a sparse one.
+ * Each output pixel is the average of the sparse depths in its window, weighted by
+ * distance and by the luma difference to the output pixel in the guide image, so
+ * depth edges follow the color edges. Pixels without samples in the window stay 0.
+ * Rows only read their window, so strips can run in parallel.
+ * @param sparse const uint16_t* sparse depth [mm], 0 = no sample
+ * @param guide const uint8_t* luma guide of the same size
+ * @param width int image width
+ * @param height int image height
+ * @param kernel const BilateralKernel& precomputed weights
+ * @param row_begin int first row to fill
+ * @param row_end int row after the last row to fill
+ * @param dense uint16_t* output depth [mm]
+ */
+void jointBilateralUpsample( const uint16_t* sparse, const uint8_t* guide, int width, int height,
+                             const BilateralKernel& kernel, int row_begin, int row_end, uint16_t* dense );
+
+// Tile size of the depth change detection
+static const int CHANGE_TILE_SIZE = 16;
+
+/**
+ * @brief computeTileSAD sums the absolute differences of two depth images per 16x16 tile.
+ * Tiles at the right and bottom edges may be partial. Runs the active PixelKernels version.
+ * @param a const uint16_t* depth image
+ * @param b const uint16_t* reference depth image of the same size
+ * @param width int image width
+ * @param height int image height
+ * @param sad uint32_t* output sums, tiles_x * tiles_y with tiles_x = ceil( width / 16 )
+ */
+void computeTileSAD( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad );
+
+/**
+ * @brief computeTileSADScalar is the portable version of computeTileSAD.
+ */
+void computeTileSADScalar( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad );
+
+/**
+ * @brief detectChangedTiles marks the tiles whose mean absolute depth difference exceeds a threshold.
+ * Depths appearing or vanishing (0) count as their full value, so holes filling up are changes.
+ * @param depth const uint16_t* depth image [mm]
+ * @param reference const uint16_t* reference depth image [mm]
+ * @param width int image width
+ * @param height int image height
+ * @param threshold float mean absolute difference per pixel of a changed tile [mm]
+ * @param sad std::vector<uint32_t>& scratch buffer for the tile sums
+ * @param mask uint8_t* output mask, 255 for changed tiles, 0 otherwise
+ * @return int number of changed tiles
+ */
+int detectChangedTiles( const uint16_t* depth, const uint16_t* reference, int width, int height,
+                        float threshold, std::vector<uint32_t>& sad, uint8_t* mask );
+
+/**
+ * @brief remapUYVYToBGR8 rectifies and converts a UYVY (YUV422) plane to BGR8 in one pass.
+ * Y, U and V are sampled bilinearly straight from the packed UYVY data, so neither a
+ * cropped nor an unrectified color image is ever materialized.
+ * @param src const uint16_t* first UYVY pixel of the source plane (one 16 bit word per pixel)
+ * @param src_stride int distance between source rows in pixels
+ * @param table const RemapTable& remap table
+ * @param gains const ColorGains& software color gains
+ * @param dst uint8_t* output BGR8 image of table.width x table.height pixels
+ * @param dst_step int distance between output rows in bytes
+ */
+void remapUYVYToBGR8( const uint16_t* src, int src_stride, const RemapTable& table,
+                      const ColorGains& gains, uint8_t* dst, int dst_step );
+
+/**
+ * @brief CloudEncoding is the packed point layout of the compact point cloud.
+ */
+enum CloudEncoding
+{
+  CLOUD_FLOAT32  = 0, // x y z float32 [m], 12 bytes per point
+  CLOUD_INT16_MM = 1, // x y z int16 [mm], 6 bytes per point
+  CLOUD_FLOAT16  = 2, // x y z IEEE 754 half float [m], 6 bytes per point
+};
+
+/**
+ * @brief cloudPointStep returns the bytes per point of an encoding.
+ */
+int cloudPointStep( CloudEncoding encoding );
+
+/**
+ * @brief floatToHalf converts a float to an IEEE 754 half float, rounding to nearest even.
+ */
+uint16_t floatToHalf( float value );
+
+/**
+ * @brief encodeDepthCloud converts a depth image to packed points in the depth optical frame.
+ * Organized clouds keep every pixel, pixels without depth become NaN (0 for int16).
+ * With drop_invalid they are skipped and the points are packed back to back.
+ * @param depth const uint16_t* corrected depth image [mm]
+ * @param ray_x const float* x / z per pixel
+ * @param ray_y const float* y / z per pixel
+ * @param width int image width
+ * @param height int image height
+ * @param encoding CloudEncoding point layout
+ * @param drop_invalid bool skip pixels without depth
+ * @param out uint8_t* output of up to width * height * cloudPointStep( encoding ) bytes
+ * @return size_t number of points written
+ */
+size_t encodeDepthCloud( const uint16_t* depth, const float* ray_x, const float* ray_y, int width, int height,
+                         CloudEncoding encoding, bool drop_invalid, uint8_t* out );
+
+};
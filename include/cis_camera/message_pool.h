@@ -0,0 +1,140 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief MessagePool recycles published ROS messages once every subscriber has released them.
+ * Messages published through roscpp are shared with intra-process subscribers by pointer,
+ * so a message can only be reused when the pool holds the last reference to it.
+ * acquire() returns such a message, refreshed from the prototype only when the prototype
+ * changed, so the steady state needs no heap allocation at all.
+ * The pool is not thread safe; each pool is owned by one publishing thread.
+ */
+template <class M>
+class MessagePool
+{
+public:
+
+  typedef boost::shared_ptr<M> MessagePtr;
+
+  explicit MessagePool( size_t max_size = 4 ) : max_size_( max_size ) {}
+
+  /**
+   * @brief acquire returns a message equal to *prototype which nobody else references.
+   * @param prototype const boost::shared_ptr<const M>& message to copy from
+   * @return MessagePtr of a message owned by the pool
+   */
+  MessagePtr acquire( const boost::shared_ptr<const M>& prototype )
+  {
+    for ( size_t i = 0; i < entries_.size(); i++ )
+    {
+      Entry& entry = entries_[i];
+      if ( entry.msg.unique() )
+      {
+        if ( entry.source != prototype.get() )
+        {
+          *(entry.msg)  = *prototype;  // reuses the capacity of the old message
+          entry.source = prototype.get();
+          entry.source_ref = prototype;
+        }
+        return entry.msg;
+      }
+    }
+
+    // Every pooled message is still in flight: grow up to max_size_, then fall back to a plain copy
+    MessagePtr msg = boost::make_shared<M>( *prototype );
+    if ( entries_.size() < max_size_ )
+    {
+      Entry entry;
+      entry.msg        = msg;
+      entry.source     = prototype.get();
+      entry.source_ref = prototype;
+      entries_.push_back( entry );
+    }
+    return msg;
+  }
+
+  /**
+   * @brief acquire returns a message nobody else references, without initializing its contents.
+   * Callers which overwrite the whole message (e.g. image buffers) use this variant.
+   * @return MessagePtr of a message owned by the pool
+   */
+  MessagePtr acquire()
+  {
+    for ( size_t i = 0; i < entries_.size(); i++ )
+    {
+      if ( entries_[i].msg.unique() )
+        return entries_[i].msg;
+    }
+
+    MessagePtr msg = boost::make_shared<M>();
+    if ( entries_.size() < max_size_ )
+    {
+      Entry entry;
+      entry.msg    = msg;
+      entry.source = NULL;
+      entries_.push_back( entry );
+    }
+    return msg;
+  }
+
+  void clear()
+  {
+    entries_.clear();
+  }
+
+private:
+
+  struct Entry
+  {
+    MessagePtr msg;
+    const M*   source;
+
+    // Keeps the prototype alive so that its address can not be reused by a new prototype
+    boost::shared_ptr<const M> source_ref;
+  };
+
+  size_t             max_size_;
+  std::vector<Entry> entries_;
+};
+
+};
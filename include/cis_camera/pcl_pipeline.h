@@ -0,0 +1,387 @@
+/*
+ *  This example is based on "Building a Perception Pipleline" of ROS Industrial Training
+ *
+ *  * https://industrial-training-master.readthedocs.io/en/melodic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-master.readthedocs.io/en/kinetic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-jp.readthedocs.io/ja/latest/_source/session5_JP/Building-a-Perception-Pipeline_JP.html
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/filters/crop_box.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/filters/extract_indices.h>
+#include <pcl/segmentation/sac_segmentation.h>
+#include <pcl/segmentation/extract_clusters.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/features/integral_image_normal.h>
+#include <pcl/segmentation/organized_multi_plane_segmentation.h>
+
+#include <cis_camera/depth_component_clustering.h>
+#include <cis_camera/depth_outlier_filter.h>
+#include <cis_camera/plane_cache.h>
+#include <cis_camera/stage_timer.h>
+#include <cis_camera/thread_pool.h>
+#include <cis_camera/voxel_crop_filter.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief PclPipeline is the object extraction pipeline of the PCL example:
+ * voxel grid, crop, statistical outlier removal, plane removal and euclidean
+ * clustering. It is free of ROS so it can run on recorded clouds as well.
+ * With PLANE_ORGANIZED the plane is removed first on the organized camera
+ * cloud with integral image normals and organized multi-plane segmentation,
+ * a single deterministic pass instead of RANSAC iterations.
+ * With OUTLIER_ORGANIZED the speckles are removed on the organized camera cloud
+ * by DepthOutlierFilter instead of StatisticalOutlierRemoval on the voxels.
+ * With CLUSTER_CONNECTED the objects are the connected components of the
+ * organized depth image instead of KdTree based euclidean clusters.
+ * With tracking enabled, frames after a successful search only process a box
+ * around the previous cluster and reuse the previous plane, until the track
+ * is lost or full_search_interval frames have passed. Tracking clusters the box
+ * by euclidean clustering, so it is ignored with CLUSTER_CONNECTED.
+ * The filters are members and every intermediate cloud lives in a Frame, both
+ * keep their memory between frames, so a frame only allocates when a cloud grows.
+ * process() works on the internal frame. For pipelined execution the full search
+ * is also available as filterStage(), segmentStage() and clusterStage() on
+ * caller owned frames, see supportsStages().
+ * Not thread safe otherwise, one instance per processing thread.
+ */
+class PclPipeline
+{
+public:
+
+  typedef pcl::PointXYZ           Point;
+  typedef pcl::PointCloud<Point>  Cloud;
+
+  enum PlaneMode
+  {
+    PLANE_SAC       = 0,
+    PLANE_ORGANIZED = 1
+  };
+
+  enum ClusterMode
+  {
+    CLUSTER_EUCLIDEAN = 0,
+    CLUSTER_CONNECTED = 1
+  };
+
+  enum OutlierFilter
+  {
+    OUTLIER_NONE      = 0,
+    OUTLIER_SOR       = 1,
+    OUTLIER_ORGANIZED = 2
+  };
+
+  struct Parameters
+  {
+    // Front End: fused voxel grid and crop (VoxelCropFilter) or the PCL filter chain
+    bool fused_front_end;
+    bool compare_front_end;
+    int  threads;
+
+    // Voxel Grid
+    float leaf_size;
+
+    // Crop Box in the world frame
+    float min_x, max_x;
+    float min_y, max_y;
+    float min_z, max_z;
+
+    // Outlier Filter, compare_outlier_filter also runs StatisticalOutlierRemoval on the organized input
+    int    outlier_filter;
+    bool   compare_outlier_filter;
+
+    // Statistical Outlier Removal
+    int    sor_mean_k;
+    double sor_stddev;
+
+    // Organized Depth Outlier Filter
+    int    outlier_window;
+    double outlier_stddev;
+    int    outlier_min_neighbors;
+
+    // Plane Segmentation
+    int    plane_mode;
+    int    plane_max_iterations;
+    double plane_distance;
+
+    // Plane Cache, checks the previous RANSAC plane before fitting a new one
+    bool   plane_cache;
+    int    plane_cache_samples;
+    double plane_cache_min_ratio;
+
+    // Organized Plane Segmentation
+    int    plane_min_inliers;
+    double plane_angular_threshold;
+    float  normal_depth_change;
+    float  normal_smoothing;
+
+    // Euclidean Cluster Extraction
+    double cluster_tolerance;
+    int    cluster_min_size;
+    int    cluster_max_size;
+
+    // Depth Image Connected Components
+    int    cluster_mode;
+    float  cluster_depth_jump;
+    int    cluster_min_pixels;
+    int    cluster_max_pixels;
+
+    // Tracking
+    bool   tracking;
+    float  track_margin;
+    int    full_search_interval;
+
+    Parameters() :
+        fused_front_end(true),
+        compare_front_end(false),
+        threads(0),
+        leaf_size(0.01f),
+        min_x(-1.0f), max_x(0.5f),
+        min_y(-0.3f), max_y(0.3f),
+        min_z(-1.0f), max_z(3.0f),
+        outlier_filter(OUTLIER_SOR),
+        compare_outlier_filter(false),
+        sor_mean_k(16),
+        sor_stddev(0.5),
+        outlier_window(3),
+        outlier_stddev(1.0),
+        outlier_min_neighbors(2),
+        plane_mode(PLANE_SAC),
+        plane_max_iterations(100),
+        plane_distance(0.02),
+        plane_cache(false),
+        plane_cache_samples(200),
+        plane_cache_min_ratio(0.8),
+        plane_min_inliers(1000),
+        plane_angular_threshold(3.0),
+        normal_depth_change(0.02f),
+        normal_smoothing(10.0f),
+        cluster_tolerance(0.01),
+        cluster_min_size(300),
+        cluster_max_size(10000),
+        cluster_mode(CLUSTER_EUCLIDEAN),
+        cluster_depth_jump(0.03f),
+        cluster_min_pixels(500),
+        cluster_max_pixels(100000),
+        tracking(false),
+        track_margin(0.05f),
+        full_search_interval(30)
+    {}
+  };
+
+  /**
+   * @brief Frame holds the input, the intermediate clouds and the results of one frame.
+   */
+  struct Frame
+  {
+    // Input: unorganized in the world frame, or organized in the camera frame with the transform to the world frame
+    Cloud::Ptr      input;
+    Cloud::Ptr      organized;
+    Eigen::Affine3f sensor_transform;
+
+    // Input time stamp [ns] to stamp the results, and the time the frame was received for the latency
+    uint64_t                              stamp;
+    std::chrono::steady_clock::time_point received;
+
+    // Intermediate Clouds, filtered and objects point to the current stage output
+    Cloud::Ptr cropped;
+    Cloud::Ptr sor;
+    Cloud::Ptr extracted;
+    Cloud::Ptr filtered;
+    Cloud::Ptr objects;
+
+    // Results
+    Cloud::Ptr                      cluster;
+    pcl::PointIndices::Ptr          inliers;
+    pcl::ModelCoefficients::Ptr     coefficients;
+    std::vector<pcl::PointIndices>  cluster_indices;
+    bool                            outliers_removed;
+    bool                            plane_valid;
+    bool                            plane_cached;
+    bool                            found;
+
+    Frame();
+
+    /**
+     * @brief reset clears the results of the previous frame, the clouds keep their memory.
+     */
+    void reset();
+  };
+
+  explicit PclPipeline( const Parameters& params = Parameters() );
+
+  void setParameters( const Parameters& params );
+  const Parameters& getParameters() const { return params_; }
+
+  /**
+   * @brief input returns the input cloud to fill in place before process(),
+   * unorganized and in the world frame.
+   */
+  Cloud& input() { return *frame_.input; }
+
+  /**
+   * @brief organizedInput returns the input cloud used instead of input() when
+   * usesOrganizedInput() is true: organized, in the camera frame, invalid points
+   * kept as NaN. setSensorTransform() gives the camera to world transform.
+   */
+  Cloud& organizedInput() { return *frame_.organized; }
+  void setSensorTransform( const Eigen::Affine3f& transform ) { frame_.sensor_transform = transform; }
+  bool usesOrganizedInput() const
+  {
+    return params_.plane_mode == PLANE_ORGANIZED || params_.cluster_mode == CLUSTER_CONNECTED ||
+           params_.outlier_filter == OUTLIER_ORGANIZED;
+  }
+
+  /**
+   * @brief usesTracking tells whether frames after a successful search are tracked.
+   * Only with CLUSTER_EUCLIDEAN, the tracked box is clustered by euclidean clustering
+   * and connected components would count cluster sizes differently on full searches.
+   */
+  bool usesTracking() const { return params_.tracking && params_.cluster_mode == CLUSTER_EUCLIDEAN; }
+
+  /**
+   * @brief process runs the stages on input() and laps timer() after each of them.
+   * Call timer().start() when the frame begins.
+   */
+  bool process();
+
+  StageTimer& timer() { return timer_; }
+
+  /**
+   * @brief supportsStages tells whether the full search can run as separate stages:
+   * euclidean clustering, no tracking and no comparison runs, which all feed state
+   * from one frame into the next or would need another stage's data.
+   */
+  bool supportsStages() const
+  {
+    return params_.cluster_mode == CLUSTER_EUCLIDEAN && not usesTracking() &&
+           not params_.compare_front_end && not params_.compare_outlier_filter;
+  }
+
+  /**
+   * @brief The stages of a full search on a caller owned frame, each returns false
+   * when nothing is left for the next stage. Different stages may run concurrently
+   * on different frames, a single stage must not run concurrently with itself.
+   * Each stage laps timer, which must be owned by the calling thread.
+   *  - filterStage: organized outlier filter and plane, voxel grid, crop and SOR into frame.filtered
+   *  - segmentStage: RANSAC plane removal into frame.objects, skipped with PLANE_ORGANIZED
+   *  - clusterStage: euclidean clustering into frame.cluster, sets frame.found
+   */
+  bool filterStage( Frame& frame, StageTimer& timer );
+  bool segmentStage( Frame& frame, StageTimer& timer );
+  bool clusterStage( Frame& frame, StageTimer& timer );
+
+  /**
+   * @brief resetTracking forces a full search on the next frame.
+   */
+  void resetTracking() { tracked_ = false; }
+  bool lastFrameTracked() const { return last_frame_tracked_; }
+
+  // Plane Cache statistics
+  bool   lastPlaneCached() const { return frame_.plane_cached; }
+  size_t planeCacheHits() const { return plane_cache_.hits(); }
+  size_t planeCacheMisses() const { return plane_cache_.misses(); }
+
+  // Results of the last process() call
+  Frame& frame() { return frame_; }
+  const Frame& frame() const { return frame_; }
+  const Cloud& largestCluster() const { return *frame_.cluster; }
+  const pcl::ModelCoefficients& planeCoefficients() const { return *frame_.coefficients; }
+  size_t planeSize() const { return frame_.inliers->indices.size(); }
+  size_t clusterCount() const { return frame_.cluster_indices.size(); }
+
+  // Front end comparison of the last process() call, valid with compare_front_end
+  size_t frontEndSize() const { return frame_.cropped->size(); }
+  size_t frontEndReferenceSize() const { return reference_->size(); }
+  double frontEndDeviation() const { return front_end_deviation_; }
+
+  // Outlier filter comparison of the last process() call, valid with compare_outlier_filter
+  size_t outlierInputSize() const { return outlier_input_size_; }
+  size_t outlierRemoved() const { return outlier_removed_; }
+  size_t outlierReferenceRemoved() const { return outlier_reference_removed_; }
+
+private:
+
+  void filterPcl( const Frame& frame, Cloud& output );
+  void compareFrontEnd( Frame& frame, StageTimer& timer );
+  void compareOutlierFilter( Frame& frame, StageTimer& timer );
+  void filterOrganizedOutliers( Frame& frame, StageTimer& timer );
+  void segmentOrganizedPlane( Frame& frame, StageTimer& timer );
+  void extractWorldPoints( Frame& frame, bool skip_plane, StageTimer& timer );
+  bool organizedValid( const Frame& frame ) const;
+  bool processConnected();
+  bool processFull();
+  bool processTracked();
+  void updateTrack();
+  void segmentPlane( Frame& frame, const Cloud::Ptr& cloud );
+
+  Parameters params_;
+
+  boost::shared_ptr<ThreadPool> pool_;
+  StageTimer                    timer_;
+  VoxelCropFilter               voxel_crop_filter_;
+
+  // Persistent Filters
+  pcl::VoxelGrid<Point>                   voxel_filter_;
+  pcl::CropBox<Point>                     crop_filter_;
+  pcl::StatisticalOutlierRemoval<Point>   sor_filter_;
+  pcl::SACSegmentation<Point>             seg_;
+  pcl::ExtractIndices<Point>              extract_;
+  pcl::search::KdTree<Point>::Ptr         tree_;
+  pcl::EuclideanClusterExtraction<Point>  ec_;
+
+  pcl::IntegralImageNormalEstimation<Point, pcl::Normal>                    ne_;
+  pcl::OrganizedMultiPlaneSegmentation<Point, pcl::Normal, pcl::Label>      mps_;
+  DepthComponentClustering                                                  cc_;
+  DepthOutlierFilter                                                        depth_outlier_;
+  PlaneCache                                                                plane_cache_;
+
+  // Frame of process(), reused across frames
+  Frame frame_;
+
+  // Scratch Clouds of the filter stage
+  Cloud::Ptr voxel_;
+  Cloud::Ptr reference_;
+
+  // Organized Plane Segmentation, used by the filter stage
+  pcl::PointCloud<pcl::Normal>::Ptr        normals_;
+  std::vector<pcl::ModelCoefficients>      plane_coefficients_;
+  std::vector<pcl::PointIndices>           plane_inliers_;
+  std::vector<uint8_t>                     plane_mask_;
+  std::vector<uint8_t>                     valid_mask_;
+
+  // Tracking State: world frame bounds of the last cluster, plane of the last full search
+  // and frames since the last full search
+  bool            tracked_;
+  bool            last_frame_tracked_;
+  int             frames_since_search_;
+  Eigen::Vector3f track_min_;
+  Eigen::Vector3f track_max_;
+  Eigen::Vector4f track_plane_;
+  bool            track_plane_valid_;
+
+  double front_end_deviation_;
+
+  size_t outlier_input_size_;
+  size_t outlier_removed_;
+  size_t outlier_reference_removed_;
+};
+
+};
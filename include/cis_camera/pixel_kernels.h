@@ -0,0 +1,139 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "cis_camera/image_kernels.h"
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief CpuLevel is an instruction set the pixel kernels are built for.
+ * Levels a binary is not built for (e.g. NEON on x86) are never available.
+ */
+enum CpuLevel
+{
+  CPU_SCALAR = 0, // portable C++
+  CPU_SSE2   = 1, // x86 SSE2, the x86-64 baseline
+  CPU_AVX2   = 2, // x86 AVX2
+  CPU_NEON   = 3, // ARM Advanced SIMD
+  CPU_LEVELS = 4
+};
+
+/**
+ * @brief PixelKernels is the table of one instruction set's versions of the hot pixel kernels.
+ * Every entry has the signature and the results of the scalar kernel of the same name
+ * in image_kernels.h, so tables can be swapped freely.
+ */
+struct PixelKernels
+{
+  CpuLevel level;
+  
+  void (*correct_depth)( const uint16_t* src, const float* inv_norm, int count,
+                         double scale, double offset, uint16_t* dst );
+  void (*convert_uyvy)( const uint16_t* src, int src_stride, int width, int height,
+                        const ColorGains& gains, uint8_t* dst, int dst_step );
+  void (*bin_uyvy)( const uint16_t* src, int src_stride, int width, int height, int factor,
+                    const ColorGains& gains, uint8_t* dst, int dst_step );
+  void (*tile_sad)( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad );
+  
+  // bin_uyvy by 2 on the color crop of a DefaultFrameLayout frame (see frame_kernels.h), NULL if the level has none
+  void (*bin2_fixed)( const uint16_t* frame, const ColorGains& gains, uint8_t* dst, int dst_step );
+};
+
+/**
+ * @brief scalarPixelKernels returns the portable kernels, available everywhere.
+ */
+const PixelKernels& scalarPixelKernels();
+
+/**
+ * @brief sse2PixelKernels, avx2PixelKernels and neonPixelKernels return the kernels of an
+ * instruction set, or NULL when the binary is built for another architecture.
+ * They do not check the CPU, see pixelKernels( CpuLevel ).
+ */
+const PixelKernels* sse2PixelKernels();
+const PixelKernels* avx2PixelKernels();
+const PixelKernels* neonPixelKernels();
+
+/**
+ * @brief cpuSupports checks CPUID (x86) or the hwcaps (ARM) for an instruction set.
+ * @param level CpuLevel instruction set
+ * @return bool true when the CPU and the OS can run it
+ */
+bool cpuSupports( CpuLevel level );
+
+/**
+ * @brief pixelKernels returns the kernels of a level if the binary has them and the CPU supports them.
+ * @param level CpuLevel instruction set
+ * @return const PixelKernels* kernels, NULL when not available
+ */
+const PixelKernels* pixelKernels( CpuLevel level );
+
+/**
+ * @brief detectCpuLevel returns the best available level.
+ */
+CpuLevel detectCpuLevel();
+
+/**
+ * @brief pixelKernels returns the active kernels, the detected level unless another one was selected.
+ */
+const PixelKernels& pixelKernels();
+
+/**
+ * @brief selectPixelKernels makes a level active for all following kernel calls.
+ * Call it before frames are processed, kernels already running keep their level.
+ * @param level CpuLevel requested instruction set
+ * @return CpuLevel active level, the detected one when the requested level is not available
+ */
+CpuLevel selectPixelKernels( CpuLevel level );
+
+/**
+ * @brief cpuLevelName returns the parameter name of a level ("scalar", "sse2", "avx2", "neon").
+ */
+const char* cpuLevelName( CpuLevel level );
+
+/**
+ * @brief parseCpuLevel parses a level name, "auto" gives the detected level.
+ * @param name const std::string& level name
+ * @param level CpuLevel& parsed level
+ * @return bool false for unknown names
+ */
+bool parseCpuLevel( const std::string& name, CpuLevel& level );
+
+};
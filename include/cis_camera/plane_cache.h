@@ -0,0 +1,109 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+
+#include <random>
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/ModelCoefficients.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief PlaneCache keeps the last plane model for a camera that does not move.
+ * check() tests the cached model on a small random subset of a new cloud and,
+ * when it still fits as well as after the last fit, refines it with one least
+ * squares step on its inliers. Only a miss needs a new RANSAC fit, whose result
+ * is handed back with store().
+ */
+class PlaneCache
+{
+public:
+
+  typedef pcl::PointXYZ           Point;
+  typedef pcl::PointCloud<Point>  Cloud;
+
+  PlaneCache();
+
+  void setDistanceThreshold( double distance ) { distance_ = distance; }
+  void setSampleSize( int samples ) { samples_ = samples; }
+  void setMinInlierRatio( double ratio ) { min_ratio_ = ratio; }
+
+  bool valid() const { return valid_; }
+  void reset() { valid_ = false; }
+
+  /**
+   * @brief check tries the cached plane on cloud.
+   * @param cloud const Cloud& new cloud
+   * @param coefficients pcl::ModelCoefficients& refined plane on a hit
+   * @param inliers pcl::PointIndices& inliers of the refined plane on a hit
+   * @return bool true on a hit, false when RANSAC has to run
+   */
+  bool check( const Cloud& cloud, pcl::ModelCoefficients& coefficients, pcl::PointIndices& inliers );
+
+  /**
+   * @brief store caches a plane fitted by RANSAC on cloud.
+   */
+  void store( const Cloud& cloud, const pcl::ModelCoefficients& coefficients, const pcl::PointIndices& inliers );
+
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+
+private:
+
+  void findInliers( const Cloud& cloud, const Eigen::Vector4f& plane, std::vector<int>& inliers ) const;
+  bool refine( const Cloud& cloud, const std::vector<int>& inliers, Eigen::Vector4f& plane ) const;
+
+  double distance_;
+  int    samples_;
+  double min_ratio_;
+
+  bool            valid_;
+  Eigen::Vector4f plane_;
+  double          reference_ratio_;
+
+  size_t hits_;
+  size_t misses_;
+
+  std::mt19937 rng_;
+};
+
+};
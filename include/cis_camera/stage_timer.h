@@ -0,0 +1,109 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief StageTimer collects per-stage processing times of a frame pipeline
+ * over a sliding window of frames and reports mean and percentiles.
+ * Call start() at the beginning of a frame and lap( stage ) after each stage.
+ * The samples are locked, so one thread may report while another one adds,
+ * but start() and lap() belong to a single thread.
+ */
+class StageTimer
+{
+public:
+
+  struct Stats
+  {
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    size_t count;
+
+    Stats() : mean(0.0), p50(0.0), p90(0.0), p99(0.0), max(0.0), count(0) {}
+  };
+
+  /**
+   * @param window size_t number of most recent samples kept per stage
+   */
+  explicit StageTimer( size_t window = 300 );
+
+  void start();
+  void lap( const std::string& stage );
+  void add( const std::string& stage, double msec );
+  void clear();
+
+  /**
+   * @brief setWindow changes the number of samples kept per stage, e.g. to keep
+   * every frame of an offline benchmark. Takes effect with the next samples.
+   */
+  void setWindow( size_t window );
+
+  Stats stats( const std::string& stage ) const;
+  std::vector<std::string> stages() const;
+
+  /**
+   * @brief report returns one line per stage in the order the stages first appeared.
+   */
+  std::string report() const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  Stats statsLocked( const std::string& stage ) const;
+
+  mutable std::mutex                         mutex_;
+  size_t                                     window_;
+  Clock::time_point                          last_;
+  std::vector<std::string>                   order_;
+  std::map<std::string, std::deque<double> > samples_;
+};
+
+};
@@ -0,0 +1,101 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief ThreadPool is a small fork-join pool for data parallel frame processing.
+ * run() hands out task indices to the workers and to the calling thread, and
+ * returns when every task has finished. The workers are started once and sleep
+ * between runs, so a frame pays no thread creation. run() is not reentrant,
+ * use one pool per processing thread.
+ */
+class ThreadPool
+{
+public:
+
+  /**
+   * @param threads size_t total number of threads including the caller, 0 = number of cores
+   */
+  explicit ThreadPool( size_t threads = 0 );
+  ~ThreadPool();
+
+  /**
+   * @brief size returns the number of threads running tasks, including the caller.
+   */
+  size_t size() const { return workers_.size() + 1; }
+
+  /**
+   * @brief run calls fn( task ) for task = 0 ... tasks - 1 and waits for all of them.
+   */
+  void run( size_t tasks, const std::function<void( size_t )>& fn );
+
+  /**
+   * @brief splitRange returns the [ begin, end ) sub range of part in n items split into parts.
+   */
+  static void splitRange( size_t n, size_t parts, size_t part, size_t& begin, size_t& end );
+
+private:
+
+  void workerLoop();
+  void drain();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex              mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+
+  const std::function<void( size_t )>* job_;
+  size_t                               job_tasks_;
+  std::atomic<size_t>                  next_task_;
+  size_t                               active_workers_;
+  uint64_t                             generation_;
+  bool                                 stop_;
+};
+
+};
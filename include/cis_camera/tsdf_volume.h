@@ -0,0 +1,185 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include <cis_camera/thread_pool.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief TsdfVolume fuses depth images into a truncated signed distance field.
+ * The volume is sparse: voxels live in blocks of 8x8x8 which are allocated
+ * around the observed surface and found through a hash map of block indices
+ * (voxel block hashing). Each frame only touches the blocks in its view, and
+ * these are integrated in parallel on a ThreadPool since blocks are disjoint.
+ * The number of blocks is bounded by max_blocks; when the volume is full the
+ * least recently integrated blocks are evicted to make room for new ones.
+ */
+class TsdfVolume
+{
+public:
+
+  static const int BLOCK_SIZE   = 8;
+  static const int BLOCK_VOXELS = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+  struct Parameters
+  {
+    float  voxel_size;        // [m]
+    float  truncation;        // [m], distance field is clamped to +-truncation
+    float  max_weight;        // running average weight limit, lower adapts faster
+    float  min_depth;         // [m]
+    float  max_depth;         // [m]
+    size_t max_blocks;        // memory bound, BLOCK_VOXELS * 8 bytes per block
+    int    allocation_stride; // only every n-th pixel in u and v allocates blocks
+
+    Parameters() :
+        voxel_size( 0.01f ),
+        truncation( 0.04f ),
+        max_weight( 64.0f ),
+        min_depth( 0.2f ),
+        max_depth( 2.0f ),
+        max_blocks( 16384 ),
+        allocation_stride( 2 )
+    {}
+  };
+
+  /**
+   * @brief Camera is the pinhole model with plumb bob distortion of the depth image.
+   * The depth images hold the distance along the optical axis [mm] at distorted pixels.
+   */
+  struct Camera
+  {
+    int    width;
+    int    height;
+    double fx, fy, cx, cy;
+    double k1, k2, p1, p2, k3;
+
+    Camera() : width(0), height(0), fx(0.0), fy(0.0), cx(0.0), cy(0.0), k1(0.0), k2(0.0), p1(0.0), p2(0.0), k3(0.0) {}
+
+    bool operator==( const Camera& c ) const
+    {
+      return width == c.width && height == c.height && fx == c.fx && fy == c.fy && cx == c.cx && cy == c.cy &&
+             k1 == c.k1 && k2 == c.k2 && p1 == c.p1 && p2 == c.p2 && k3 == c.k3;
+    }
+  };
+
+  explicit TsdfVolume( const Parameters& params = Parameters() );
+
+  /**
+   * @brief setCamera sets the depth camera and builds its undistorted ray table.
+   */
+  void setCamera( const Camera& camera );
+  const Camera& camera() const { return camera_; }
+
+  /**
+   * @brief integrate fuses one depth image taken at a camera pose.
+   * @param depth const uint16_t* depth image [mm] of the camera size, 0 = invalid
+   * @param world_from_camera const Eigen::Affine3f& pose of the optical frame in the world
+   * @param pool ThreadPool* pool to run on, NULL to run on the calling thread
+   */
+  void integrate( const uint16_t* depth, const Eigen::Affine3f& world_from_camera, ThreadPool* pool );
+
+  /**
+   * @brief extractCloud returns the zero crossings of the distance field as points in the world.
+   * @param cloud pcl::PointCloud<pcl::PointXYZ>& output cloud
+   * @param min_weight float voxels observed less often are ignored
+   */
+  void extractCloud( pcl::PointCloud<pcl::PointXYZ>& cloud, float min_weight ) const;
+
+  void reset();
+
+  size_t blocks() const { return hash_.size(); }
+  size_t visibleBlocks() const { return visible_.size(); }
+  size_t evictedBlocks() const { return evicted_; }
+  size_t droppedBlocks() const { return dropped_; }
+
+private:
+
+  struct Voxel
+  {
+    float tsdf;
+    float weight;
+  };
+
+  struct Block
+  {
+    Eigen::Vector3i index;
+    uint64_t        last_used;
+    Voxel           voxels[ BLOCK_VOXELS ];
+  };
+
+  static uint64_t blockKey( const Eigen::Vector3i& index );
+
+  void collectBlocks( const uint16_t* depth, const Eigen::Affine3f& world_from_camera,
+                      size_t row_begin, size_t row_end, std::vector<uint64_t>& keys ) const;
+  void allocateBlocks( const std::vector< std::vector<uint64_t> >& keys );
+  void evictBlocks( size_t needed );
+  void integrateBlock( Block& block, const uint16_t* depth, const Eigen::Affine3f& camera_from_world ) const;
+  bool project( const Eigen::Vector3f& p, int& u, int& v ) const;
+  const Voxel* voxelAt( const Eigen::Vector3i& voxel ) const;
+
+  Parameters params_;
+  Camera     camera_;
+
+  // Undistorted ray ( x / z, y / z ) of every depth pixel
+  std::vector<float> ray_x_;
+  std::vector<float> ray_y_;
+
+  std::unordered_map<uint64_t, uint32_t> hash_;
+  std::vector<Block>                     blocks_;
+  std::vector<uint32_t>                  free_;
+  std::vector<uint32_t>                  visible_;
+
+  // Block keys collected by each strip, reused between frames
+  std::vector< std::vector<uint64_t> > keys_;
+
+  uint64_t frame_;
+  size_t   evicted_;
+  size_t   dropped_;
+};
+
+};
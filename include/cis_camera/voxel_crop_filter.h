@@ -0,0 +1,106 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include <cis_camera/thread_pool.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief VoxelCropFilter is a fused single pass replacement of pcl::VoxelGrid
+ * followed by an axis aligned crop (pcl::CropBox or PassThrough filters).
+ * Points are hashed into voxels in parallel, one hash map per task merged at
+ * the end, and the crop is applied to the voxel centroids, so the output is
+ * the same as the PCL chain within float tolerance and in the same order.
+ * Points in voxels which cannot reach the crop box are rejected before hashing.
+ */
+class VoxelCropFilter
+{
+public:
+
+  typedef pcl::PointXYZ           Point;
+  typedef pcl::PointCloud<Point>  Cloud;
+
+  VoxelCropFilter();
+
+  void setLeafSize( float leaf_size );
+  void setCrop( const Eigen::Vector3f& min, const Eigen::Vector3f& max );
+
+  /**
+   * @brief filter voxelizes and crops input into output.
+   * @param input const Cloud& input cloud, non-finite points are skipped
+   * @param output Cloud& voxel centroids inside the crop box
+   * @param pool ThreadPool* pool to hash on, NULL runs on the calling thread
+   */
+  void filter( const Cloud& input, Cloud& output, ThreadPool* pool = NULL );
+
+private:
+
+  struct Accumulator
+  {
+    double   x, y, z;
+    uint32_t n;
+
+    Accumulator() : x(0.0), y(0.0), z(0.0), n(0) {}
+  };
+
+  typedef std::unordered_map<uint64_t, Accumulator> VoxelMap;
+
+  void hashRange( const Cloud& input, size_t begin, size_t end, VoxelMap& voxels ) const;
+
+  float           inverse_leaf_;
+  Eigen::Vector3f crop_min_;
+  Eigen::Vector3f crop_max_;
+
+  // Voxel index range which can hold a centroid inside the crop box
+  int index_min_[3];
+  int index_max_[3];
+
+  // Kept across frames so the hash maps keep their buckets
+  std::vector<VoxelMap>                               voxels_;
+  std::vector<std::pair<uint64_t, Accumulator> >      merged_;
+};
+
+};
@@ -72,6 +72,9 @@
 
 
 #include "cis_camera/camera_driver.h"
+#include "cis_camera/pixel_kernels.h"
+#include "cis_camera/frame_kernels.h"
+#include "cis_camera/depth_edge_filter.h"
 
 #include <unistd.h>
 #include <ros/ros.h>
@@ -82,7 +85,13 @@
 #include <dynamic_reconfigure/server.h>
 #include <libuvc/libuvc.h>
 #include <math.h>
+#include <algorithm>
+#include <thread>
 #include <cv_bridge/cv_bridge.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <sensor_msgs/image_encodings.h>
+#include <tf/LinearMath/Matrix3x3.h>
 
 namespace cis_camera
 {
@@ -103,10 +112,20 @@ CameraDriver::CameraDriver( ros::NodeHandle nh, ros::NodeHandle priv_nh ) :
     it_(nh_),
     config_server_(mutex_, priv_nh_),
     config_changed_(false),
+    auto_suspend_(false),
+    suspend_grace_(5.0),
+    suspend_laser_off_(false),
+    suspended_(false),
+    resume_pending_(false),
+    resume_start_ns_(0),
+    frame_period_(1.0 / 30.0),
     cinfo_manager_(nh),
     cinfo_manager_ir_(nh),
     cinfo_manager_depth_(nh),
-    cinfo_manager_color_(nh)
+    cinfo_manager_color_(nh),
+    processor_loader_("cis_camera", "cis_camera::FrameProcessor"),
+    processor_report_(0.0),
+    worker_threads_(0)
 {
   readConfigFromParameterServer();
   advertiseROSTopics();
@@ -118,6 +137,8 @@ CameraDriver::CameraDriver( ros::NodeHandle nh, ros::NodeHandle priv_nh ) :
  */
 CameraDriver::~CameraDriver()
 {
+  stopFrameWorkers();
+  
   if ( rgb_frame_ )
     uvc_free_frame( rgb_frame_ );
   
@@ -137,6 +158,45 @@ void CameraDriver::readConfigFromParameterServer()
   err = priv_nh_.getParam( "camera_info_url_ir"   , camera_info_url_ir_    );
   err = priv_nh_.getParam( "camera_info_url_depth", camera_info_url_depth_ );
   err = priv_nh_.getParam( "camera_info_url_color", camera_info_url_color_ );
+  
+  priv_nh_.param( "worker_threads", worker_threads_, 0 );
+  workspace_.threads = worker_threads_;
+  
+  // Instruction set of the pixel kernels, the best one of the CPU unless forced for testing
+  std::string cpu_dispatch = "auto";
+  err = priv_nh_.getParam( "cpu_dispatch", cpu_dispatch );
+  
+  CpuLevel cpu_level = detectCpuLevel();
+  if ( not parseCpuLevel( cpu_dispatch, cpu_level ) )
+    ROS_WARN( "Unknown cpu_dispatch '%s' - Use the detected instruction set.", cpu_dispatch.c_str() );
+  else if ( pixelKernels( cpu_level ) == NULL )
+    ROS_WARN( "cpu_dispatch '%s' is not supported by this CPU or build - Use the detected instruction set.",
+              cpu_dispatch.c_str() );
+  
+  cpu_level = selectPixelKernels( cpu_level );
+  ROS_INFO( "Pixel kernels : %s (detected %s)", cpuLevelName( cpu_level ), cpuLevelName( detectCpuLevel() ) );
+  
+  // Frame processor stages, before the frame workers which order them
+  loadProcessors();
+  
+  // Frame-level parallelism: whole frames on frame_workers threads (0 = on the USB thread)
+  int frame_workers    = 0;
+  int frames_in_flight = 0;
+  priv_nh_.param( "frame_workers"   , frame_workers   , 0 );
+  priv_nh_.param( "frames_in_flight", frames_in_flight, 0 );
+  
+  if ( 0 < frame_workers )
+  {
+    if ( frames_in_flight <= 0 )
+      frames_in_flight = frame_workers + 1;
+    
+    frame_workers_.reset( new FrameWorkers<FrameJob>( frame_workers, frames_in_flight,
+                                                          frameSection( FrameSections ) ) );
+  }
+  
+  priv_nh_.param( "auto_suspend"     , auto_suspend_     , false );
+  priv_nh_.param( "suspend_grace"    , suspend_grace_    , 5.0 );
+  priv_nh_.param( "suspend_laser_off", suspend_laser_off_, false );
 }
 
 
@@ -155,11 +215,40 @@ void CameraDriver::advertiseROSTopics()
   ros::NodeHandle ir_nh( nh_, "ir" );
   image_transport::ImageTransport ir_it( ir_nh );
   
+  ros::NodeHandle depth_registered_nh( nh_, "depth_registered" );
+  image_transport::ImageTransport depth_registered_it( depth_registered_nh );
+  
+  // Subscriber (dis)connections of every frame output drive the auto-suspend
+  image_transport::SubscriberStatusCallback it_cb = boost::bind( &CameraDriver::ImageConnectCallback, this, _1 );
+  ros::SubscriberStatusCallback             cb    = boost::bind( &CameraDriver::ConnectCallback, this, _1 );
+  
   // Advertise Camera Pubishers
-  pub_camera_ = it_.advertiseCamera( "image_raw", 1, false );
-  pub_color_  = color_it.advertiseCamera( "image_raw", 1, false );
-  pub_depth_  = depth_it.advertiseCamera( "image_raw", 1, false );
-  pub_ir_     = ir_it.advertiseCamera( "image_raw", 1, false );
+  pub_camera_ = it_.advertiseCamera( "image_raw", 1, it_cb, it_cb, cb, cb );
+  pub_color_  = color_it.advertiseCamera( "image_raw", 1, it_cb, it_cb, cb, cb );
+  pub_depth_  = depth_it.advertiseCamera( "image_raw", 1, it_cb, it_cb, cb, cb );
+  pub_ir_     = ir_it.advertiseCamera( "image_raw", 1, it_cb, it_cb, cb, cb );
+  
+  // Advertise Rectified Image Publishers (Camera Infos are shared with image_raw)
+  pub_ir_rect_    = ir_it.advertise( "image_rect", 1, it_cb, it_cb );
+  pub_color_rect_ = color_it.advertise( "image_rect_color", 1, it_cb, it_cb );
+  
+  // Advertise Surface Normal Image Publisher (32FC3, shares depth/camera_info)
+  pub_normals_ = depth_it.advertise( "normals", 1, it_cb, it_cb );
+  
+  // Advertise Change Mask Publisher (mono8, one pixel per 16x16 depth tile)
+  pub_change_mask_ = depth_it.advertise( "change_mask", 1, it_cb, it_cb );
+  
+  // Advertise Upsampled Depth Publisher (depth on the color grid with rgb camera info)
+  pub_upsampled_ = depth_registered_it.advertiseCamera( "image_upsampled", 1, it_cb, it_cb, cb, cb );
+  
+  // Advertise Laser Scan Publisher (a band of the depth image)
+  pub_scan_ = nh_.advertise<sensor_msgs::LaserScan>( "scan", 1, cb, cb );
+  
+  // Advertise Height Map Publisher
+  pub_heightmap_ = nh_.advertise<cis_camera::HeightMap>( "heightmap", 1, cb, cb );
+  
+  // Advertise Compact Point Cloud Publisher (packed points of the depth image)
+  pub_cloud_ = nh_.advertise<sensor_msgs::PointCloud2>( "depth/points_compact", 1, cb, cb );
   
   // Set Publishers for TOF Camera Temperature
   std::string node_name = ros::this_node::getName();
@@ -201,7 +290,7 @@ bool CameraDriver::Start()
  */
 void CameraDriver::Stop()
 {
-  boost::recursive_mutex::scoped_lock( mutex_ );
+  boost::recursive_mutex::scoped_lock lock( mutex_ );
   
   if ( state_ == Running )
     CloseCamera();
@@ -219,7 +308,8 @@ void CameraDriver::Stop()
  */
 void CameraDriver::ReconfigureCallback( CISCameraConfig &new_config, uint32_t level )
 {
-  boost::recursive_mutex::scoped_lock( mutex_ );
+  // dynamic_reconfigure already holds mutex_ here; the recursive lock keeps that explicit.
+  boost::recursive_mutex::scoped_lock lock( mutex_ );
   
   if ( (level & ReconfigureClose) == ReconfigureClose )
   {
@@ -254,7 +344,8 @@ void CameraDriver::ReconfigureCallback( CISCameraConfig &new_config, uint32_t le
       setToFMode_ROSParameter( "pulse_count", new_config.pulse_count );
     }
     
-    if ( new_config.ld_enable != config_.ld_enable )
+    // While suspended with the laser off, resumeStreaming applies ld_enable
+    if ( new_config.ld_enable != config_.ld_enable && not ( suspended_ && suspend_laser_off_ ) )
     {
       setToFMode_ROSParameter( "ld_enable", new_config.ld_enable );
     }
@@ -283,120 +374,705 @@ void CameraDriver::ReconfigureCallback( CISCameraConfig &new_config, uint32_t le
     {
       setToFMode_ROSParameter( "color_correction", new_config.color_correction );
     }
-    
-    if ( new_config.r_gain != config_.r_gain )
-    {
-      r_gain_ = new_config.r_gain;
-    }
-    if ( new_config.g_gain != config_.g_gain )
-    {
-      g_gain_ = new_config.g_gain;
-    }
-    if ( new_config.b_gain != config_.b_gain )
-    {
-      b_gain_ = new_config.b_gain;
-    }
   }
   
   config_changed_ = true;
   config_ = new_config;
   
+  // Publish the new settings to the frame path
+  updateSettings();
+  
   return;
 }
 
 
 /**
- * @brief filterDepthImage effects filters on a image message with OpenCV
- * @param msg sensor_msgs::ImagePtr& image message pointer to be filtered
+ * @brief updateSettings builds a new immutable settings snapshot from the current
+ * configuration and publishes it to the frame path with an atomic store.
+ * The caller must hold mutex_. While the camera is not running a null snapshot
+ * is published so that frames arriving during a state transition are dropped.
  */
-void CameraDriver::filterDepthImage( sensor_msgs::ImagePtr& msg )
+void CameraDriver::updateSettings()
 {
-  cv_bridge::CvImagePtr cv_ptr;
+  if ( state_ != Running )
+  {
+    boost::atomic_store( &settings_, DriverSettingsConstPtr() );
+    return;
+  }
+  
+  boost::shared_ptr<DriverSettings> settings( new DriverSettings() );
+  
+  priv_nh_.getParam( "width"      , settings->frame_width  );
+  priv_nh_.getParam( "height"     , settings->frame_height );
+  priv_nh_.getParam( "color_width", settings->color_width  );
+  settings->frame_period = frame_period_;
+  
+  priv_nh_.getParam( "frame_id"      , settings->frame_id       );
+  priv_nh_.getParam( "frame_id_ir"   , settings->frame_id_ir    );
+  priv_nh_.getParam( "frame_id_depth", settings->frame_id_depth );
+  priv_nh_.getParam( "frame_id_color", settings->frame_id_color );
+  settings->frame_id_scan = "camera_scan";
+  priv_nh_.getParam( "frame_id_scan" , settings->frame_id_scan  );
+  settings->frame_id_heightmap = "camera_base";
+  priv_nh_.getParam( "frame_id_heightmap", settings->frame_id_heightmap );
+  
+  settings->r_gain = config_.r_gain;
+  settings->g_gain = config_.g_gain;
+  settings->b_gain = config_.b_gain;
+  
+  settings->color_output_scale = config_.color_output_scale;
+  
+  settings->depth_cnv_gain = depth_cnv_gain_;
+  settings->depth_offset   = depth_offset_;
+  
+  settings->depth_filter      = config_.depth_filter;
+  settings->blur_mode         = config_.blur_mode;
+  settings->edge_mode         = config_.edge_mode;
+  settings->dilate_iterations = config_.dilate_iterations;
+  
+  settings->ir_dist_reconfig = config_.ir_dist_reconfig;
+  settings->ir_fx = config_.ir_fx;
+  settings->ir_fy = config_.ir_fy;
+  settings->ir_cx = config_.ir_cx;
+  settings->ir_cy = config_.ir_cy;
+  settings->ir_k1 = config_.ir_k1;
+  settings->ir_k2 = config_.ir_k2;
+  settings->ir_k3 = config_.ir_k3;
+  settings->ir_p1 = config_.ir_p1;
+  settings->ir_p2 = config_.ir_p2;
+  
+  settings->rgb_dist_reconfig = config_.rgb_dist_reconfig;
+  settings->rgb_fx = config_.rgb_fx;
+  settings->rgb_fy = config_.rgb_fy;
+  settings->rgb_cx = config_.rgb_cx;
+  settings->rgb_cy = config_.rgb_cy;
+  settings->rgb_k1 = config_.rgb_k1;
+  settings->rgb_k2 = config_.rgb_k2;
+  settings->rgb_k3 = config_.rgb_k3;
+  settings->rgb_p1 = config_.rgb_p1;
+  settings->rgb_p2 = config_.rgb_p2;
+  
+  settings->rectify_ir    = config_.rectify_ir;
+  settings->rectify_color = config_.rectify_color;
+  
+  settings->scan_enable     = config_.scan_enable;
+  settings->scan_center_row = config_.scan_center_row;
+  settings->scan_height     = config_.scan_height;
+  settings->scan_range_min  = config_.scan_range_min;
+  settings->scan_range_max  = config_.scan_range_max;
+  
+  settings->change_trigger   = config_.change_trigger;
+  settings->change_threshold = config_.change_threshold;
+  settings->change_min_tiles = config_.change_min_tiles;
+  settings->change_keepalive = config_.change_keepalive;
+  
+  settings->upsample_enable      = config_.upsample_enable;
+  settings->upsample_radius      = config_.upsample_radius;
+  settings->upsample_sigma_space = config_.upsample_sigma_space;
+  settings->upsample_sigma_range = config_.upsample_sigma_range;
+  
+  // Default: camera_to_camera_ir and camera_to_camera_color of tof.launch
+  settings->depth_to_color.resize( 3 );
+  settings->depth_to_color[0] =  0.0265;
+  settings->depth_to_color[1] =  0.0;
+  settings->depth_to_color[2] = -0.0108;
+  
+  std::vector<double> depth_to_color;
+  if ( priv_nh_.getParam( "depth_to_color", depth_to_color ) )
+  {
+    if ( depth_to_color.size() == 3 )
+      settings->depth_to_color = depth_to_color;
+    else
+      ROS_WARN( "depth_to_color needs 3 values (x y z), got %d - Use the default.",
+                static_cast<int>( depth_to_color.size() ) );
+  }
+  
+  settings->normals_enable           = config_.normals_enable;
+  settings->normals_radius           = config_.normals_radius;
+  settings->normals_max_depth_change = config_.normals_max_depth_change;
+  
+  settings->cloud_enable       = config_.cloud_enable;
+  settings->cloud_encoding     = std::max( 0, std::min( static_cast<int>( CLOUD_FLOAT16 ), config_.cloud_encoding ) );
+  settings->cloud_drop_invalid = config_.cloud_drop_invalid;
   
-  try
+  settings->heightmap_enable = config_.heightmap_enable;
+  settings->heightmap_pose.assign( 6, 0.0 );
+  
+  std::vector<double> heightmap_pose;
+  if ( priv_nh_.getParam( "heightmap_depth_pose", heightmap_pose ) )
   {
-    cv_ptr = cv_bridge::toCvCopy( msg, "16UC1" );
+    if ( heightmap_pose.size() == 6 )
+      settings->heightmap_pose = heightmap_pose;
+    else
+      ROS_WARN( "heightmap_depth_pose needs 6 values (x y z yaw pitch roll), got %d - Use identity.",
+                static_cast<int>( heightmap_pose.size() ) );
   }
-  catch ( cv_bridge::Exception& e )
+  
+  HeightMapGrid& grid = settings->heightmap_grid;
+  grid.resolution = config_.heightmap_resolution;
+  grid.origin_x   = config_.heightmap_min_x;
+  grid.origin_y   = -0.5 * config_.heightmap_size_y;
+  grid.min_z      = config_.heightmap_min_z;
+  grid.max_z      = config_.heightmap_max_z;
+  grid.cells_x    = std::max( 1, static_cast<int>( ceil( ( config_.heightmap_max_x - config_.heightmap_min_x ) / grid.resolution ) ) );
+  grid.cells_y    = std::max( 1, static_cast<int>( ceil( config_.heightmap_size_y / grid.resolution ) ) );
+  
+  settings->calibration = buildCalibration( *settings );
+  
+  boost::atomic_store( &settings_, DriverSettingsConstPtr( settings ) );
+}
+
+
+/**
+ * @brief sameCameraInfo checks whether two camera infos describe the same calibration.
+ * @param a const sensor_msgs::CameraInfo& camera info to compare
+ * @param b const sensor_msgs::CameraInfo& camera info to compare
+ * @return bool true when size, distortion model, D, K, R, P, binning, ROI and frame ID are equal
+ */
+static bool sameCameraInfo( const sensor_msgs::CameraInfo& a, const sensor_msgs::CameraInfo& b )
+{
+  return a.header.frame_id   == b.header.frame_id   &&
+         a.width             == b.width             &&
+         a.height            == b.height            &&
+         a.distortion_model  == b.distortion_model  &&
+         a.D                 == b.D                 &&
+         a.K                 == b.K                 &&
+         a.R                 == b.R                 &&
+         a.P                 == b.P                 &&
+         a.binning_x         == b.binning_x         &&
+         a.binning_y         == b.binning_y         &&
+         a.roi.x_offset      == b.roi.x_offset      &&
+         a.roi.y_offset      == b.roi.y_offset      &&
+         a.roi.width         == b.roi.width         &&
+         a.roi.height        == b.roi.height        &&
+         a.roi.do_rectify    == b.roi.do_rectify;
+}
+
+
+/**
+ * @brief setIntrinsics overwrites the focal lengths, the principal point and
+ * the plumb bob distortion coefficients of a camera info.
+ */
+static void setIntrinsics( sensor_msgs::CameraInfo& cinfo,
+                           double fx, double fy, double cx, double cy,
+                           double k1, double k2, double k3, double p1, double p2 )
+{
+  if ( cinfo.D.size() < 5 )
+    cinfo.D.resize( 5, 0.0 );
+  
+  cinfo.K[0] = fx;
+  cinfo.K[4] = fy;
+  cinfo.K[2] = cx;
+  cinfo.K[5] = cy;
+  cinfo.D[0] = k1;
+  cinfo.D[1] = k2;
+  cinfo.D[2] = p1;
+  cinfo.D[3] = p2;
+  cinfo.D[4] = k3;
+}
+
+
+/**
+ * @brief scaleCameraInfo scales the intrinsics and the projection of a camera info
+ * to an image resampled from src_width x src_height to width x height pixels.
+ * Pixel centers are kept aligned, i.e. source x maps to ( x + 0.5 ) * scale - 0.5.
+ */
+static void scaleCameraInfo( sensor_msgs::CameraInfo& cinfo, int src_width, int src_height, int width, int height )
+{
+  double sx = static_cast<double>( width )  / src_width;
+  double sy = static_cast<double>( height ) / src_height;
+  
+  cinfo.K[0] *= sx;
+  cinfo.K[2]  = ( cinfo.K[2] + 0.5 ) * sx - 0.5;
+  cinfo.K[4] *= sy;
+  cinfo.K[5]  = ( cinfo.K[5] + 0.5 ) * sy - 0.5;
+  
+  cinfo.P[0] *= sx;
+  cinfo.P[2]  = ( cinfo.P[2] + 0.5 ) * sx - 0.5;
+  cinfo.P[3] *= sx;
+  cinfo.P[5] *= sy;
+  cinfo.P[6]  = ( cinfo.P[6] + 0.5 ) * sy - 0.5;
+  cinfo.P[7] *= sy;
+  
+  cinfo.width  = width;
+  cinfo.height = height;
+}
+
+
+/**
+ * @brief buildRectifyTable builds a fixed-point rectification table from a camera info
+ * in the same way as image_geometry/image_proc do (K, D, R and the P matrix as new camera).
+ * The output may be smaller than the source image, then P is scaled to the output size
+ * while K and D keep addressing the full resolution source.
+ * @param cinfo const sensor_msgs::CameraInfo& camera info of the source image
+ * @param src_width int source image width
+ * @param src_height int source image height
+ * @param width int output image width
+ * @param height int output image height
+ * @param table RemapTable& table to fill
+ */
+static void buildRectifyTable( const sensor_msgs::CameraInfo& cinfo, int src_width, int src_height,
+                               int width, int height, RemapTable& table )
+{
+  cv::Matx33d K( &(cinfo.K[0]) );
+  cv::Matx33d R( &(cinfo.R[0]) );
+  cv::Matx33d P( cinfo.P[0], cinfo.P[1], cinfo.P[2],
+                 cinfo.P[4], cinfo.P[5], cinfo.P[6],
+                 cinfo.P[8], cinfo.P[9], cinfo.P[10] );
+  cv::Mat D( cinfo.D );
+  
+  // Uncalibrated camera infos have all-zero matrices
+  if ( P(0,0) == 0.0 ) P = K;
+  if ( R(0,0) == 0.0 ) R = cv::Matx33d::eye();
+  
+  if ( K(0,0) == 0.0 || width <= 0 || height <= 0 || src_width <= 0 || src_height <= 0 )
   {
-    ROS_ERROR( "cv_bridge exception: %s", e.what() );
+    table = RemapTable();
     return;
   }
   
-  cv::Mat &src_img = cv_ptr->image;
+  if ( width != src_width || height != src_height )
+  {
+    double sx = static_cast<double>( width )  / src_width;
+    double sy = static_cast<double>( height ) / src_height;
+    
+    P(0,0) *= sx;
+    P(0,2)  = ( P(0,2) + 0.5 ) * sx - 0.5;
+    P(1,1) *= sy;
+    P(1,2)  = ( P(1,2) + 0.5 ) * sy - 0.5;
+  }
   
-  // Median Blur Filter
-  int median_blur_size = 3;
-  cv::Mat blr_img;
+  cv::Mat map_x, map_y;
+  cv::initUndistortRectifyMap( K, D, R, P, cv::Size( width, height ), CV_32FC1, map_x, map_y );
   
-  int blur_mode = 0;
-  priv_nh_.getParam( "blur_mode", blur_mode );
-  if ( blur_mode == 1 )
-    cv::medianBlur( src_img, blr_img, median_blur_size );
-  else
-    cv::GaussianBlur( src_img, blr_img, cv::Size(3, 3), 0, 0, cv::BORDER_DEFAULT);
+  buildRemapTable( map_x.ptr<float>(), map_y.ptr<float>(), width, height, src_width, src_height, table );
+}
+
+
+/**
+ * @brief buildCalibration builds the prebuilt camera infos and the depth ray table
+ * for a settings snapshot. The previous calibration is returned as is when nothing
+ * changed, so the ray table is only recomputed on real calibration changes.
+ * The caller must hold mutex_.
+ * @param settings const DriverSettings& settings the calibration is built for
+ * @return CalibrationConstPtr of the calibration to use
+ */
+CalibrationConstPtr CameraDriver::buildCalibration( const DriverSettings& settings )
+{
+  sensor_msgs::CameraInfoPtr cinfo( new sensor_msgs::CameraInfo( cinfo_manager_.getCameraInfo() ) );
+  sensor_msgs::CameraInfoPtr cinfo_ir( new sensor_msgs::CameraInfo( cinfo_manager_ir_.getCameraInfo() ) );
+  sensor_msgs::CameraInfoPtr cinfo_depth( new sensor_msgs::CameraInfo( cinfo_manager_depth_.getCameraInfo() ) );
+  sensor_msgs::CameraInfoPtr cinfo_color( new sensor_msgs::CameraInfo( cinfo_manager_color_.getCameraInfo() ) );
   
-  // Edge Extraction
-  int edge_threshold    = 128;
-  int dilate_iterations = 2;
-  priv_nh_.getParam( "dilate_iterations", dilate_iterations );
-  cv::Mat edg_img;
+  cinfo->header.frame_id       = settings.frame_id;
+  cinfo_ir->header.frame_id    = settings.frame_id_ir;
+  cinfo_depth->header.frame_id = settings.frame_id_depth;
+  cinfo_color->header.frame_id = settings.frame_id_color;
   
-  int edge_mode = 0;
-  priv_nh_.getParam( "edge_mode", edge_mode );
-  if ( edge_mode == 1 )
+  // Camera Info. Dynamic Reconfigure
+  if ( settings.rgb_dist_reconfig )
   {
-    cv::Laplacian( blr_img, edg_img, CV_32F, 3 );
+    setIntrinsics( *cinfo_color,
+                   settings.rgb_fx, settings.rgb_fy, settings.rgb_cx, settings.rgb_cy,
+                   settings.rgb_k1, settings.rgb_k2, settings.rgb_k3, settings.rgb_p1, settings.rgb_p2 );
   }
-  else
+  
+  if ( settings.ir_dist_reconfig )
+  {
+    setIntrinsics( *cinfo_ir,
+                   settings.ir_fx, settings.ir_fy, settings.ir_cx, settings.ir_cy,
+                   settings.ir_k1, settings.ir_k2, settings.ir_k3, settings.ir_p1, settings.ir_p2 );
+    setIntrinsics( *cinfo_depth,
+                   settings.ir_fx, settings.ir_fy, settings.ir_cx, settings.ir_cy,
+                   settings.ir_k1, settings.ir_k2, settings.ir_k3, settings.ir_p1, settings.ir_p2 );
+  }
+  
+  int depth_width  = settings.frame_width - settings.color_width;
+  int depth_height = settings.frame_height / 2;
+  
+  // Color Output Size. Exact 1/2 and 1/4 scales are binned, anything else is area filtered.
+  int src_color_width  = settings.color_width;
+  int src_color_height = settings.frame_height;
+  
+  double color_scale = std::min( 1.0, std::max( 0.1, settings.color_output_scale ) );
+  
+  int color_width   = src_color_width;
+  int color_height  = src_color_height;
+  int color_binning = 1;
+  
+  if ( color_scale < 1.0 )
+  {
+    color_width   = std::max( 2, static_cast<int>( floor( src_color_width  * color_scale + 0.5 ) ) );
+    color_height  = std::max( 1, static_cast<int>( floor( src_color_height * color_scale + 0.5 ) ) );
+    color_binning = 0;
+    
+    for ( int factor = 2; factor <= 4; factor *= 2 )
+    {
+      if ( src_color_width % ( 2 * factor ) == 0 && src_color_height % factor == 0 &&
+           color_width == src_color_width / factor && color_height == src_color_height / factor )
+        color_binning = factor;
+    }
+    
+    if ( color_width != src_color_width || color_height != src_color_height )
+      scaleCameraInfo( *cinfo_color, src_color_width, src_color_height, color_width, color_height );
+    else
+      color_binning = 1;
+  }
+  
+  // Laser Scan Band
+  int scan_row_begin = std::max( 0, settings.scan_center_row - settings.scan_height / 2 );
+  int scan_rows      = std::max( 1, std::min( settings.scan_height, depth_height - scan_row_begin ) );
+  
+  if ( calibration_ &&
+       ( not settings.rectify_ir    || not calibration_->rect_ir.empty()    ) &&
+       ( not settings.rectify_color || not calibration_->rect_color.empty() ) &&
+       ( not settings.scan_enable   || ( not calibration_->scan.empty() &&
+                                         calibration_->scan.row_begin == scan_row_begin &&
+                                         calibration_->scan.rows      == scan_rows ) ) &&
+       ( not settings.heightmap_enable || ( not calibration_->heightmap.empty() &&
+                                            calibration_->heightmap_pose == settings.heightmap_pose ) ) &&
+       ( not settings.upsample_enable  || ( not calibration_->upsample_kernel.empty() &&
+                                            calibration_->upsample_kernel.radius      == settings.upsample_radius &&
+                                            calibration_->upsample_kernel.sigma_space == static_cast<float>( settings.upsample_sigma_space ) &&
+                                            calibration_->upsample_kernel.sigma_range == static_cast<float>( settings.upsample_sigma_range ) &&
+                                            calibration_->upsample_translation == settings.depth_to_color ) ) &&
+       calibration_->depth_width  == depth_width  &&
+       calibration_->depth_height == depth_height &&
+       calibration_->color_width   == color_width   &&
+       calibration_->color_height  == color_height  &&
+       calibration_->color_binning == color_binning &&
+       sameCameraInfo( *(calibration_->cinfo)      , *cinfo       ) &&
+       sameCameraInfo( *(calibration_->cinfo_ir)   , *cinfo_ir    ) &&
+       sameCameraInfo( *(calibration_->cinfo_depth), *cinfo_depth ) &&
+       sameCameraInfo( *(calibration_->cinfo_color), *cinfo_color ) )
+  {
+    return calibration_;
+  }
+  
+  boost::shared_ptr<Calibration> calibration( new Calibration() );
+  calibration->cinfo       = cinfo;
+  calibration->cinfo_ir    = cinfo_ir;
+  calibration->cinfo_depth = cinfo_depth;
+  calibration->cinfo_color = cinfo_color;
+  
+  calibration->depth_width  = depth_width;
+  calibration->depth_height = depth_height;
+  
+  calibration->color_width   = color_width;
+  calibration->color_height  = color_height;
+  calibration->color_binning = color_binning;
+  
+  if ( color_binning == 0 )
+  {
+    buildAreaWeights( src_color_width,  color_width,  calibration->color_area_x );
+    buildAreaWeights( src_color_height, color_height, calibration->color_area_y );
+  }
+  
+  // Depth Rays for Cartesian Coordinate System
+  double fx = cinfo_depth->K[0];
+  double fy = cinfo_depth->K[4];
+  double cx = cinfo_depth->K[2];
+  double cy = cinfo_depth->K[5];
+  
+  double d[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  for ( size_t i = 0; i < cinfo_depth->D.size() && i < 5; i++ )
+    d[i] = cinfo_depth->D[i];
+  
+  double k1 = d[0];
+  double k2 = d[1];
+  double p1 = d[2];
+  double p2 = d[3];
+  double k3 = d[4];
+  
+  if ( fx <= 0 ) fx = depth_width / 2;
+  if ( fy <= 0 ) fy = depth_height / 2;
+  
+  int depth_pixels = ( 0 < depth_width && 0 < depth_height ) ? depth_width * depth_height : 0;
+  calibration->ray_x.resize( depth_pixels );
+  calibration->ray_y.resize( depth_pixels );
+  calibration->ray_inv_norm.resize( depth_pixels );
+  
+  double xp, yp, x2, y2, r2, r4, r6, k0, s0;
+  double xp_mod, yp_mod;
+  
+  for ( int i = 0; i < depth_height && 0 < depth_pixels; i++ )
+  {
+    yp = ( i - cy ) / fy;
+    y2 = yp * yp;
+    
+    for ( int j = 0; j < depth_width; j++ )
+    {
+      xp = ( j - cx ) / fx;
+      x2 = xp * xp;
+      
+      // Lens Distortion Correction
+      r2  = x2 + y2;
+      r4  = r2 * r2;
+      r6  = r2 * r4;
+      k0  = 1.0 + k1 * r2 + k2 * r4 + k3 * r6;
+      xp_mod = xp * k0 + 2.0 * p1 * xp * yp + p2 * ( r2 + 2.0 * x2 );
+      yp_mod = yp * k0 + 2.0 * p2 * xp * yp + p1 * ( r2 + 2.0 * y2 );
+      
+      s0 = sqrt( fabs( xp_mod * xp_mod + yp_mod * yp_mod + 1.0 ) );
+      
+      if ( s0 <= 0 ) s0 = 1.0;
+      
+      calibration->ray_x[ i*depth_width + j ]        = static_cast<float>( xp_mod );
+      calibration->ray_y[ i*depth_width + j ]        = static_cast<float>( yp_mod );
+      calibration->ray_inv_norm[ i*depth_width + j ] = static_cast<float>( 1.0 / s0 );
+    }
+  }
+  
+  // Rectification Tables
+  if ( settings.rectify_ir )
+    buildRectifyTable( *cinfo_ir, depth_width, depth_height, depth_width, depth_height, calibration->rect_ir );
+  
+  // The color camera info is already scaled, so rectify from the unscaled one
+  if ( settings.rectify_color )
+  {
+    sensor_msgs::CameraInfo cinfo_color_src( cinfo_manager_color_.getCameraInfo() );
+    if ( settings.rgb_dist_reconfig )
+    {
+      setIntrinsics( cinfo_color_src,
+                     settings.rgb_fx, settings.rgb_fy, settings.rgb_cx, settings.rgb_cy,
+                     settings.rgb_k1, settings.rgb_k2, settings.rgb_k3, settings.rgb_p1, settings.rgb_p2 );
+    }
+    buildRectifyTable( cinfo_color_src, src_color_width, src_color_height,
+                       color_width, color_height, calibration->rect_color );
+  }
+  
+  // Laser Scan Table, from the same undistorted rays as the depth correction
+  if ( settings.scan_enable && 0 < depth_pixels && scan_row_begin < depth_height )
+  {
+    buildScanTable( &(calibration->ray_x[0]), depth_width, depth_height,
+                    scan_row_begin, scan_rows, calibration->scan );
+    ROS_INFO( "Laser scan: rows %d-%d, %d beams from %.3f to %.3f rad", scan_row_begin,
+              scan_row_begin + scan_rows - 1, calibration->scan.beams, calibration->scan.angle_min,
+              calibration->scan.angle_min + calibration->scan.angle_increment * ( calibration->scan.beams - 1 ) );
+  }
+  
+  // Depth Upsampling, projected with the (scaled) color camera info like the published color image
+  if ( settings.upsample_enable )
+  {
+    PinholeModel& model = calibration->upsample_color;
+    model.fx = cinfo_color->K[0];
+    model.fy = cinfo_color->K[4];
+    model.cx = cinfo_color->K[2];
+    model.cy = cinfo_color->K[5];
+    if ( 5 <= cinfo_color->D.size() )
+    {
+      model.k1 = cinfo_color->D[0];
+      model.k2 = cinfo_color->D[1];
+      model.p1 = cinfo_color->D[2];
+      model.p2 = cinfo_color->D[3];
+      model.k3 = cinfo_color->D[4];
+    }
+    
+    buildBilateralKernel( settings.upsample_radius, settings.upsample_sigma_space, settings.upsample_sigma_range,
+                          calibration->upsample_kernel );
+    calibration->upsample_translation = settings.depth_to_color;
+  }
+  
+  // Height Map Table, the depth rays rotated into the height map frame
+  if ( settings.heightmap_enable && 0 < depth_pixels && settings.heightmap_pose.size() == 6 )
   {
-    cv::Mat sbx_img, sby_img;
-    cv::Sobel( blr_img, sbx_img, CV_32F, 1, 0 );
-    cv::Sobel( blr_img, sby_img, CV_32F, 0, 1 );
-    edg_img = ( cv::abs( sbx_img ) + cv::abs( sby_img ) ) / 2.0;
+    const std::vector<double>& pose = settings.heightmap_pose;
+    
+    tf::Matrix3x3 m;
+    m.setEulerYPR( pose[3], pose[4], pose[5] );
+    
+    double rotation[9];
+    for ( int r = 0; r < 3; r++ )
+      for ( int c = 0; c < 3; c++ )
+        rotation[ r*3 + c ] = m[r][c];
+    
+    buildHeightMapTable( &(calibration->ray_x[0]), &(calibration->ray_y[0]), depth_width, depth_height,
+                         rotation, &(pose[0]), calibration->heightmap );
+    calibration->heightmap_pose = pose;
   }
   
-  cv::convertScaleAbs( edg_img, edg_img, 1, 0 );
-  cv::threshold( edg_img, edg_img, edge_threshold, 255, cv::THRESH_BINARY|cv::THRESH_OTSU );
-  cv::dilate( edg_img, edg_img, cv::Mat(), cv::Point(-1,-1), dilate_iterations );
+  ROS_INFO( "Calibration updated - Depth fx: %.3f fy: %.3f cx: %.3f cy: %.3f", fx, fy, cx, cy );
+  ROS_INFO( "Color output: %dx%d (%s)", color_width, color_height,
+            color_binning == 1 ? "full" : ( color_binning == 0 ? "area filter" : "binning" ) );
+  
+  calibration_ = calibration;
+  return calibration_;
+}
+
+
+/**
+ * @brief CalibrationTimerCallback picks up camera infos changed through the
+ * set_camera_info services of the CameraInfoManagers and republishes the
+ * settings snapshot when the calibration differs.
+ */
+void CameraDriver::CalibrationTimerCallback( const ros::TimerEvent& event )
+{
+  boost::recursive_mutex::scoped_lock lock( mutex_ );
+  
+  if ( state_ != Running )
+    return;
+  
+  DriverSettingsConstPtr settings = loadSettings();
+  if ( not settings )
+    return;
+  
+  CalibrationConstPtr calibration = buildCalibration( *settings );
+  if ( calibration != settings->calibration )
+  {
+    boost::shared_ptr<DriverSettings> updated( new DriverSettings( *settings ) );
+    updated->calibration = calibration;
+    boost::atomic_store( &settings_, DriverSettingsConstPtr( updated ) );
+  }
+}
+
+
+/**
+ * @brief loadSettings returns the current settings snapshot without blocking.
+ * @return DriverSettingsConstPtr of the snapshot, or NULL while the camera is not running.
+ */
+DriverSettingsConstPtr CameraDriver::loadSettings() const
+{
+  return boost::atomic_load( &settings_ );
+}
+
+
+/**
+ * @brief loadProcessors loads the FrameProcessor stages listed in the processors parameter
+ * with pluginlib, by default the built-in cis_camera/DepthEdgeFilter. A stage gets the name
+ * of its class (cis_camera/DepthEdgeFilter -> DepthEdgeFilter) and a private node handle
+ * in that namespace. Stages which fail to load are skipped, except the built-in DepthEdgeFilter
+ * which is then created directly so depth_filter keeps working without the plugin library.
+ */
+void CameraDriver::loadProcessors()
+{
+  std::vector<std::string> types;
+  types.push_back( "cis_camera/DepthEdgeFilter" );
+  priv_nh_.param( "processors", types, types );
+  priv_nh_.param( "processor_report", processor_report_, 0.0 );
+  
+  processors_.clear();
   
-  // Set Depth Data as NaN on the Edges
-  for ( int i = 0; i < edg_img.rows; i++ )
+  for ( size_t i = 0; i < types.size(); i++ )
   {
-    for ( int j = 0; j < edg_img.cols; j++ )
+    ProcessorStage stage;
+    stage.name = types[i].substr( types[i].find( '/' ) + 1 );
+    
+    try
+    {
+      stage.processor = processor_loader_.createInstance( types[i] );
+      stage.processor->initialize( stage.name, nh_, ros::NodeHandle( priv_nh_, stage.name ) );
+    }
+    catch ( std::exception& e )
     {
-      if ( 0 < edg_img.at<uint8_t>(i,j) )
+      if ( types[i] != "cis_camera/DepthEdgeFilter" )
       {
-        src_img.at<uint16_t>(i,j) = 0;
+        ROS_ERROR( "Frame processor %s: %s - Skip this stage.", types[i].c_str(), e.what() );
+        continue;
       }
+      
+      // Part of the driver, the plugin is only the way to order it among other stages
+      ROS_WARN( "Frame processor %s: %s - Use the built-in one.", types[i].c_str(), e.what() );
+      stage.processor.reset( new DepthEdgeFilter() );
+      stage.processor->initialize( stage.name, nh_, ros::NodeHandle( priv_nh_, stage.name ) );
     }
+    
+    stage.ordered = stage.processor->ordered();
+    processors_.push_back( stage );
+    
+    ROS_INFO( "Frame processor %lu: %s%s", static_cast<unsigned long>( processors_.size() ),
+              types[i].c_str(), stage.ordered ? " (ordered)" : "" );
+  }
+}
+
+
+/**
+ * @brief runProcessors runs the frame processor stages on a frame in the configured order.
+ * Ordered stages run in their own section of the ticket, so they see one frame at a
+ * time in capture order. The time of each stage goes to processor_timer_.
+ * @param view FrameView& views of the frame planes
+ * @param ticket FrameTicket& passage of the frame through the ordered sections
+ * @return bool false when a stage dropped the frame
+ */
+bool CameraDriver::runProcessors( FrameView& view, FrameTicket& ticket )
+{
+  for ( size_t i = 0; i < processors_.size(); i++ )
+  {
+    ProcessorStage& stage = processors_[i];
+    bool keep = true;
+    
+    std::function<void()> run = [&]()
+    {
+      ros::WallTime start = ros::WallTime::now();
+      try
+      {
+        keep = stage.processor->process( view );
+      }
+      catch ( std::exception& e )
+      {
+        ROS_ERROR_THROTTLE( 5.0, "Frame processor %s: %s", stage.name.c_str(), e.what() );
+      }
+      processor_timer_.add( stage.name, ( ros::WallTime::now() - start ).toSec() * 1000.0 );
+    };
+    
+    if ( stage.ordered )
+      ticket.ordered( i, run );
+    else
+      run();
+    
+    if ( not keep )
+      return false;
   }
   
-  msg = cv_ptr->toImageMsg();
+  return true;
+}
+
+
+/**
+ * @brief ProcessorReportCallback logs the timing of the frame processor stages.
+ */
+void CameraDriver::ProcessorReportCallback( const ros::TimerEvent& event )
+{
+  ROS_INFO_STREAM( "Frame processor timing [ms]:\n" << processor_timer_.report() );
 }
 
 
 /**
- * @brief cvtDoubleToByte converts double type value to 0-255 limited integer.
- * @param x double value to convert
- * @return uint8_t of the limited integer
+ * @brief setCloudFields describes the packed point layout of an encoding in a PointCloud2.
+ * PointField has no half float datatype, so half floats are UINT16 fields named
+ * x_half, y_half and z_half, which tools do not mistake for coordinates.
+ * @param encoding CloudEncoding point layout
+ * @param cloud sensor_msgs::PointCloud2& cloud to set fields, point_step and byte order of
  */
-uint8_t cvtDoubleToByte( double x )
+static void setCloudFields( CloudEncoding encoding, sensor_msgs::PointCloud2& cloud )
 {
-  if ( x < 0 )        return 0;
-  else if ( 255 < x ) return 255;
+  static const char* names[3]      = { "x", "y", "z" };
+  static const char* half_names[3] = { "x_half", "y_half", "z_half" };
+  
+  uint8_t datatype = sensor_msgs::PointField::FLOAT32;
+  if ( encoding == CLOUD_INT16_MM )
+    datatype = sensor_msgs::PointField::INT16;
+  else if ( encoding == CLOUD_FLOAT16 )
+    datatype = sensor_msgs::PointField::UINT16;
+  
+  const int size = cloudPointStep( encoding ) / 3;
   
-  return static_cast<uint8_t>( x );
+  cloud.fields.resize( 3 );
+  for ( int i = 0; i < 3; i++ )
+  {
+    cloud.fields[i].name     = encoding == CLOUD_FLOAT16 ? half_names[i] : names[i];
+    cloud.fields[i].offset   = i * size;
+    cloud.fields[i].datatype = datatype;
+    cloud.fields[i].count    = 1;
+  }
+  cloud.point_step   = 3 * size;
+  cloud.is_bigendian = false;
 }
 
 
 /**
- * @brief ImageCallback is a method to process a camera image.
- * This method disassembles the whole one image in *frame to a color image, 
- * an IR image and a depth image. The color image is converted from yuv422 data
- * to bgr8 data. The depth data is converted from the distances from the camera
- * element to the distances from the camera plane.
- * The images are published as ROS sensor_msgs::Image topics.
+ * @brief ImageCallback is a method to accept a camera image.
+ * This method copies the whole one image in *frame with the settings snapshot
+ * and processes it with processFrame, right here or on the next free frame worker.
  * @param *frame uvc_frame_t image frame pointer of RGB/IR/Depth combined data
  */
 void CameraDriver::ImageCallback( uvc_frame_t *frame )
@@ -407,323 +1083,629 @@ void CameraDriver::ImageCallback( uvc_frame_t *frame )
     timestamp = ros::Time::now();
   }
   
-  boost::recursive_mutex::scoped_lock(mutex_);
+  // Grab the settings snapshot once for the whole frame. The snapshot is NULL
+  // while the camera is not running, so no state_ check (or lock) is needed here.
+  DriverSettingsConstPtr settings = loadSettings();
   
-  if ( state_ != Running || not rgb_frame_ )
+  if ( not settings )
   {
     return;
   }
   
+  // First frame after an auto-suspend: report the full restart time
+  if ( resume_pending_.exchange( false ) )
+  {
+    ROS_INFO( "First frame %.1f ms after resuming the stream.",
+              ( ros::WallTime::now().toNSec() - resume_start_ns_.load() ) / 1.0e6 );
+  }
+  
   // Checking Depth Conversion Gain
-  if ( depth_cnv_gain_ <= 0.000001 )
+  if ( settings->depth_cnv_gain <= 0.000001 )
   {
-    double dcg = depth_cnv_gain_;
-    getToFDepthCnvGain( depth_cnv_gain_ );
-    ROS_WARN( "Wrong Depth Cnv Gain: %lf -> Re-get Depth Cnv Gain: %lf", dcg, depth_cnv_gain_ );
-    
-    unsigned short max_data;
-    unsigned short min_dist;
-    unsigned short max_dist;
-    getToFDepthInfo( depth_offset_, max_data, min_dist, max_dist );
-    ROS_INFO( "Get Depth Info - Offset: %d / Max Data : %d / min Distance : %d [mm] MAX Distance :%d [mm]",
-                depth_offset_, max_data, min_dist, max_dist );
+    // Camera controls are serialized by mutex_. Never block the frame path on it:
+    // if a state transition holds the lock, retry on a later frame.
+    boost::recursive_mutex::scoped_try_lock lock( mutex_ );
+    if ( lock && state_ == Running )
+    {
+      double dcg = depth_cnv_gain_;
+      getToFDepthCnvGain( depth_cnv_gain_ );
+      ROS_WARN( "Wrong Depth Cnv Gain: %lf -> Re-get Depth Cnv Gain: %lf", dcg, depth_cnv_gain_ );
+      
+      unsigned short max_data;
+      unsigned short min_dist;
+      unsigned short max_dist;
+      getToFDepthInfo( depth_offset_, max_data, min_dist, max_dist );
+      ROS_INFO( "Get Depth Info - Offset: %d / Max Data : %d / min Distance : %d [mm] MAX Distance :%d [mm]",
+                  depth_offset_, max_data, min_dist, max_dist );
+      
+      updateSettings();
+      settings = loadSettings();
+      if ( not settings )
+      {
+        return;
+      }
+    }
+  }
+  
+  if ( frame->frame_format != UVC_FRAME_FORMAT_GRAY16 )
+  {
+    return;
   }
   
-  int    err;
-  int    frame_width  = 1920;
-  int    frame_height = 960;
-  int    color_width  = 1280;
-  double frame_rate   = 30.0;
+  if ( frame->data_bytes != ( settings->frame_width * settings->frame_height * sizeof(uint16_t) ) )
+  {
+    ROS_WARN( "Image Frame: Unexpected Data Size (%ld Bytes) - Skip this frame."
+              , frame->data_bytes );
+    return;
+  }
   
-  err = priv_nh_.getParam( "width"      , frame_width  );
-  err = priv_nh_.getParam( "height"     , frame_height );
-  err = priv_nh_.getParam( "color_width", color_width  );
+  // With frame workers, the frame is copied to a job of the worker pool. When all
+  // frames_in_flight jobs are in work, this newest frame is dropped.
+  FrameJob                         local_job;
+  FrameJob*                        job = &local_job;
+  FrameWorkers<FrameJob>::FramePtr worker_job;
   
-  sensor_msgs::Image::Ptr image( new sensor_msgs::Image() );
-  image->width  = frame_width;
-  image->height = frame_height;
-  image->step   = image->width * 2;
-  image->data.resize( image->step * image->height );
+  if ( frame_workers_ )
+  {
+    worker_job = frame_workers_->acquire();
+    if ( not worker_job )
+    {
+      ROS_WARN_THROTTLE( 5.0, "Image Frame: %lu frames in flight - Skip this frame.",
+                         static_cast<unsigned long>( frame_workers_->maxInFlight() ) );
+      return;
+    }
+    job = worker_job.get();
+  }
+  
+  job->timestamp = timestamp;
+  job->settings  = settings;
+  job->image.reset( new sensor_msgs::Image() );
+  job->image->encoding = "16UC1";
+  job->image->width    = settings->frame_width;
+  job->image->height   = settings->frame_height;
+  job->image->step     = job->image->width * 2;
+  job->image->data.resize( job->image->step * job->image->height );
+  memcpy( &(job->image->data[0]), frame->data, frame->data_bytes );
+  
+  if ( worker_job )
+  {
+    frame_workers_->push( worker_job );
+    return;
+  }
+  
+  FrameTicket ticket;
+  processFrame( *job, workspace_, ticket );
+}
+
+
+/**
+ * @brief processFrame is a method to process a camera image.
+ * This method disassembles the whole one image of the job to a color image, 
+ * an IR image and a depth image. The color image is converted from yuv422 data
+ * to bgr8 data, decimated to color_output_scale in the same pass. The depth data is converted from the distances from the camera
+ * element to the distances from the camera plane.
+ * The images are published as ROS sensor_msgs::Image topics.
+ * Frames may be processed concurrently by the frame workers: the stateful change-triggered
+ * check and the publishing run in the ordered sections of the ticket, everything else
+ * only touches the job and the workspace of the calling thread.
+ * @param job FrameJob& copied frame with its timestamp and settings snapshot
+ * @param ws FrameWorkspace& message pools and scratch buffers of the calling thread
+ * @param ticket FrameTicket& passage of the frame through the ordered sections
+ */
+void CameraDriver::processFrame( FrameJob& job, FrameWorkspace& ws, FrameTicket& ticket )
+{
+  const DriverSettingsConstPtr& settings  = job.settings;
+  const ros::Time&              timestamp = job.timestamp;
+  
+  int frame_width  = settings->frame_width;
+  int frame_height = settings->frame_height;
+  int color_width  = settings->color_width;
+  
+  sensor_msgs::Image::Ptr image = job.image;
   
   sensor_msgs::Image::Ptr image_bgr8( new sensor_msgs::Image() );
   sensor_msgs::Image::Ptr image_depth( new sensor_msgs::Image() );
   sensor_msgs::Image::Ptr image_ir( new sensor_msgs::Image() );
   
-  sensor_msgs::CameraInfo::Ptr cinfo( new sensor_msgs::CameraInfo( cinfo_manager_.getCameraInfo() ) );
-  sensor_msgs::CameraInfo::Ptr cinfo_ir( new sensor_msgs::CameraInfo( cinfo_manager_ir_.getCameraInfo() ) );
-  sensor_msgs::CameraInfo::Ptr cinfo_depth( new sensor_msgs::CameraInfo( cinfo_manager_depth_.getCameraInfo() ) );
-  sensor_msgs::CameraInfo::Ptr cinfo_color( new sensor_msgs::CameraInfo( cinfo_manager_color_.getCameraInfo() ) );
+  sensor_msgs::Image::Ptr image_ir_rect;
+  sensor_msgs::Image::Ptr image_bgr8_rect;
   
-  std::string frame_id;
-  std::string frame_id_ir;
-  std::string frame_id_depth;
-  std::string frame_id_color;
-  err = priv_nh_.getParam( "frame_id"      , frame_id       );
-  err = priv_nh_.getParam( "frame_id_ir"   , frame_id_ir    );
-  err = priv_nh_.getParam( "frame_id_depth", frame_id_depth );
-  err = priv_nh_.getParam( "frame_id_color", frame_id_color );
+  // Prebuilt Camera Infos, only the header stamp changes per frame
+  const Calibration& calibration = *(settings->calibration);
+  
+  sensor_msgs::CameraInfo::Ptr cinfo       = ws.cinfo_pool.acquire( calibration.cinfo );
+  sensor_msgs::CameraInfo::Ptr cinfo_ir    = ws.cinfo_ir_pool.acquire( calibration.cinfo_ir );
+  sensor_msgs::CameraInfo::Ptr cinfo_depth = ws.cinfo_depth_pool.acquire( calibration.cinfo_depth );
+  sensor_msgs::CameraInfo::Ptr cinfo_color = ws.cinfo_color_pool.acquire( calibration.cinfo_color );
+  
+  const std::string& frame_id       = settings->frame_id;
+  const std::string& frame_id_ir    = settings->frame_id_ir;
+  const std::string& frame_id_depth = settings->frame_id_depth;
+  const std::string& frame_id_color = settings->frame_id_color;
   
-  if ( frame->frame_format == UVC_FRAME_FORMAT_GRAY16 )
+  uint16_t* data = reinterpret_cast<uint16_t*>( &(image->data[0]) );
+  
+  // Frame stages specialized on the frame geometry when it is the default one, generic otherwise
+  const FrameGeometry geometry( frame_width, frame_height, color_width );
+  const FrameKernels& kernels = frameKernels( geometry );
+  
+  // Converting YUV422 to BGR8, read straight from the color crop of the frame
+  const ColorGains gains( settings->r_gain, settings->g_gain, settings->b_gain );
+  
+  image_bgr8->encoding = "bgr8";
+  image_bgr8->width  = calibration.color_width;
+  image_bgr8->height = calibration.color_height;
+  image_bgr8->step   = image_bgr8->width * 3;
+  image_bgr8->data.resize( image_bgr8->step * image_bgr8->height );
+  
+  uint8_t* bgr8_ptr = &(image_bgr8->data[0]);
+  
+  switch ( calibration.color_binning )
   {
-    if ( frame->data_bytes != ( frame_width * frame_height * sizeof(uint16_t) ) )
-    {
-      ROS_WARN( "Image Frame: Unexpected Data Size (%ld Bytes) - Skip this frame."
-                , frame->data_bytes );
-      return;
-    }
+    case 1:
+      kernels.convert_color( data, geometry, gains, bgr8_ptr, image_bgr8->step );
+      break;
+    case 2:
+    case 4:
+      kernels.bin_color( data, geometry, calibration.color_binning, gains, bgr8_ptr, image_bgr8->step );
+      break;
+    default:
+      resizeUYVYToBGR8( data, frame_width, calibration.color_area_x, calibration.color_area_y,
+                        gains, bgr8_ptr, image_bgr8->step );
+      break;
+  }
+  
+
+  // Cropping Depth and IR Image Frame
+  int depth_width  = frame_width - color_width;
+  int depth_height = frame_height / 2;
+  
+  image_depth->encoding = "16UC1";
+  image_depth->width  = depth_width;
+  image_depth->height = depth_height;
+  image_depth->step   = image_depth->width * 2;
+  image_depth->data.resize( image_depth->step * image_depth->height );
+  
+  image_ir->encoding = "16UC1";
+  image_ir->width  = depth_width;
+  image_ir->height = depth_height;
+  image_ir->step   = image_ir->width * 2;
+  image_ir->data.resize( image_ir->step * image_ir->height );
+  
+  // Depth Data Modification for Cartesian Coordinate System
+  const double depth_cnv_gain = settings->depth_cnv_gain;
+  const double depth_offset   = settings->depth_offset;
+  
+  if ( static_cast<int>( calibration.ray_inv_norm.size() ) != depth_width * depth_height )
+  {
+    ROS_WARN( "Image Frame: Calibration does not match the depth size %dx%d - Skip this frame.",
+              depth_width, depth_height );
+    return;
+  }
+  
+  const float* inv_norm = &(calibration.ray_inv_norm[0]);
+  uint16_t*    depth    = reinterpret_cast<uint16_t*>( &(image_depth->data[0]) );
+  uint16_t*    ir       = reinterpret_cast<uint16_t*>( &(image_ir->data[0]) );
+  
+  // Deinterlacing: depth rows are corrected straight from the frame, IR rows are copied
+  kernels.deinterlace( data, geometry, inv_norm, depth_cnv_gain * 4.0, depth_offset, depth, ir );
+  
+  // Rectified IR Image, sampled straight from the interlaced IR rows of the frame
+  if ( settings->rectify_ir && not calibration.rect_ir.empty() && 0 < pub_ir_rect_.getNumSubscribers() )
+  {
+    const RemapTable& table = calibration.rect_ir;
     
-    image->encoding = "16UC1";
-    image->step     = image->width * 2;
-    image->data.resize( image->step * image->height );
-    memcpy( &(image->data[0]), frame->data, frame->data_bytes );
+    image_ir_rect = ws.ir_rect_pool.acquire();
+    image_ir_rect->encoding = sensor_msgs::image_encodings::MONO16;
+    image_ir_rect->width    = table.width;
+    image_ir_rect->height   = table.height;
+    image_ir_rect->step     = table.width * 2;
+    image_ir_rect->is_bigendian = 0;
+    image_ir_rect->data.resize( image_ir_rect->step * image_ir_rect->height );
     
-    uint16_t* data = reinterpret_cast<uint16_t*>( &(image->data[0]) );
+    remapMono16( &(data[ frame_width + color_width ]), 2 * frame_width, table,
+                 reinterpret_cast<uint16_t*>( &(image_ir_rect->data[0]) ) );
     
-    // Cropping Color Image Frame
-    int color_height = frame_height;
+    image_ir_rect->header.frame_id = frame_id_ir;
+    image_ir_rect->header.stamp    = timestamp;
+  }
+  
+  // Rectified Color Image, converted from YUV422 in the same pass
+  if ( settings->rectify_color && not calibration.rect_color.empty() && 0 < pub_color_rect_.getNumSubscribers() )
+  {
+    const RemapTable& table = calibration.rect_color;
+    
+    image_bgr8_rect = ws.color_rect_pool.acquire();
+    image_bgr8_rect->encoding = sensor_msgs::image_encodings::BGR8;
+    image_bgr8_rect->width    = table.width;
+    image_bgr8_rect->height   = table.height;
+    image_bgr8_rect->step     = table.width * 3;
+    image_bgr8_rect->is_bigendian = 0;
+    image_bgr8_rect->data.resize( image_bgr8_rect->step * image_bgr8_rect->height );
     
-    uint16_t color_data[ color_width * color_height ];
+    remapUYVYToBGR8( data, frame_width, table, gains,
+                     &(image_bgr8_rect->data[0]), image_bgr8_rect->step );
+    
+    image_bgr8_rect->header.frame_id = frame_id_color;
+    image_bgr8_rect->header.stamp    = timestamp;
+  }
+  
+  image->header.frame_id = frame_id;
+  image->header.stamp    = timestamp;
+  
+  image_ir->header.frame_id = frame_id_ir;
+  image_ir->header.stamp    = timestamp;
+  
+  image_depth->header.frame_id = frame_id_depth;
+  image_depth->header.stamp    = timestamp;
+  
+  image_bgr8->header.frame_id = frame_id_color;
+  image_bgr8->header.stamp    = timestamp;
+  
+  cinfo->header.stamp       = timestamp;
+  cinfo_ir->header.stamp    = timestamp;
+  cinfo_depth->header.stamp = timestamp;
+  cinfo_color->header.stamp = timestamp;
+  
+  // Frame Processor Stages, in place on the planes of the images (the depth filter is one of them)
+  if ( not processors_.empty() )
+  {
+    FrameView view;
+    view.stamp       = timestamp;
+    view.raw         = ImagePlane<const uint16_t>( data, frame_width, frame_height, frame_width );
+    view.depth       = ImagePlane<uint16_t>( reinterpret_cast<uint16_t*>( &(image_depth->data[0]) ),
+                                             depth_width, depth_height, depth_width );
+    view.ir          = ImagePlane<uint16_t>( reinterpret_cast<uint16_t*>( &(image_ir->data[0]) ),
+                                             depth_width, depth_height, depth_width );
+    view.color       = ImagePlane<uint8_t>( &(image_bgr8->data[0]), image_bgr8->width, image_bgr8->height,
+                                            image_bgr8->step );
+    view.settings    = settings.get();
+    view.calibration = &calibration;
     
-    int m = 0;
-    int n = 0;
-    for ( int i=0; i < color_height; i++ )
+    if ( not runProcessors( view, ticket ) )
+      return;
+  }
+  
+  // Change-Triggered Publishing: drop the whole frame while the depth stays the same.
+  // The reference is the last published depth, so the frames pass in capture order.
+  sensor_msgs::Image::Ptr change_mask;
+  bool changed = true;
+  
+  ticket.ordered( frameSection( FrameSectionChange ), [&]()
+  {
+    if ( settings->change_trigger )
     {
-      m = i * frame_width;
-      n = i * color_width;
-      memcpy( &(color_data[n]), &(data[m]), color_width * sizeof(uint16_t) );
+      changed = checkDepthChange( *image_depth, *settings, change_mask );
     }
+    else if ( not change_reference_.empty() )
+    {
+      change_reference_.clear();
+    }
+  } );
+  
+  if ( not changed )
+    return;
+  
+  // Laser Scan, the minimum range per column over a band of the (filtered) depth image
+  sensor_msgs::LaserScan::Ptr scan;
+  
+  if ( settings->scan_enable && not calibration.scan.empty() && 0 < pub_scan_.getNumSubscribers() &&
+       static_cast<int>( image_depth->width ) == calibration.scan.width &&
+       static_cast<int>( image_depth->height ) >= calibration.scan.row_begin + calibration.scan.rows )
+  {
+    const ScanTable& table = calibration.scan;
+    
+    scan = ws.scan_pool.acquire();
+    scan->header.frame_id = settings->frame_id_scan;
+    scan->header.stamp    = timestamp;
+    scan->angle_min       = table.angle_min;
+    scan->angle_max       = table.angle_min + table.angle_increment * ( table.beams - 1 );
+    scan->angle_increment = table.angle_increment;
+    scan->time_increment  = 0.0;
+    scan->scan_time       = settings->frame_period;
+    scan->range_min       = settings->scan_range_min;
+    scan->range_max       = settings->scan_range_max;
+    scan->ranges.resize( table.beams );
+    scan->intensities.clear();
     
-    // Converting YUV422 to BGR8
-    image_bgr8->encoding = "bgr8";
-    image_bgr8->width  = color_width;
-    image_bgr8->height = color_height;
-    image_bgr8->step   = image_bgr8->width * 3;
-    image_bgr8->data.resize( image_bgr8->step * image_bgr8->height );
+    projectDepthToScan( reinterpret_cast<const uint16_t*>( &(image_depth->data[0]) ), table,
+                        scan->range_min, scan->range_max, &(scan->ranges[0]) );
+  }
+  
+  // Surface Normals of the (filtered) depth image, computed in row strips on the worker pool
+  sensor_msgs::Image::Ptr image_normals;
+  
+  if ( settings->normals_enable && 0 < pub_normals_.getNumSubscribers() &&
+       static_cast<int>( image_depth->width * image_depth->height ) == static_cast<int>( calibration.ray_x.size() ) )
+  {
+    const int width  = image_depth->width;
+    const int height = image_depth->height;
     
-    uint8_t *uyvy_ptr;
-    uint8_t *bgr8_ptr;
+    image_normals = ws.normals_pool.acquire();
+    image_normals->encoding = sensor_msgs::image_encodings::TYPE_32FC3;
+    image_normals->width    = width;
+    image_normals->height   = height;
+    image_normals->step     = width * 3 * sizeof(float);
+    image_normals->is_bigendian = 0;
+    image_normals->data.resize( image_normals->step * height );
+    image_normals->header   = image_depth->header;
     
-    uyvy_ptr = reinterpret_cast<uint8_t*>( &(color_data[0]) );
-    bgr8_ptr = reinterpret_cast<uint8_t*>( &(image_bgr8->data[0]) );
+    const uint16_t* depth  = reinterpret_cast<const uint16_t*>( &(image_depth->data[0]) );
+    float*          normal = reinterpret_cast<float*>( &(image_normals->data[0]) );
+    const int       radius = settings->normals_radius;
+    const float     change = settings->normals_max_depth_change;
     
-    double u0, y0, v0, y1;
-    double r0, g0, b0;
+    ThreadPool& pool = ws.workerPool();
+    const size_t strips = pool.size();
     
-    int half_pixels = color_width * color_height / 2;
-    for ( int i = 0; i < half_pixels; i++ )
+    pool.run( strips, [&]( size_t strip )
     {
-      u0 = static_cast<double>( *(uyvy_ptr)   );
-      y0 = static_cast<double>( *(uyvy_ptr+1) );
-      v0 = static_cast<double>( *(uyvy_ptr+2) );
-      y1 = static_cast<double>( *(uyvy_ptr+3) );
-      
-      r0 = 1.574800 * ( v0 - 128 );
-      g0 = 0.187324 * ( u0 - 128 ) - 0.468124 * ( v0 - 128 );
-      b0 = 1.855600 * ( u0 - 128 );
-      
-      *(bgr8_ptr)   = cvtDoubleToByte( ( y0 + b0 ) * b_gain_ );
-      *(bgr8_ptr+1) = cvtDoubleToByte( ( y0 + g0 ) * g_gain_ );
-      *(bgr8_ptr+2) = cvtDoubleToByte( ( y0 + r0 ) * r_gain_ );
-      
-      *(bgr8_ptr+3) = cvtDoubleToByte( ( y1 + b0 ) * b_gain_ );
-      *(bgr8_ptr+4) = cvtDoubleToByte( ( y1 + g0 ) * g_gain_ );
-      *(bgr8_ptr+5) = cvtDoubleToByte( ( y1 + r0 ) * r_gain_ );
-      
-      uyvy_ptr += 4;
-      bgr8_ptr += 6;
-    }
+      size_t begin, end;
+      ThreadPool::splitRange( height, strips, strip, begin, end );
+      computeDepthNormals( depth, &(calibration.ray_x[0]), &(calibration.ray_y[0]), width, height,
+                           begin, end, radius, change, normal );
+    } );
+  }
+  
+  // Depth Upsampling, the depth registered to the color grid and filled by a joint bilateral
+  // filter guided by the luma of the color crop, in row strips on the worker pool
+  sensor_msgs::Image::Ptr image_upsampled;
+  
+  if ( settings->upsample_enable && not calibration.upsample_kernel.empty() && 0 < pub_upsampled_.getNumSubscribers() &&
+       static_cast<int>( image_depth->width * image_depth->height ) == static_cast<int>( calibration.ray_x.size() ) &&
+       image->data.size() == frame_width * frame_height * sizeof(uint16_t) )
+  {
+    const int width  = calibration.color_width;
+    const int height = calibration.color_height;
     
-    // Camera Info. Dynamic Reconfigure
-    bool rgb_dist_reconfig;
-    priv_nh_.getParam( "rgb_dist_reconfig", rgb_dist_reconfig );
-    if( rgb_dist_reconfig )
-    {
-      double rgb_fx, rgb_fy, rgb_cx, rgb_cy;
-      double rgb_k1, rgb_k2, rgb_k3, rgb_p1, rgb_p2;
-      
-      priv_nh_.getParam( "rgb_fx", rgb_fx );
-      priv_nh_.getParam( "rgb_fy", rgb_fy );
-      priv_nh_.getParam( "rgb_cx", rgb_cx );
-      priv_nh_.getParam( "rgb_cy", rgb_cy );
-      priv_nh_.getParam( "rgb_k1", rgb_k1 );
-      priv_nh_.getParam( "rgb_k2", rgb_k2 );
-      priv_nh_.getParam( "rgb_k3", rgb_k3 );
-      priv_nh_.getParam( "rgb_p1", rgb_p1 );
-      priv_nh_.getParam( "rgb_p2", rgb_p2 );
-      
-      cinfo_color->K[0] = rgb_fx;
-      cinfo_color->K[4] = rgb_fy;
-      cinfo_color->K[2] = rgb_cx;
-      cinfo_color->K[5] = rgb_cy;
-      cinfo_color->D[0] = rgb_k1;
-      cinfo_color->D[1] = rgb_k2;
-      cinfo_color->D[2] = rgb_p1;
-      cinfo_color->D[3] = rgb_p2;
-      cinfo_color->D[4] = rgb_k3;
-    }
-
-    // Cropping Depth and IR Image Frame
-    int depth_width  = frame_width - color_width;
-    int depth_height = frame_height / 2;
+    ws.upsample_guide.resize( width * height );
+    ws.upsample_sparse.resize( width * height );
     
-    image_depth->encoding = "16UC1";
-    image_depth->width  = depth_width;
-    image_depth->height = depth_height;
-    image_depth->step   = image_depth->width * 2;
-    image_depth->data.resize( image_depth->step * image_depth->height );
+    const float translation[3] = { static_cast<float>( calibration.upsample_translation[0] ),
+                                   static_cast<float>( calibration.upsample_translation[1] ),
+                                   static_cast<float>( calibration.upsample_translation[2] ) };
     
-    uint16_t depth_data[ depth_width * depth_height ];
+    extractUYVYLuma( reinterpret_cast<const uint16_t*>( &(image->data[0]) ), frame_width, color_width, frame_height,
+                     width, height, &(ws.upsample_guide[0]) );
+    registerDepth( reinterpret_cast<const uint16_t*>( &(image_depth->data[0]) ),
+                   &(calibration.ray_x[0]), &(calibration.ray_y[0]), image_depth->width, image_depth->height,
+                   translation, calibration.upsample_color, width, height, &(ws.upsample_sparse[0]) );
     
-    image_ir->encoding = "16UC1";
-    image_ir->width  = depth_width;
-    image_ir->height = depth_height;
-    image_ir->step   = image_ir->width * 2;
-    image_ir->data.resize( image_ir->step * image_ir->height );
+    image_upsampled = ws.upsampled_pool.acquire();
+    image_upsampled->encoding = sensor_msgs::image_encodings::TYPE_16UC1;
+    image_upsampled->width    = width;
+    image_upsampled->height   = height;
+    image_upsampled->step     = width * sizeof(uint16_t);
+    image_upsampled->is_bigendian = 0;
+    image_upsampled->data.resize( image_upsampled->step * height );
+    image_upsampled->header.frame_id = frame_id_color;
+    image_upsampled->header.stamp    = timestamp;
     
-    uint16_t ir_data[ depth_width * depth_height ];
+    uint16_t* dense = reinterpret_cast<uint16_t*>( &(image_upsampled->data[0]) );
     
-    int offset_x = color_width;
-    int offset_y = 0;
-    m = 0;
-    n = 0;
-    for ( int i=0; i < depth_height; i++ )
+    ThreadPool& pool = ws.workerPool();
+    const size_t strips = pool.size();
+    
+    pool.run( strips, [&]( size_t strip )
     {
-      m = ( 2 * i + offset_y ) * frame_width + offset_x; // Interlace
-      n = i * depth_width;
-      memcpy( &(depth_data[n]), &(data[m]), depth_width * sizeof(uint16_t) );
-      
-      m += frame_width;
-      memcpy( &(ir_data[n]), &(data[m]), depth_width * sizeof(uint16_t) );
-    }
+      size_t begin, end;
+      ThreadPool::splitRange( height, strips, strip, begin, end );
+      jointBilateralUpsample( &(ws.upsample_sparse[0]), &(ws.upsample_guide[0]), width, height,
+                              calibration.upsample_kernel, begin, end, dense );
+    } );
+  }
+  
+  // Height Map, the highest point and the hit count per cell of a grid in the height map frame
+  cis_camera::HeightMap::Ptr heightmap;
+  
+  if ( settings->heightmap_enable && not calibration.heightmap.empty() && 0 < pub_heightmap_.getNumSubscribers() &&
+       static_cast<int>( image_depth->width ) == calibration.heightmap.width &&
+       static_cast<int>( image_depth->height ) == calibration.heightmap.height )
+  {
+    const HeightMapGrid& grid = settings->heightmap_grid;
+    
+    heightmap = ws.heightmap_pool.acquire();
+    heightmap->header.frame_id = settings->frame_id_heightmap;
+    heightmap->header.stamp    = timestamp;
+    heightmap->resolution = grid.resolution;
+    heightmap->origin_x   = grid.origin_x;
+    heightmap->origin_y   = grid.origin_y;
+    heightmap->cells_x    = grid.cells_x;
+    heightmap->cells_y    = grid.cells_y;
+    heightmap->max_height.resize( grid.cells() );
+    heightmap->hits.resize( grid.cells() );
+    
+    ws.heightmap_builder.build( reinterpret_cast<const uint16_t*>( &(image_depth->data[0]) ),
+                                calibration.heightmap, grid, &ws.workerPool(),
+                                &(heightmap->max_height[0]), &(heightmap->hits[0]) );
+  }
+  
+  // Compact Point Cloud, packed points of the (filtered) depth image in the depth optical frame
+  sensor_msgs::PointCloud2::Ptr cloud;
+  
+  if ( settings->cloud_enable && 0 < pub_cloud_.getNumSubscribers() &&
+       static_cast<int>( image_depth->width * image_depth->height ) == static_cast<int>( calibration.ray_x.size() ) )
+  {
+    const CloudEncoding encoding = static_cast<CloudEncoding>( settings->cloud_encoding );
+    const int           width    = image_depth->width;
+    const int           height   = image_depth->height;
+    
+    cloud = ws.cloud_pool.acquire();
+    cloud->header = image_depth->header;
+    setCloudFields( encoding, *cloud );
+    cloud->data.resize( width * height * cloud->point_step );
     
-    // Depth Data Modification for Cartesian Coordinate System
-    double fx, fy, cx, cy;
-    double k1, k2, k3, p1, p2;
+    size_t points = encodeDepthCloud( reinterpret_cast<const uint16_t*>( &(image_depth->data[0]) ),
+                                      &(calibration.ray_x[0]), &(calibration.ray_y[0]), width, height,
+                                      encoding, settings->cloud_drop_invalid, &(cloud->data[0]) );
     
-    bool ir_dist_reconfig;
-    priv_nh_.getParam( "ir_dist_reconfig", ir_dist_reconfig );
-    if( ir_dist_reconfig )
+    if ( settings->cloud_drop_invalid )
     {
-      priv_nh_.getParam( "ir_fx", fx );
-      priv_nh_.getParam( "ir_fy", fy );
-      priv_nh_.getParam( "ir_cx", cx );
-      priv_nh_.getParam( "ir_cy", cy );
-      priv_nh_.getParam( "ir_k1", k1 );
-      priv_nh_.getParam( "ir_k2", k2 );
-      priv_nh_.getParam( "ir_k3", k3 );
-      priv_nh_.getParam( "ir_p1", p1 );
-      priv_nh_.getParam( "ir_p2", p2 );
-      
-      cinfo_ir->K[0] = fx;
-      cinfo_ir->K[4] = fy;
-      cinfo_ir->K[2] = cx;
-      cinfo_ir->K[5] = cy;
-      cinfo_ir->D[0] = k1;
-      cinfo_ir->D[1] = k2;
-      cinfo_ir->D[2] = p1;
-      cinfo_ir->D[3] = p2;
-      cinfo_ir->D[4] = k3;
-      
-      cinfo_depth->K[0] = fx;
-      cinfo_depth->K[4] = fy;
-      cinfo_depth->K[2] = cx;
-      cinfo_depth->K[5] = cy;
-      cinfo_depth->D[0] = k1;
-      cinfo_depth->D[1] = k2;
-      cinfo_depth->D[2] = p1;
-      cinfo_depth->D[3] = p2;
-      cinfo_depth->D[4] = k3;
+      cloud->width    = points;
+      cloud->height   = 1;
+      cloud->is_dense = true;
     }
     else
     {
-      fx = cinfo_depth->K[0];
-      fy = cinfo_depth->K[4];
-      cx = cinfo_depth->K[2];
-      cy = cinfo_depth->K[5];
-      k1 = cinfo_depth->D[0];
-      k2 = cinfo_depth->D[1];
-      k3 = cinfo_depth->D[4];
-      p1 = cinfo_depth->D[2];
-      p2 = cinfo_depth->D[3];
+      cloud->width    = width;
+      cloud->height   = height;
+      cloud->is_dense = false;
     }
+    cloud->row_step = cloud->width * cloud->point_step;
+    cloud->data.resize( cloud->row_step * cloud->height );
+  }
+  
+  // Publishing in capture order
+  ticket.ordered( frameSection( FrameSectionPublish ), [&]()
+  {
+    pub_camera_.publish( image, cinfo );
+    pub_ir_.publish( image_ir, cinfo_ir );
+    pub_depth_.publish( image_depth, cinfo_depth );
+    pub_color_.publish( image_bgr8, cinfo_color );
     
-    double xp, yp, x2, y2, r2, r4, r6, k0, s0;
-    double xp_mod, yp_mod;
+    if ( image_ir_rect )
+      pub_ir_rect_.publish( image_ir_rect );
+    if ( image_bgr8_rect )
+      pub_color_rect_.publish( image_bgr8_rect );
+    if ( change_mask )
+      pub_change_mask_.publish( change_mask );
+    if ( image_normals )
+      pub_normals_.publish( image_normals );
+    if ( image_upsampled )
+      pub_upsampled_.publish( image_upsampled, cinfo_color );
+    if ( scan )
+      pub_scan_.publish( scan );
+    if ( heightmap )
+      pub_heightmap_.publish( heightmap );
+    if ( cloud )
+      pub_cloud_.publish( cloud );
+  } );
+  
+}
+
+
+/**
+ * @brief checkDepthChange decides whether a frame is published in the change-triggered mode.
+ * The depth is compared to the last published depth in 16x16 tiles. The frame is published
+ * when at least change_min_tiles tiles changed by more than change_threshold [mm] on average,
+ * or when change_keepalive seconds passed since the last published frame. A published frame
+ * becomes the new reference and gets the mask of its changed tiles.
+ * @param depth const sensor_msgs::Image& corrected (and filtered) depth image
+ * @param settings const DriverSettings& settings snapshot of the current frame
+ * @param mask sensor_msgs::Image::Ptr& changed tiles of a published frame
+ * @return bool true when the frame is published
+ */
+bool CameraDriver::checkDepthChange( const sensor_msgs::Image& depth, const DriverSettings& settings,
+                                     sensor_msgs::Image::Ptr& mask )
+{
+  const int width   = depth.width;
+  const int height  = depth.height;
+  const int tiles_x = ( width  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int tiles_y = ( height + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const uint16_t* data = reinterpret_cast<const uint16_t*>( &(depth.data[0]) );
+  
+  mask = change_mask_pool_.acquire();
+  mask->encoding = sensor_msgs::image_encodings::MONO8;
+  mask->width    = tiles_x;
+  mask->height   = tiles_y;
+  mask->step     = tiles_x;
+  mask->is_bigendian = 0;
+  mask->data.resize( tiles_x * tiles_y );
+  mask->header   = depth.header;
+  
+  // First frame, or the size changed: everything is new
+  if ( change_reference_.size() != static_cast<size_t>( width * height ) )
+  {
+    std::fill( mask->data.begin(), mask->data.end(), 255 );
+  }
+  else
+  {
+    int changed = detectChangedTiles( data, &(change_reference_[0]), width, height,
+                                      settings.change_threshold, change_sad_, &(mask->data[0]) );
     
-    if ( fx <= 0 ) fx = depth_width / 2;
-    if ( fy <= 0 ) fy = depth_height / 2;
+    const ros::Time& stamp = depth.header.stamp;
+    bool keepalive = 0.0 < settings.change_keepalive &&
+                     ( stamp < change_published_ || settings.change_keepalive <= ( stamp - change_published_ ).toSec() );
     
-    for ( int i=0; i< depth_height; i++ )
+    if ( changed < settings.change_min_tiles && not keepalive )
     {
-      yp = ( i - cy ) / fy;
-      y2 = yp * yp;
-      
-      for ( int j=0; j < depth_width; j++ )
-      {
-        xp = ( j - cx ) / fx;
-        x2 = xp * xp;
-        
-        // Lens Distortion Correction
-        r2  = x2 + y2;
-        r4  = r2 * r2;
-        r6  = r2 * r4;
-        k0  = 1.0 + k1 * r2 + k2 * r4 + k3 * r6;
-        xp_mod = xp * k0 + 2.0 * p1 * xp * yp + p2 * ( r2 + 2.0 * x2 );
-        yp_mod = yp * k0 + 2.0 * p2 * xp * yp + p1 * ( r2 + 2.0 * y2 );
-        
-        s0 = sqrt( fabs( xp_mod * xp_mod + yp_mod * yp_mod + 1.0 ) );
-        
-        if ( s0 <= 0 ) s0 = 1.0;
-        
-        depth_data[ i*depth_width + j ] = (uint16_t)( floor( ( depth_data[ i*depth_width + j ] * depth_cnv_gain_ * 4.0 + depth_offset_ ) / s0 + 0.5 ) );
-        
-      }
+      mask.reset();
+      return false;
     }
-    
-    memcpy( &(image_depth->data[0]), depth_data, depth_width * depth_height * sizeof(uint16_t) );
-    memcpy( &(image_ir->data[0]), ir_data, depth_width * depth_height * sizeof(uint16_t) );
-    
-  }
-  else
-  {
-    return;
   }
   
-  image->header.frame_id = frame_id;
-  image->header.stamp    = timestamp;
-  
-  image_ir->header.frame_id = frame_id_ir;
-  image_ir->header.stamp    = timestamp;
-  
-  image_depth->header.frame_id = frame_id_depth;
-  image_depth->header.stamp    = timestamp;
+  change_reference_.assign( data, data + width * height );
+  change_published_ = depth.header.stamp;
   
-  image_bgr8->header.frame_id = frame_id_color;
-  image_bgr8->header.stamp    = timestamp;
-  
-  cinfo->header.frame_id = frame_id;
-  cinfo->header.stamp    = timestamp;
+  return true;
+}
+
+
+/**
+ * @brief workerPool returns the thread pool of a frame processing thread, started on
+ * first use with threads threads (0 = number of cores). Only the owning thread may call it.
+ * @return ThreadPool& pool for data parallel frame processing
+ */
+ThreadPool& CameraDriver::FrameWorkspace::workerPool()
+{
+  if ( not pool )
+    pool.reset( new ThreadPool( std::max( 0, threads ) ) );
   
-  cinfo_ir->header.frame_id = frame_id_ir;
-  cinfo_ir->header.stamp    = timestamp;
+  return *pool;
+}
+
+
+/**
+ * @brief startFrameWorkers starts the frame workers, if enabled, with one workspace per worker.
+ * The intra-frame pools of the workers share the cores unless worker_threads is set.
+ */
+void CameraDriver::startFrameWorkers()
+{
+  if ( not frame_workers_ )
+    return;
   
-  cinfo_depth->header.frame_id = frame_id_depth;
-  cinfo_depth->header.stamp    = timestamp;
+  const int workers = frame_workers_->workers();
+  const int cores   = std::max( 1u, std::thread::hardware_concurrency() );
   
-  cinfo_color->header.frame_id = frame_id_color;
-  cinfo_color->header.stamp    = timestamp;
+  if ( worker_workspaces_.empty() )
+  {
+    for ( int i = 0; i < workers; i++ )
+    {
+      boost::shared_ptr<FrameWorkspace> ws( new FrameWorkspace );
+      ws->threads = 0 < worker_threads_ ? worker_threads_ : std::max( 1, cores / workers );
+      worker_workspaces_.push_back( ws );
+    }
+  }
   
-  // Depth Image Filter
-  bool depth_filter;
-  err = priv_nh_.getParam( "depth_filter", depth_filter );
-  if ( depth_filter )
-    filterDepthImage( image_depth );
+  frame_workers_->start(
+      [this]( FrameJob& job, size_t worker, FrameTicket& ticket )
+      {
+        processFrame( job, *worker_workspaces_[ worker ], ticket );
+        
+        // Release the frame and the settings snapshot while the job waits in the pool
+        job.image.reset();
+        job.settings.reset();
+      },
+      []() { return boost::shared_ptr<FrameJob>( new FrameJob ); } );
+  
+  ROS_INFO( "Processing frames on %d workers, at most %lu frames in flight.",
+            workers, static_cast<unsigned long>( frame_workers_->maxInFlight() ) );
+}
+
+
+/**
+ * @brief stopFrameWorkers lets the frame workers finish their frames, call after the stream stopped.
+ */
+void CameraDriver::stopFrameWorkers()
+{
+  if ( not frame_workers_ || not frame_workers_->running() )
+    return;
   
-  pub_camera_.publish( image, cinfo );
-  pub_ir_.publish( image_ir, cinfo_ir );
-  pub_depth_.publish( image_depth, cinfo_depth );
-  pub_color_.publish( image_bgr8, cinfo_color );
+  frame_workers_->stop();
   
+  ROS_INFO( "Frame workers stopped: %lu frames processed, %lu dropped.",
+            static_cast<unsigned long>( frame_workers_->completed() ),
+            static_cast<unsigned long>( frame_workers_->dropped() ) );
 }
 
 
@@ -858,13 +1840,18 @@ void CameraDriver::OpenCamera()
     return;
   }
   
-  uvc_error_t stream_err = uvc_start_streaming( devh_, &ctrl,
+  startFrameWorkers();
+  
+  stream_ctrl_  = ctrl;
+  frame_period_ = 1.0 / frame_rate;
+  uvc_error_t stream_err = uvc_start_streaming( devh_, &stream_ctrl_,
                                                 &CameraDriver::ImageCallbackAdapter,
                                                 this, 0 );
   
   if ( stream_err != UVC_SUCCESS )
   {
     ROS_ERROR( "uvc_start_streaming" );
+    stopFrameWorkers();
     uvc_close( devh_ );
     uvc_unref_device( dev_ );
     return;
@@ -880,6 +1867,9 @@ void CameraDriver::OpenCamera()
   cinfo_manager_depth_.loadCameraInfo( camera_info_url_depth_ );
   cinfo_manager_color_.loadCameraInfo( camera_info_url_color_ );
   
+  // Check for calibrations set through the set_camera_info services
+  calib_timer_ = nh_.createTimer( ros::Duration( 1.0 ), &CameraDriver::CalibrationTimerCallback, this );
+  
   // TOF Camera Settigns
   int tof_err;
 //  tof_err = setToFEEPROMMode( TOF_EEPROM_FACTORY_DEFAULT );
@@ -890,6 +1880,12 @@ void CameraDriver::OpenCamera()
   getToFInfo_All();
   getRGBInfo_All();
   
+  // Set Timer for Reporting the Frame Processor Timing
+  if ( 0.0 < processor_report_ && not processors_.empty() )
+  {
+    report_timer_ = nh_.createTimer( ros::Duration( processor_report_ ), &CameraDriver::ProcessorReportCallback, this );
+  }
+  
   // Set Timer for Publishing Temperatures 
   double temp_time = 0.0;
   err = priv_nh_.getParam( "temp_time", temp_time );
@@ -902,11 +1898,140 @@ void CameraDriver::OpenCamera()
   
   tof_err = clearToFError();
   
-  err = priv_nh_.getParam( "r_gain", r_gain_ );
-  err = priv_nh_.getParam( "g_gain", g_gain_ );
-  err = priv_nh_.getParam( "b_gain", b_gain_ );
+  state_     = Running;
+  suspended_ = false;
   
-  state_ = Running;
+  // Suspend right away (after the grace period) when nobody listens yet
+  updateStreaming();
+}
+
+
+/**
+ * @brief countSubscribers counts the subscribers of every frame output.
+ * The temperatures are not counted, they do not need the stream.
+ * @return int number of subscribers
+ */
+int CameraDriver::countSubscribers() const
+{
+  return pub_camera_.getNumSubscribers() + pub_color_.getNumSubscribers() +
+         pub_depth_.getNumSubscribers()  + pub_ir_.getNumSubscribers() +
+         pub_ir_rect_.getNumSubscribers() + pub_color_rect_.getNumSubscribers() +
+         pub_normals_.getNumSubscribers() + pub_change_mask_.getNumSubscribers() +
+         pub_upsampled_.getNumSubscribers() +
+         pub_scan_.getNumSubscribers() + pub_heightmap_.getNumSubscribers() +
+         pub_cloud_.getNumSubscribers();
+}
+
+
+/**
+ * @brief ImageConnectCallback is called when an image subscriber connects or disconnects.
+ */
+void CameraDriver::ImageConnectCallback( const image_transport::SingleSubscriberPublisher& pub )
+{
+  updateStreaming();
+}
+
+
+/**
+ * @brief ConnectCallback is called when a camera info, scan or height map subscriber connects or disconnects.
+ */
+void CameraDriver::ConnectCallback( const ros::SingleSubscriberPublisher& pub )
+{
+  updateStreaming();
+}
+
+
+/**
+ * @brief updateStreaming resumes the stream on the first subscriber and arms the
+ * suspend timer when the last one has gone, if auto_suspend is enabled.
+ */
+void CameraDriver::updateStreaming()
+{
+  boost::recursive_mutex::scoped_lock lock( mutex_ );
+  
+  if ( not auto_suspend_ || state_ != Running )
+    return;
+  
+  if ( 0 < countSubscribers() )
+  {
+    suspend_timer_.stop();
+    if ( suspended_ )
+      resumeStreaming();
+  }
+  else if ( not suspended_ )
+  {
+    if ( not suspend_timer_.isValid() )
+      suspend_timer_ = nh_.createTimer( ros::Duration( std::max( 0.01, suspend_grace_ ) ),
+                                        &CameraDriver::SuspendTimerCallback, this, true, false );
+    
+    // Restart the grace period
+    suspend_timer_.stop();
+    suspend_timer_.setPeriod( ros::Duration( std::max( 0.01, suspend_grace_ ) ) );
+    suspend_timer_.start();
+  }
+}
+
+
+/**
+ * @brief SuspendTimerCallback suspends the stream when nobody subscribed during the grace period.
+ */
+void CameraDriver::SuspendTimerCallback( const ros::TimerEvent& event )
+{
+  boost::recursive_mutex::scoped_lock lock( mutex_ );
+  
+  if ( auto_suspend_ && state_ == Running && not suspended_ && countSubscribers() == 0 )
+    suspendStreaming();
+}
+
+
+/**
+ * @brief suspendStreaming stops the USB stream, and the laser with suspend_laser_off.
+ * The device stays open, so camera controls and temperatures keep working.
+ * The caller must hold mutex_.
+ */
+void CameraDriver::suspendStreaming()
+{
+  ros::WallTime start = ros::WallTime::now();
+  
+  // Waits for a running ImageCallback, which never blocks on mutex_
+  uvc_stop_streaming( devh_ );
+  
+  if ( suspend_laser_off_ )
+    setToFMode_ROSParameter( "ld_enable", 0 );
+  
+  suspended_ = true;
+  ROS_INFO( "No subscribers for %.1f s - Streaming suspended in %.1f ms.",
+            suspend_grace_, ( ros::WallTime::now() - start ).toSec() * 1000.0 );
+}
+
+
+/**
+ * @brief resumeStreaming restarts the USB stream with the negotiated stream control.
+ * The time until the first frame arrives is logged by ImageCallback.
+ * The caller must hold mutex_.
+ */
+void CameraDriver::resumeStreaming()
+{
+  ros::WallTime start = ros::WallTime::now();
+  
+  if ( suspend_laser_off_ )
+    setToFMode_ROSParameter( "ld_enable", config_.ld_enable );
+  
+  resume_start_ns_.store( start.toNSec() );
+  resume_pending_.store( true );
+  
+  uvc_error_t stream_err = uvc_start_streaming( devh_, &stream_ctrl_,
+                                                &CameraDriver::ImageCallbackAdapter,
+                                                this, 0 );
+  if ( stream_err != UVC_SUCCESS )
+  {
+    resume_pending_.store( false );
+    ROS_ERROR( "uvc_start_streaming: %s - Streaming stays suspended.", uvc_strerror( stream_err ) );
+    return;
+  }
+  
+  suspended_ = false;
+  ROS_INFO( "Subscribed - Streaming resumed in %.1f ms.", ( ros::WallTime::now() - start ).toSec() * 1000.0 );
 }
 
 
@@ -1862,10 +2987,14 @@ int CameraDriver::getRGBColorCorrection( uint16_t& color_correction )
  */
 void CameraDriver::TemperatureCallback( void* ptr )
 {
-  boost::recursive_mutex::scoped_lock( mutex_ );
-  
   CameraDriver *driver = static_cast<CameraDriver*>(ptr);
   
+  // Serialize the temperature request with the other camera controls
+  boost::recursive_mutex::scoped_lock lock( driver->mutex_ );
+  
+  if ( driver->state_ != Running )
+    return;
+  
   driver->publishToFTemperature();
   
   return;
@@ -1878,7 +3007,11 @@ void CameraDriver::TemperatureCallback( void* ptr )
 void CameraDriver::publishToFTemperature()
 {
   std::string frame_id;
-  priv_nh_.getParam( "frame_id" , frame_id );
+  DriverSettingsConstPtr settings = loadSettings();
+  if ( settings )
+    frame_id = settings->frame_id;
+  else
+    priv_nh_.getParam( "frame_id" , frame_id );
   
   sensor_msgs::Temperature t_msg;
   
@@ -1905,13 +3038,25 @@ void CameraDriver::publishToFTemperature()
  */
 void CameraDriver::CloseCamera()
 {
+  // Stop handing frames to the frame path before the stream goes away
+  boost::atomic_store( &settings_, DriverSettingsConstPtr() );
+  
   uvc_close( devh_ );
   devh_ = NULL;
   
   uvc_unref_device( dev_ );
   dev_ = NULL;
   
+  // The stream is stopped, let the workers finish the frames in flight
+  stopFrameWorkers();
+  
   temp_timer_.stop();
+  calib_timer_.stop();
+  suspend_timer_.stop();
+  report_timer_.stop();
+  
+  suspended_ = false;
+  resume_pending_.store( false );
   
   state_ = Stopped;
 }
@@ -0,0 +1,202 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/depth_component_clustering.h"
+
+#include <algorithm>
+
+
+namespace cis_camera
+{
+
+static bool largerCluster( const pcl::PointIndices& a, const pcl::PointIndices& b )
+{
+  return b.indices.size() < a.indices.size();
+}
+
+
+DepthComponentClustering::DepthComponentClustering() :
+    depth_jump_( 0.03f ),
+    min_size_( 500 ),
+    max_size_( 100000 )
+{
+}
+
+
+int DepthComponentClustering::find( int i ) const
+{
+  while ( parent_[i] != i )
+    i = parent_[i];
+  return i;
+}
+
+
+/**
+ * @brief unite joins the trees of a and b. The smaller root index becomes the root,
+ * so the labeling does not depend on the order of the unions.
+ */
+void DepthComponentClustering::unite( int a, int b )
+{
+  int ra = find( a );
+  int rb = find( b );
+
+  if ( ra == rb )
+    return;
+
+  if ( ra < rb )
+    parent_[rb] = ra;
+  else
+    parent_[ra] = rb;
+
+  // Path compression of the two walked pixels
+  parent_[a] = parent_[b] = std::min( ra, rb );
+}
+
+
+void DepthComponentClustering::labelStrip( const Cloud& cloud, const std::vector<uint8_t>& valid,
+                                           int row_begin, int row_end )
+{
+  const int width = cloud.width;
+
+  for ( int v = row_begin; v < row_end; v++ )
+  {
+    for ( int u = 0; u < width; u++ )
+    {
+      int i = v * width + u;
+      parent_[i] = valid[i] ? i : -1;
+
+      if ( not valid[i] )
+        continue;
+
+      if ( 0 < u && valid[ i - 1 ] && connected( cloud.points[i], cloud.points[ i - 1 ] ) )
+        unite( i, i - 1 );
+
+      if ( row_begin < v && valid[ i - width ] && connected( cloud.points[i], cloud.points[ i - width ] ) )
+        unite( i, i - width );
+    }
+  }
+}
+
+
+void DepthComponentClustering::segment( const Cloud& cloud, const std::vector<uint8_t>& valid,
+                                        std::vector<pcl::PointIndices>& clusters, ThreadPool* pool )
+{
+  clusters.clear();
+
+  const int width  = cloud.width;
+  const int height = cloud.height;
+  const int pixels = width * height;
+
+  if ( pixels <= 0 || static_cast<int>( valid.size() ) != pixels )
+    return;
+
+  parent_.resize( pixels );
+  root_.resize( pixels );
+
+  // Label strips of rows in parallel, a strip only links pixels inside itself
+  int strips = pool ? std::min<int>( pool->size(), std::max( 1, height / 16 ) ) : 1;
+
+  if ( strips == 1 )
+  {
+    labelStrip( cloud, valid, 0, height );
+  }
+  else
+  {
+    pool->run( strips, [&]( size_t strip )
+    {
+      size_t begin, end;
+      ThreadPool::splitRange( height, strips, strip, begin, end );
+      labelStrip( cloud, valid, begin, end );
+    } );
+
+    // Merge across the strip borders
+    for ( int strip = 1; strip < strips; strip++ )
+    {
+      size_t begin, end;
+      ThreadPool::splitRange( height, strips, strip, begin, end );
+
+      for ( int u = 0; u < width; u++ )
+      {
+        int i = begin * width + u;
+        if ( valid[i] && valid[ i - width ] && connected( cloud.points[i], cloud.points[ i - width ] ) )
+          unite( i, i - width );
+      }
+    }
+  }
+
+  // Resolve the roots, read only on the union-find forest
+  if ( strips == 1 )
+  {
+    for ( int i = 0; i < pixels; i++ )
+      root_[i] = parent_[i] < 0 ? -1 : find( i );
+  }
+  else
+  {
+    pool->run( strips, [&]( size_t strip )
+    {
+      size_t begin, end;
+      ThreadPool::splitRange( pixels, strips, strip, begin, end );
+      for ( size_t i = begin; i < end; i++ )
+        root_[i] = parent_[i] < 0 ? -1 : find( i );
+    } );
+  }
+
+  // Cluster Sizes
+  size_.assign( pixels, 0 );
+  for ( int i = 0; i < pixels; i++ )
+  {
+    if ( 0 <= root_[i] )
+      size_[ root_[i] ]++;
+  }
+
+  cluster_of_root_.assign( pixels, -1 );
+  for ( int i = 0; i < pixels; i++ )
+  {
+    if ( root_[i] == i && min_size_ <= size_[i] && size_[i] <= max_size_ )
+    {
+      cluster_of_root_[i] = clusters.size();
+      clusters.push_back( pcl::PointIndices() );
+      clusters.back().indices.reserve( size_[i] );
+    }
+  }
+
+  for ( int i = 0; i < pixels; i++ )
+  {
+    if ( 0 <= root_[i] && 0 <= cluster_of_root_[ root_[i] ] )
+      clusters[ cluster_of_root_[ root_[i] ] ].indices.push_back( i );
+  }
+
+  std::stable_sort( clusters.begin(), clusters.end(), largerCluster );
+}
+
+};
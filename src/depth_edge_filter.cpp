@@ -0,0 +1,94 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/depth_edge_filter.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief process effects the filters on the depth plane in place with OpenCV
+ * @param frame FrameView& views of the frame planes
+ * @return bool true, the frame is never dropped
+ */
+bool DepthEdgeFilter::process( FrameView& frame )
+{
+  const DriverSettings& settings = *(frame.settings);
+  
+  if ( not settings.depth_filter || frame.depth.empty() )
+    return true;
+  
+  // Wraps the depth plane, the edges are cleared in place
+  cv::Mat src_img( frame.depth.height, frame.depth.width, CV_16UC1,
+                   frame.depth.data, frame.depth.step * sizeof(uint16_t) );
+  
+  // Median Blur Filter
+  int median_blur_size = 3;
+  cv::Mat blr_img;
+  
+  if ( settings.blur_mode == 1 )
+    cv::medianBlur( src_img, blr_img, median_blur_size );
+  else
+    cv::GaussianBlur( src_img, blr_img, cv::Size(3, 3), 0, 0, cv::BORDER_DEFAULT);
+  
+  // Edge Extraction
+  int edge_threshold    = 128;
+  int dilate_iterations = settings.dilate_iterations;
+  cv::Mat edg_img;
+  
+  if ( settings.edge_mode == 1 )
+  {
+    cv::Laplacian( blr_img, edg_img, CV_32F, 3 );
+  }
+  else
+  {
+    cv::Mat sbx_img, sby_img;
+    cv::Sobel( blr_img, sbx_img, CV_32F, 1, 0 );
+    cv::Sobel( blr_img, sby_img, CV_32F, 0, 1 );
+    edg_img = ( cv::abs( sbx_img ) + cv::abs( sby_img ) ) / 2.0;
+  }
+  
+  cv::convertScaleAbs( edg_img, edg_img, 1, 0 );
+  cv::threshold( edg_img, edg_img, edge_threshold, 255, cv::THRESH_BINARY|cv::THRESH_OTSU );
+  cv::dilate( edg_img, edg_img, cv::Mat(), cv::Point(-1,-1), dilate_iterations );
+  
+  // Set Depth Data as 0 (invalid) on the Edges
+  src_img.setTo( 0, edg_img );
+  
+  return true;
+}
+
+};
@@ -0,0 +1,197 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/depth_outlier_filter.h"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+
+namespace cis_camera
+{
+
+DepthOutlierFilter::DepthOutlierFilter() :
+    radius_( 1 ),
+    stddev_mul_( 0.5 ),
+    min_neighbors_( 2 )
+{
+}
+
+
+/**
+ * @brief meanStrip computes the mean absolute depth difference of the pixels in
+ * rows [ row_begin, row_end ) and accumulates the statistics of those means.
+ */
+void DepthOutlierFilter::meanStrip( int width, int row_begin, int row_end,
+                                    double& sum, double& sum_sq, size_t& count )
+{
+  const int r      = radius_;
+  const int stride = width + 2 * r;
+
+  sum    = 0.0;
+  sum_sq = 0.0;
+  count  = 0;
+
+  for ( int v = row_begin; v < row_end; v++ )
+  {
+    const float* z_c = &depth_[ ( v + r ) * stride + r ];
+    const float* m_c = &valid_[ ( v + r ) * stride + r ];
+    float*       out = &mean_[ v * width ];
+    float*       num = &neighbors_[ v * width ];
+
+    std::fill( out, out + width, 0.0f );
+    std::fill( num, num + width, 0.0f );
+
+    for ( int dy = -r; dy <= r; dy++ )
+    {
+      for ( int dx = -r; dx <= r; dx++ )
+      {
+        if ( dy == 0 && dx == 0 )
+          continue;
+
+        const float* z_n = z_c + dy * stride + dx;
+        const float* m_n = m_c + dy * stride + dx;
+
+        // Branch free, vectorized by the compiler
+        for ( int u = 0; u < width; u++ )
+        {
+          out[u] += fabsf( z_n[u] - z_c[u] ) * m_n[u];
+          num[u] += m_n[u];
+        }
+      }
+    }
+
+    for ( int u = 0; u < width; u++ )
+    {
+      if ( m_c[u] == 0.0f || num[u] < min_neighbors_ )
+      {
+        out[u] = -1.0f;
+        continue;
+      }
+
+      out[u] /= num[u];
+      sum    += out[u];
+      sum_sq += static_cast<double>( out[u] ) * out[u];
+      count++;
+    }
+  }
+}
+
+
+size_t DepthOutlierFilter::filter( Cloud& cloud, ThreadPool* pool )
+{
+  const int width  = cloud.width;
+  const int height = cloud.height;
+  const int r      = radius_;
+  const int stride = width + 2 * r;
+
+  if ( width <= 0 || height <= 0 || cloud.points.size() != static_cast<size_t>( width * height ) )
+    return 0;
+
+  // Padded depth and validity images, the border is invalid
+  depth_.assign( stride * ( height + 2 * r ), 0.0f );
+  valid_.assign( stride * ( height + 2 * r ), 0.0f );
+  mean_.resize( width * height );
+  neighbors_.resize( width * height );
+
+  for ( int v = 0; v < height; v++ )
+  {
+    for ( int u = 0; u < width; u++ )
+    {
+      const Point& p = cloud.points[ v * width + u ];
+      if ( pcl_isfinite( p.x ) && pcl_isfinite( p.y ) && pcl_isfinite( p.z ) )
+      {
+        depth_[ ( v + r ) * stride + u + r ] = p.z;
+        valid_[ ( v + r ) * stride + u + r ] = 1.0f;
+      }
+    }
+  }
+
+  // Per pixel mean differences and their statistics, strip by strip
+  size_t strips = pool ? std::min<size_t>( pool->size(), std::max( 1, height / 16 ) ) : 1;
+
+  std::vector<double> sums( strips ), sums_sq( strips );
+  std::vector<size_t> counts( strips );
+
+  if ( strips == 1 )
+  {
+    meanStrip( width, 0, height, sums[0], sums_sq[0], counts[0] );
+  }
+  else
+  {
+    pool->run( strips, [&]( size_t strip )
+    {
+      size_t begin, end;
+      ThreadPool::splitRange( height, strips, strip, begin, end );
+      meanStrip( width, begin, end, sums[strip], sums_sq[strip], counts[strip] );
+    } );
+  }
+
+  double sum = 0.0, sum_sq = 0.0;
+  size_t count = 0;
+  for ( size_t i = 0; i < strips; i++ )
+  {
+    sum    += sums[i];
+    sum_sq += sums_sq[i];
+    count  += counts[i];
+  }
+
+  double mean     = count ? sum / count : 0.0;
+  double variance = count ? std::max( 0.0, sum_sq / count - mean * mean ) : 0.0;
+  float  limit    = static_cast<float>( mean + stddev_mul_ * sqrt( variance ) );
+
+  // Remove the outliers
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  size_t removed = 0;
+
+  for ( int v = 0; v < height; v++ )
+  {
+    for ( int u = 0; u < width; u++ )
+    {
+      int i = v * width + u;
+      if ( valid_[ ( v + r ) * stride + u + r ] == 0.0f )
+        continue;
+
+      if ( mean_[i] < 0.0f || limit < mean_[i] )
+      {
+        cloud.points[i].x = cloud.points[i].y = cloud.points[i].z = nan;
+        removed++;
+      }
+    }
+  }
+
+  return removed;
+}
+
+};
@@ -0,0 +1,134 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include "cis_camera/frame_kernels.h"
+#include "cis_camera/pixel_kernels.h"
+
+#include <string.h>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief convertColorGeneric converts the color crop of a frame of any geometry.
+ */
+static void convertColorGeneric( const uint16_t* frame, const FrameGeometry& geometry,
+                                 const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  convertUYVYToBGR8( frame, geometry.frame_width, geometry.color_width, geometry.frame_height, gains, dst, dst_step );
+}
+
+
+/**
+ * @brief binColorGeneric converts and bins the color crop of a frame of any geometry.
+ */
+static void binColorGeneric( const uint16_t* frame, const FrameGeometry& geometry, int factor,
+                             const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  binUYVYToBGR8( frame, geometry.frame_width, geometry.color_width, geometry.frame_height, factor,
+                 gains, dst, dst_step );
+}
+
+
+/**
+ * @brief deinterlaceGeneric splits the depth and IR rows of a frame of any geometry.
+ */
+static void deinterlaceGeneric( const uint16_t* frame, const FrameGeometry& geometry, const float* inv_norm,
+                                double scale, double offset, uint16_t* depth, uint16_t* ir )
+{
+  const PixelKernels& kernels = pixelKernels();
+  
+  const int depth_width  = geometry.depthWidth();
+  const int depth_height = geometry.depthHeight();
+  
+  for ( int i = 0; i < depth_height; i++ )
+  {
+    const uint16_t* row = frame + 2 * i * geometry.frame_width + geometry.color_width; // Interlace
+    
+    kernels.correct_depth( row, inv_norm + i * depth_width, depth_width, scale, offset, depth + i * depth_width );
+    memcpy( ir + i * depth_width, row + geometry.frame_width, depth_width * sizeof(uint16_t) );
+  }
+}
+
+
+/**
+ * @brief binColorFixed bins the color crop of a DefaultFrameLayout frame, by 2 with the
+ * specialized kernel of the active level, other factors like any geometry.
+ */
+static void binColorFixed( const uint16_t* frame, const FrameGeometry& geometry, int factor,
+                           const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  const PixelKernels& kernels = pixelKernels();
+  
+  if ( factor == 2 && kernels.bin2_fixed != NULL )
+    kernels.bin2_fixed( frame, gains, dst, dst_step );
+  else
+    binColorGeneric( frame, geometry, factor, gains, dst, dst_step );
+}
+
+
+const FrameKernels& genericFrameKernels()
+{
+  static const FrameKernels kernels =
+  {
+    "generic",
+    convertColorGeneric,
+    binColorGeneric,
+    deinterlaceGeneric
+  };
+  
+  return kernels;
+}
+
+
+const FrameKernels& frameKernels( const FrameGeometry& geometry )
+{
+  // Only the binning by 2 gains from the constant bounds, the other stages stay generic
+  static const FrameKernels fixed =
+  {
+    "1920x960 bin2",
+    convertColorGeneric,
+    binColorFixed,
+    deinterlaceGeneric
+  };
+  
+  if ( pixelKernels().bin2_fixed != NULL && DefaultFrameLayout::matches( geometry ) )
+    return fixed;
+  
+  return genericFrameKernels();
+}
+
+};
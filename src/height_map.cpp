@@ -0,0 +1,168 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/height_map.h"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief buildHeightMapTable builds the grid frame direction of every depth pixel.
+ */
+void buildHeightMapTable( const float* ray_x, const float* ray_y, int width, int height,
+                          const double* rotation, const double* translation, HeightMapTable& table )
+{
+  const size_t pixels = static_cast<size_t>( width ) * height;
+
+  table.width  = width;
+  table.height = height;
+  for ( int k = 0; k < 3; k++ )
+    table.origin[k] = static_cast<float>( translation[k] );
+
+  table.dir_x.resize( pixels );
+  table.dir_y.resize( pixels );
+  table.dir_z.resize( pixels );
+
+  // Depth is z along the optical axis in mm, the ray ( x / z, y / z, 1 ) scales it to meters
+  for ( size_t i = 0; i < pixels; i++ )
+  {
+    const double r[3] = { 0.001 * ray_x[i], 0.001 * ray_y[i], 0.001 };
+    table.dir_x[i] = static_cast<float>( rotation[0] * r[0] + rotation[1] * r[1] + rotation[2] * r[2] );
+    table.dir_y[i] = static_cast<float>( rotation[3] * r[0] + rotation[4] * r[1] + rotation[5] * r[2] );
+    table.dir_z[i] = static_cast<float>( rotation[6] * r[0] + rotation[7] * r[1] + rotation[8] * r[2] );
+  }
+}
+
+
+void HeightMapBuilder::accumulateStrip( const uint16_t* depth, const HeightMapTable& table, const HeightMapGrid& grid,
+                                        size_t row_begin, size_t row_end, float* max_height, uint32_t* hits ) const
+{
+  const float inv_resolution = 1.0f / grid.resolution;
+
+  const float* dir_x = &(table.dir_x[0]);
+  const float* dir_y = &(table.dir_y[0]);
+  const float* dir_z = &(table.dir_z[0]);
+
+  for ( size_t i = row_begin * table.width; i < row_end * table.width; i++ )
+  {
+    if ( depth[i] == 0 )
+      continue;
+
+    const float d = depth[i];
+    const float z = table.origin[2] + d * dir_z[i];
+    if ( z < grid.min_z || grid.max_z < z )
+      continue;
+
+    const float fx = ( table.origin[0] + d * dir_x[i] - grid.origin_x ) * inv_resolution;
+    const float fy = ( table.origin[1] + d * dir_y[i] - grid.origin_y ) * inv_resolution;
+    if ( fx < 0.0f || fy < 0.0f )
+      continue;
+
+    const int ix = static_cast<int>( fx );
+    const int iy = static_cast<int>( fy );
+    if ( grid.cells_x <= ix || grid.cells_y <= iy )
+      continue;
+
+    const size_t cell = static_cast<size_t>( iy ) * grid.cells_x + ix;
+    max_height[cell] = std::max( max_height[cell], z );
+    hits[cell]++;
+  }
+}
+
+
+/**
+ * @brief build fills max_height and hits of grid.cells() cells from a depth image.
+ */
+void HeightMapBuilder::build( const uint16_t* depth, const HeightMapTable& table, const HeightMapGrid& grid,
+                              ThreadPool* pool, float* max_height, uint16_t* hits )
+{
+  const size_t cells = grid.cells();
+  const size_t parts = pool ? std::min( pool->size(), static_cast<size_t>( std::max( 1, table.height ) ) ) : 1;
+
+  part_height_.resize( parts );
+  part_hits_.resize( parts );
+
+  std::function<void( size_t )> accumulate = [&]( size_t part )
+  {
+    std::vector<float>&    part_height = part_height_[part];
+    std::vector<uint32_t>& part_hits   = part_hits_[part];
+
+    part_height.assign( cells, -std::numeric_limits<float>::infinity() );
+    part_hits.assign( cells, 0 );
+
+    size_t begin, end;
+    ThreadPool::splitRange( table.height, parts, part, begin, end );
+    accumulateStrip( depth, table, grid, begin, end, &(part_height[0]), &(part_hits[0]) );
+  };
+
+  std::function<void( size_t )> merge = [&]( size_t part )
+  {
+    size_t begin, end;
+    ThreadPool::splitRange( cells, parts, part, begin, end );
+
+    for ( size_t c = begin; c < end; c++ )
+    {
+      float    height = part_height_[0][c];
+      uint32_t count  = part_hits_[0][c];
+      for ( size_t p = 1; p < parts; p++ )
+      {
+        height = std::max( height, part_height_[p][c] );
+        count += part_hits_[p][c];
+      }
+
+      max_height[c] = ( 0 < count ) ? height : std::numeric_limits<float>::quiet_NaN();
+      hits[c]       = static_cast<uint16_t>( std::min<uint32_t>( count, 65535 ) );
+    }
+  };
+
+  if ( cells == 0 || table.empty() )
+    return;
+
+  if ( pool && 1 < parts )
+  {
+    pool->run( parts, accumulate );
+    pool->run( parts, merge );
+  }
+  else
+  {
+    accumulate( 0 );
+    merge( 0 );
+  }
+}
+
+};
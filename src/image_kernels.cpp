@@ -0,0 +1,887 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/image_kernels.h"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cis_camera/pixel_kernels.h"
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief clampToByte converts a float value to a 0-255 limited integer.
+ * @param x float value to convert
+ * @return uint8_t of the limited integer
+ */
+static inline uint8_t clampToByte( float x )
+{
+  if ( x < 0.0f )        return 0;
+  else if ( 255.0f < x ) return 255;
+  
+  return static_cast<uint8_t>( x );
+}
+
+
+/**
+ * @brief yuvToBGR8 converts one YUV sample to BGR8 with the driver's color gains.
+ */
+static inline void yuvToBGR8( float y, float u, float v, const ColorGains& gains, uint8_t* bgr )
+{
+  float r0 = 1.574800f * ( v - 128.0f );
+  float g0 = 0.187324f * ( u - 128.0f ) - 0.468124f * ( v - 128.0f );
+  float b0 = 1.855600f * ( u - 128.0f );
+  
+  bgr[0] = clampToByte( ( y + b0 ) * gains.b );
+  bgr[1] = clampToByte( ( y + g0 ) * gains.g );
+  bgr[2] = clampToByte( ( y + r0 ) * gains.r );
+}
+
+
+void buildAreaWeights( int src_size, int dst_size, AreaWeights& weights )
+{
+  weights.begin.assign( 1, 0 );
+  weights.index.clear();
+  weights.weight.clear();
+
+  if ( src_size <= 0 || dst_size <= 0 )
+  {
+    weights.begin.clear();
+    return;
+  }
+
+  // Output sample i covers the source interval [ i * ratio, ( i + 1 ) * ratio )
+  double ratio = static_cast<double>( src_size ) / dst_size;
+
+  for ( int i = 0; i < dst_size; i++ )
+  {
+    double s0 = i * ratio;
+    double s1 = ( i + 1 ) * ratio;
+
+    int first = static_cast<int>( floor( s0 ) );
+    int last  = static_cast<int>( ceil( s1 ) ) - 1;
+    if ( src_size - 1 < last ) last = src_size - 1;
+
+    for ( int j = first; j <= last; j++ )
+    {
+      double overlap = std::min( s1, j + 1.0 ) - std::max( s0, static_cast<double>( j ) );
+      if ( overlap <= 1e-9 )
+        continue;
+
+      weights.index.push_back( j );
+      weights.weight.push_back( static_cast<float>( overlap / ratio ) );
+    }
+    weights.begin.push_back( static_cast<int>( weights.index.size() ) );
+  }
+}
+
+
+void convertUYVYToBGR8( const uint16_t* src, int src_stride, int width, int height,
+                        const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  pixelKernels().convert_uyvy( src, src_stride, width, height, gains, dst, dst_step );
+}
+
+
+void convertUYVYToBGR8Scalar( const uint16_t* src, int src_stride, int width, int height,
+                              const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  for ( int v = 0; v < height; v++ )
+  {
+    const uint8_t* uyvy = reinterpret_cast<const uint8_t*>( src + v * src_stride );
+    uint8_t*       bgr  = dst + v * dst_step;
+
+    for ( int u = 0; u < width / 2; u++ )
+    {
+      float u0 = uyvy[0];
+      float y0 = uyvy[1];
+      float v0 = uyvy[2];
+      float y1 = uyvy[3];
+
+      yuvToBGR8( y0, u0, v0, gains, bgr     );
+      yuvToBGR8( y1, u0, v0, gains, bgr + 3 );
+
+      uyvy += 4;
+      bgr  += 6;
+    }
+  }
+}
+
+
+void binUYVYToBGR8( const uint16_t* src, int src_stride, int width, int height, int factor,
+                    const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  pixelKernels().bin_uyvy( src, src_stride, width, height, factor, gains, dst, dst_step );
+}
+
+
+void binUYVYToBGR8Scalar( const uint16_t* src, int src_stride, int width, int height, int factor,
+                          const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  const int   dst_width  = width  / factor;
+  const int   dst_height = height / factor;
+  const float y_norm     = 1.0f / ( factor * factor );
+  const float c_norm     = 2.0f / ( factor * factor );  // U and V are sampled at every other pixel
+
+  for ( int v = 0; v < dst_height; v++ )
+  {
+    uint8_t* bgr = dst + v * dst_step;
+
+    for ( int u = 0; u < dst_width; u++, bgr += 3 )
+    {
+      uint32_t sum_y = 0, sum_u = 0, sum_v = 0;
+
+      for ( int dy = 0; dy < factor; dy++ )
+      {
+        const uint8_t* uyvy = reinterpret_cast<const uint8_t*>( src + ( v * factor + dy ) * src_stride + u * factor );
+
+        for ( int dx = 0; dx < factor; dx += 2, uyvy += 4 )
+        {
+          sum_u += uyvy[0];
+          sum_y += uyvy[1];
+          sum_v += uyvy[2];
+          sum_y += uyvy[3];
+        }
+      }
+
+      yuvToBGR8( sum_y * y_norm, sum_u * c_norm, sum_v * c_norm, gains, bgr );
+    }
+  }
+}
+
+
+void correctDepth( const uint16_t* src, const float* inv_norm, int count,
+                   double scale, double offset, uint16_t* dst )
+{
+  pixelKernels().correct_depth( src, inv_norm, count, scale, offset, dst );
+}
+
+
+void correctDepthScalar( const uint16_t* src, const float* inv_norm, int count,
+                         double scale, double offset, uint16_t* dst )
+{
+  for ( int i = 0; i < count; i++ )
+  {
+    double d = floor( ( src[i] * scale + offset ) * inv_norm[i] + 0.5 );
+    
+    if ( d < 0.0 )          dst[i] = 0;
+    else if ( 65535.0 < d ) dst[i] = 65535;
+    else                    dst[i] = static_cast<uint16_t>( d );
+  }
+}
+
+
+void resizeUYVYToBGR8( const uint16_t* src, int src_stride,
+                       const AreaWeights& weights_x, const AreaWeights& weights_y,
+                       const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  const int dst_width  = static_cast<int>( weights_x.begin.size() ) - 1;
+  const int dst_height = static_cast<int>( weights_y.begin.size() ) - 1;
+
+  if ( dst_width <= 0 || dst_height <= 0 )
+    return;
+
+  // Horizontally resampled Y, U and V accumulated over the rows of one output row
+  std::vector<float> acc( 3 * dst_width );
+
+  for ( int v = 0; v < dst_height; v++ )
+  {
+    std::fill( acc.begin(), acc.end(), 0.0f );
+
+    for ( int k = weights_y.begin[v]; k < weights_y.begin[ v + 1 ]; k++ )
+    {
+      const uint16_t* row = src + weights_y.index[k] * src_stride;
+      const float     wy  = weights_y.weight[k];
+
+      for ( int u = 0; u < dst_width; u++ )
+      {
+        float sum_y = 0.0f, sum_u = 0.0f, sum_v = 0.0f;
+
+        for ( int l = weights_x.begin[u]; l < weights_x.begin[ u + 1 ]; l++ )
+        {
+          int   x  = weights_x.index[l];
+          float wx = weights_x.weight[l];
+
+          sum_y += wx * ( row[x] >> 8 );
+          sum_u += wx * ( row[ x & ~1 ] & 0xFF );
+          sum_v += wx * ( row[ x |  1 ] & 0xFF );
+        }
+
+        acc[ 3*u ]     += wy * sum_y;
+        acc[ 3*u + 1 ] += wy * sum_u;
+        acc[ 3*u + 2 ] += wy * sum_v;
+      }
+    }
+
+    uint8_t* bgr = dst + v * dst_step;
+    for ( int u = 0; u < dst_width; u++, bgr += 3 )
+    {
+      yuvToBGR8( acc[ 3*u ], acc[ 3*u + 1 ], acc[ 3*u + 2 ], gains, bgr );
+    }
+  }
+}
+
+
+void buildRemapTable( const float* map_x, const float* map_y,
+                      int width, int height, int src_width, int src_height,
+                      RemapTable& table )
+{
+  table.width      = width;
+  table.height     = height;
+  table.src_width  = src_width;
+  table.src_height = src_height;
+  
+  table.xy.assign( 2 * width * height, 0 );
+  table.frac.assign( 2 * width * height, 0 );
+  
+  const float scale = static_cast<float>( RemapTable::REMAP_SCALE );
+  
+  for ( int i = 0; i < width * height; i++ )
+  {
+    float x = map_x[i];
+    float y = map_y[i];
+    
+    // Outside of the source image (BORDER_CONSTANT with zero)
+    if ( !( 0.0f <= x && x <= src_width - 1 && 0.0f <= y && y <= src_height - 1 ) || src_width < 2 || src_height < 2 )
+    {
+      table.xy[ 2*i ]     = -1;
+      table.xy[ 2*i + 1 ] = -1;
+      continue;
+    }
+    
+    int ix = static_cast<int>( floorf( x * scale + 0.5f ) );
+    int iy = static_cast<int>( floorf( y * scale + 0.5f ) );
+    
+    int sx = ix >> RemapTable::REMAP_BITS;
+    int sy = iy >> RemapTable::REMAP_BITS;
+    int fx = ix & ( RemapTable::REMAP_SCALE - 1 );
+    int fy = iy & ( RemapTable::REMAP_SCALE - 1 );
+    
+    // Keep the bottom-right neighbour inside the image
+    if ( src_width - 1 <= sx )  { sx = src_width  - 2; fx = RemapTable::REMAP_SCALE; }
+    if ( src_height - 1 <= sy ) { sy = src_height - 2; fy = RemapTable::REMAP_SCALE; }
+    
+    table.xy[ 2*i ]       = static_cast<int16_t>( sx );
+    table.xy[ 2*i + 1 ]   = static_cast<int16_t>( sy );
+    table.frac[ 2*i ]     = static_cast<uint8_t>( fx );
+    table.frac[ 2*i + 1 ] = static_cast<uint8_t>( fy );
+  }
+}
+
+
+void remapMono16( const uint16_t* src, int src_stride, const RemapTable& table, uint16_t* dst )
+{
+  const int     shift = 2 * RemapTable::REMAP_BITS;
+  const uint32_t half = 1u << ( shift - 1 );
+  
+  const int16_t* xy   = table.xy.empty()   ? NULL : &(table.xy[0]);
+  const uint8_t* frac = table.frac.empty() ? NULL : &(table.frac[0]);
+  
+  for ( int i = 0; i < table.width * table.height; i++ )
+  {
+    int sx = xy[ 2*i ];
+    int sy = xy[ 2*i + 1 ];
+    
+    if ( sx < 0 )
+    {
+      dst[i] = 0;
+      continue;
+    }
+    
+    uint32_t fx = frac[ 2*i ];
+    uint32_t fy = frac[ 2*i + 1 ];
+    
+    const uint16_t* p0 = src + sy * src_stride + sx;
+    const uint16_t* p1 = p0 + src_stride;
+    
+    uint32_t w00 = ( RemapTable::REMAP_SCALE - fx ) * ( RemapTable::REMAP_SCALE - fy );
+    uint32_t w01 = fx * ( RemapTable::REMAP_SCALE - fy );
+    uint32_t w10 = ( RemapTable::REMAP_SCALE - fx ) * fy;
+    uint32_t w11 = fx * fy;
+    
+    dst[i] = static_cast<uint16_t>( ( p0[0] * w00 + p0[1] * w01 + p1[0] * w10 + p1[1] * w11 + half ) >> shift );
+  }
+}
+
+
+void remapUYVYToBGR8( const uint16_t* src, int src_stride, const RemapTable& table,
+                      const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  const float norm = 1.0f / static_cast<float>( RemapTable::REMAP_SCALE * RemapTable::REMAP_SCALE );
+  
+  const int16_t* xy   = table.xy.empty()   ? NULL : &(table.xy[0]);
+  const uint8_t* frac = table.frac.empty() ? NULL : &(table.frac[0]);
+  
+  for ( int v = 0; v < table.height; v++ )
+  {
+    uint8_t* bgr = dst + v * dst_step;
+    
+    for ( int u = 0; u < table.width; u++, bgr += 3 )
+    {
+      int i  = v * table.width + u;
+      int sx = xy[ 2*i ];
+      int sy = xy[ 2*i + 1 ];
+      
+      if ( sx < 0 )
+      {
+        bgr[0] = bgr[1] = bgr[2] = 0;
+        continue;
+      }
+      
+      uint32_t fx = frac[ 2*i ];
+      uint32_t fy = frac[ 2*i + 1 ];
+      
+      uint32_t w00 = ( RemapTable::REMAP_SCALE - fx ) * ( RemapTable::REMAP_SCALE - fy );
+      uint32_t w01 = fx * ( RemapTable::REMAP_SCALE - fy );
+      uint32_t w10 = ( RemapTable::REMAP_SCALE - fx ) * fy;
+      uint32_t w11 = fx * fy;
+      
+      const uint16_t* p0 = src + sy * src_stride;
+      const uint16_t* p1 = p0 + src_stride;
+      
+      // Each 16 bit word holds ( U or V ) | ( Y << 8 ). U is stored at even and V at odd pixels.
+      int x0  = sx;
+      int x1  = sx + 1;
+      int ux0 = x0 & ~1, vx0 = x0 | 1;
+      int ux1 = x1 & ~1, vx1 = x1 | 1;
+      if ( table.src_width <= vx1 ) vx1 -= 2;  // odd width: last pixel has no V sample of its own
+      
+      uint32_t y = ( p0[x0] >> 8 ) * w00 + ( p0[x1] >> 8 ) * w01 + ( p1[x0] >> 8 ) * w10 + ( p1[x1] >> 8 ) * w11;
+      uint32_t cu = ( p0[ux0] & 0xFF ) * w00 + ( p0[ux1] & 0xFF ) * w01 + ( p1[ux0] & 0xFF ) * w10 + ( p1[ux1] & 0xFF ) * w11;
+      uint32_t cv = ( p0[vx0] & 0xFF ) * w00 + ( p0[vx1] & 0xFF ) * w01 + ( p1[vx0] & 0xFF ) * w10 + ( p1[vx1] & 0xFF ) * w11;
+      
+      yuvToBGR8( y * norm, cu * norm, cv * norm, gains, bgr );
+    }
+  }
+}
+
+
+/**
+ * @brief buildScanTable builds the ScanTable of a band of depth rows from the undistorted rays.
+ */
+void buildScanTable( const float* ray_x, int width, int height, int row_begin, int rows, ScanTable& table )
+{
+  row_begin = std::max( 0, std::min( row_begin, height - 1 ) );
+  rows      = std::max( 1, std::min( rows, height - row_begin ) );
+  
+  table.width     = width;
+  table.row_begin = row_begin;
+  table.rows      = rows;
+  table.beams     = width;
+  table.beam.resize( width * rows );
+  table.range_scale.resize( width * rows );
+  
+  const float* band = ray_x + row_begin * width;
+  
+  float angle_min =  M_PI;
+  float angle_max = -M_PI;
+  for ( int i = 0; i < width * rows; i++ )
+  {
+    float angle = atan( -band[i] );
+    angle_min = std::min( angle_min, angle );
+    angle_max = std::max( angle_max, angle );
+  }
+  
+  table.angle_min       = angle_min;
+  table.angle_increment = ( 1 < width ) ? ( angle_max - angle_min ) / ( width - 1 ) : 0.0f;
+  
+  for ( int i = 0; i < width * rows; i++ )
+  {
+    int beam = 0;
+    if ( 0.0f < table.angle_increment )
+      beam = static_cast<int>( floor( ( atan( -band[i] ) - angle_min ) / table.angle_increment + 0.5 ) );
+    
+    table.beam[i]        = static_cast<uint16_t>( std::max( 0, std::min( beam, width - 1 ) ) );
+    table.range_scale[i] = static_cast<float>( 0.001 * sqrt( 1.0 + band[i] * band[i] ) );
+  }
+}
+
+
+/**
+ * @brief projectDepthToScan takes the minimum range of each beam over the band of a depth image.
+ */
+void projectDepthToScan( const uint16_t* depth, const ScanTable& table,
+                         float range_min, float range_max, float* ranges )
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  std::fill( ranges, ranges + table.beams, inf );
+  
+  const uint16_t* band  = depth + table.row_begin * table.width;
+  const uint16_t* beam  = &(table.beam[0]);
+  const float*    scale = &(table.range_scale[0]);
+  
+  for ( int i = 0; i < table.width * table.rows; i++ )
+  {
+    if ( band[i] == 0 )
+      continue;
+    
+    float range = band[i] * scale[i];
+    if ( range < range_min || range_max < range )
+      continue;
+    
+    float& r = ranges[ beam[i] ];
+    r = std::min( r, range );
+  }
+}
+
+
+/**
+ * @brief neighborPoint returns the 3D point of a neighbor pixel when it is valid for the center depth.
+ */
+static inline bool neighborPoint( const uint16_t* depth, const float* ray_x, const float* ray_y,
+                                  int i, float z_c, float max_change, float* p )
+{
+  const float z = depth[i];
+  if ( z == 0.0f || max_change < fabsf( z - z_c ) )
+    return false;
+  
+  p[0] = z * ray_x[i];
+  p[1] = z * ray_y[i];
+  p[2] = z;
+  return true;
+}
+
+
+/**
+ * @brief tangent returns the difference of the valid points around the center, preferring a central difference.
+ */
+static inline bool tangent( bool valid_a, const float* a, bool valid_b, const float* b, const float* c, float* t )
+{
+  if ( valid_a && valid_b )
+  {
+    t[0] = b[0] - a[0];  t[1] = b[1] - a[1];  t[2] = b[2] - a[2];
+  }
+  else if ( valid_b )
+  {
+    t[0] = b[0] - c[0];  t[1] = b[1] - c[1];  t[2] = b[2] - c[2];
+  }
+  else if ( valid_a )
+  {
+    t[0] = c[0] - a[0];  t[1] = c[1] - a[1];  t[2] = c[2] - a[2];
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+
+/**
+ * @brief computeDepthNormals computes unit surface normals of rows [ row_begin, row_end ) of a depth image.
+ */
+void computeDepthNormals( const uint16_t* depth, const float* ray_x, const float* ray_y,
+                          int width, int height, int row_begin, int row_end,
+                          int radius, float max_depth_change, float* normals )
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  
+  for ( int v = row_begin; v < row_end; v++ )
+  {
+    for ( int u = 0; u < width; u++ )
+    {
+      const int i = v * width + u;
+      float* n = &(normals[ 3 * i ]);
+      n[0] = n[1] = n[2] = nan;
+      
+      if ( depth[i] == 0 )
+        continue;
+      
+      const float z_c        = depth[i];
+      const float max_change = max_depth_change * z_c;
+      const float c[3] = { z_c * ray_x[i], z_c * ray_y[i], z_c };
+      
+      // Only read by tangent() when the side is valid, zeroed so the compiler can tell
+      float l[3] = { 0.0f, 0.0f, 0.0f };
+      float r[3] = { 0.0f, 0.0f, 0.0f };
+      float t[3] = { 0.0f, 0.0f, 0.0f };
+      float b[3] = { 0.0f, 0.0f, 0.0f };
+      bool valid_l = ( 0 <= u - radius )     && neighborPoint( depth, ray_x, ray_y, i - radius, z_c, max_change, l );
+      bool valid_r = ( u + radius < width )  && neighborPoint( depth, ray_x, ray_y, i + radius, z_c, max_change, r );
+      bool valid_t = ( 0 <= v - radius )     && neighborPoint( depth, ray_x, ray_y, i - radius * width, z_c, max_change, t );
+      bool valid_b = ( v + radius < height ) && neighborPoint( depth, ray_x, ray_y, i + radius * width, z_c, max_change, b );
+      
+      float du[3], dv[3];
+      if ( not tangent( valid_l, l, valid_r, r, c, du ) || not tangent( valid_t, t, valid_b, b, c, dv ) )
+        continue;
+      
+      // dv x du points towards the camera for a surface facing it
+      float nx = dv[1] * du[2] - dv[2] * du[1];
+      float ny = dv[2] * du[0] - dv[0] * du[2];
+      float nz = dv[0] * du[1] - dv[1] * du[0];
+      float norm = sqrtf( nx * nx + ny * ny + nz * nz );
+      if ( norm <= 0.0f )
+        continue;
+      
+      // Flip normals of surfaces seen from behind towards the camera
+      if ( 0.0f < nx * c[0] + ny * c[1] + nz * c[2] )
+        norm = -norm;
+      
+      n[0] = nx / norm;
+      n[1] = ny / norm;
+      n[2] = nz / norm;
+    }
+  }
+}
+
+
+/**
+ * @brief extractUYVYLuma samples the luma of a UYVY image at the nearest source pixel of a dst size grid.
+ */
+void extractUYVYLuma( const uint16_t* src, int src_stride, int src_width, int src_height,
+                      int dst_width, int dst_height, uint8_t* luma )
+{
+  for ( int v = 0; v < dst_height; v++ )
+  {
+    const int sv = std::min( src_height - 1, ( 2 * v + 1 ) * src_height / ( 2 * dst_height ) );
+    const uint8_t* uyvy = reinterpret_cast<const uint8_t*>( src + sv * src_stride );
+    uint8_t*       dst  = luma + v * dst_width;
+    
+    for ( int u = 0; u < dst_width; u++ )
+    {
+      const int su = std::min( src_width - 1, ( 2 * u + 1 ) * src_width / ( 2 * dst_width ) );
+      dst[u] = uyvy[ 2 * su + 1 ];
+    }
+  }
+}
+
+
+/**
+ * @brief registerDepth reprojects a depth image into another camera as a sparse depth image.
+ */
+void registerDepth( const uint16_t* depth, const float* ray_x, const float* ray_y, int width, int height,
+                    const float* translation, const PinholeModel& model,
+                    int dst_width, int dst_height, uint16_t* sparse )
+{
+  std::fill( sparse, sparse + dst_width * dst_height, 0 );
+  
+  // Translation in mm like the depth
+  const float tx = translation[0] * 1000.0f;
+  const float ty = translation[1] * 1000.0f;
+  const float tz = translation[2] * 1000.0f;
+  
+  for ( int i = 0; i < width * height; i++ )
+  {
+    if ( depth[i] == 0 )
+      continue;
+    
+    const float d = depth[i];
+    const float z = d + tz;
+    if ( z <= 0.0f )
+      continue;
+    
+    const float x  = ( d * ray_x[i] + tx ) / z;
+    const float y  = ( d * ray_y[i] + ty ) / z;
+    const float r2 = x * x + y * y;
+    const float k  = 1.0f + ( ( model.k3 * r2 + model.k2 ) * r2 + model.k1 ) * r2;
+    const float xd = x * k + 2.0f * model.p1 * x * y + model.p2 * ( r2 + 2.0f * x * x );
+    const float yd = y * k + model.p1 * ( r2 + 2.0f * y * y ) + 2.0f * model.p2 * x * y;
+    
+    const int u = static_cast<int>( floorf( model.fx * xd + model.cx + 0.5f ) );
+    const int v = static_cast<int>( floorf( model.fy * yd + model.cy + 0.5f ) );
+    if ( u < 0 || dst_width <= u || v < 0 || dst_height <= v )
+      continue;
+    
+    const uint16_t zi = static_cast<uint16_t>( std::min( 65535.0f, z + 0.5f ) );
+    uint16_t& s = sparse[ v * dst_width + u ];
+    if ( s == 0 || zi < s )
+      s = zi;
+  }
+}
+
+
+/**
+ * @brief buildBilateralKernel precomputes the spatial and range weights of a joint bilateral filter.
+ */
+void buildBilateralKernel( int radius, float sigma_space, float sigma_range, BilateralKernel& kernel )
+{
+  radius = std::max( 1, radius );
+  
+  kernel.radius      = radius;
+  kernel.sigma_space = sigma_space;
+  kernel.sigma_range = sigma_range;
+  
+  const int size = 2 * radius + 1;
+  kernel.spatial.resize( size * size );
+  
+  const double s2 = 2.0 * std::max( 0.1f, sigma_space ) * std::max( 0.1f, sigma_space );
+  for ( int dy = -radius; dy <= radius; dy++ )
+    for ( int dx = -radius; dx <= radius; dx++ )
+      kernel.spatial[ ( dy + radius ) * size + dx + radius ] = static_cast<float>( exp( -( dx * dx + dy * dy ) / s2 ) );
+  
+  const double r2 = 2.0 * std::max( 0.1f, sigma_range ) * std::max( 0.1f, sigma_range );
+  for ( int d = 0; d < 256; d++ )
+    kernel.range[d] = static_cast<float>( exp( -( d * d ) / r2 ) );
+}
+
+
+/**
+ * @brief jointBilateralUpsample fills rows [ row_begin, row_end ) of a dense depth image from a sparse one.
+ */
+void jointBilateralUpsample( const uint16_t* sparse, const uint8_t* guide, int width, int height,
+                             const BilateralKernel& kernel, int row_begin, int row_end, uint16_t* dense )
+{
+  const int    radius  = kernel.radius;
+  const int    size    = 2 * radius + 1;
+  const float* spatial = &(kernel.spatial[0]);
+  
+  for ( int v = row_begin; v < row_end; v++ )
+  {
+    const int y0 = std::max( 0, v - radius );
+    const int y1 = std::min( height - 1, v + radius );
+    
+    for ( int u = 0; u < width; u++ )
+    {
+      const int x0 = std::max( 0, u - radius );
+      const int x1 = std::min( width - 1, u + radius );
+      const int g  = guide[ v * width + u ];
+      
+      float sum        = 0.0f;
+      float weight_sum = 0.0f;
+      
+      for ( int y = y0; y <= y1; y++ )
+      {
+        const uint16_t* s = sparse + y * width;
+        const uint8_t*  l = guide  + y * width;
+        const float*    w = spatial + ( y - v + radius ) * size + radius - u;
+        
+        for ( int x = x0; x <= x1; x++ )
+        {
+          if ( s[x] == 0 )
+            continue;
+          
+          const float weight = w[x] * kernel.range[ abs( l[x] - g ) ];
+          sum        += weight * s[x];
+          weight_sum += weight;
+        }
+      }
+      
+      dense[ v * width + u ] = ( 1e-6f < weight_sum ) ? static_cast<uint16_t>( sum / weight_sum + 0.5f ) : 0;
+    }
+  }
+}
+
+
+/**
+ * @brief computeTileSADScalar is the portable version of computeTileSAD.
+ */
+void computeTileSADScalar( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad )
+{
+  const int tiles_x = ( width  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int tiles_y = ( height + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  std::fill( sad, sad + tiles_x * tiles_y, 0 );
+  
+  for ( int v = 0; v < height; v++ )
+  {
+    const uint16_t* pa = a + v * width;
+    const uint16_t* pb = b + v * width;
+    uint32_t*       ps = sad + ( v / CHANGE_TILE_SIZE ) * tiles_x;
+    
+    for ( int u = 0; u < width; u++ )
+      ps[ u / CHANGE_TILE_SIZE ] += abs( static_cast<int>( pa[u] ) - static_cast<int>( pb[u] ) );
+  }
+}
+
+
+/**
+ * @brief computeTileSAD sums the absolute differences of two depth images per 16x16 tile.
+ */
+void computeTileSAD( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad )
+{
+  pixelKernels().tile_sad( a, b, width, height, sad );
+}
+
+
+/**
+ * @brief detectChangedTiles marks the tiles whose mean absolute depth difference exceeds a threshold.
+ */
+int detectChangedTiles( const uint16_t* depth, const uint16_t* reference, int width, int height,
+                        float threshold, std::vector<uint32_t>& sad, uint8_t* mask )
+{
+  const int tiles_x = ( width  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int tiles_y = ( height + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  
+  sad.resize( tiles_x * tiles_y );
+  computeTileSAD( depth, reference, width, height, &(sad[0]) );
+  
+  int changed = 0;
+  for ( int ty = 0; ty < tiles_y; ty++ )
+  {
+    const int rows = std::min( CHANGE_TILE_SIZE, height - ty * CHANGE_TILE_SIZE );
+    for ( int tx = 0; tx < tiles_x; tx++ )
+    {
+      const int   cols  = std::min( CHANGE_TILE_SIZE, width - tx * CHANGE_TILE_SIZE );
+      const int   i     = ty * tiles_x + tx;
+      const bool  dirty = threshold * ( rows * cols ) < static_cast<float>( sad[i] );
+      
+      mask[i]  = dirty ? 255 : 0;
+      changed += dirty ? 1 : 0;
+    }
+  }
+  
+  return changed;
+}
+
+
+/**
+ * @brief cloudPointStep returns the bytes per point of an encoding.
+ */
+int cloudPointStep( CloudEncoding encoding )
+{
+  return encoding == CLOUD_FLOAT32 ? 3 * sizeof(float) : 3 * sizeof(uint16_t);
+}
+
+
+/**
+ * @brief floatToHalf converts a float to an IEEE 754 half float, rounding to nearest even.
+ */
+uint16_t floatToHalf( float value )
+{
+  uint32_t f;
+  memcpy( &f, &value, sizeof(f) );
+  
+  const uint16_t sign     = static_cast<uint16_t>( ( f >> 16 ) & 0x8000 );
+  const int      exponent = static_cast<int>( ( f >> 23 ) & 0xFF );
+  uint32_t       mantissa = f & 0x7FFFFF;
+  
+  // Inf and NaN (kept quiet)
+  if ( exponent == 0xFF )
+    return sign | 0x7C00 | ( mantissa ? 0x200 : 0 );
+  
+  const int e = exponent - 127 + 15;
+  
+  // Overflow to Inf
+  if ( 31 <= e )
+    return sign | 0x7C00;
+  
+  // Subnormal halfs, or zero below half of the smallest one
+  if ( e <= 0 )
+  {
+    if ( e < -10 )
+      return sign;
+    
+    mantissa |= 0x800000;
+    const int      shift = 14 - e;
+    const uint32_t rest  = mantissa & ( ( 1u << shift ) - 1 );
+    const uint32_t tie   = 1u << ( shift - 1 );
+    uint32_t       half  = mantissa >> shift;
+    if ( tie < rest || ( rest == tie && ( half & 1 ) ) )
+      half++;
+    return sign | static_cast<uint16_t>( half );
+  }
+  
+  // A carry out of the mantissa correctly rounds up to the next exponent (or Inf)
+  uint32_t       half = ( static_cast<uint32_t>( e ) << 10 ) | ( mantissa >> 13 );
+  const uint32_t rest = mantissa & 0x1FFF;
+  if ( 0x1000 < rest || ( rest == 0x1000 && ( half & 1 ) ) )
+    half++;
+  return sign | static_cast<uint16_t>( half );
+}
+
+
+/**
+ * @brief encodeDepthCloud converts a depth image to packed points in the depth optical frame.
+ */
+size_t encodeDepthCloud( const uint16_t* depth, const float* ray_x, const float* ray_y, int width, int height,
+                         CloudEncoding encoding, bool drop_invalid, uint8_t* out )
+{
+  const int    pixels = width * height;
+  const float  nan    = std::numeric_limits<float>::quiet_NaN();
+  const size_t step   = cloudPointStep( encoding );
+  size_t       points = 0;
+  
+  for ( int i = 0; i < pixels; i++ )
+  {
+    // Depths beyond the int16 range (32.767 m) are invalid in millimetres
+    const uint16_t d     = depth[i];
+    const bool     valid = d != 0 && ( encoding != CLOUD_INT16_MM || d <= 32767 );
+    if ( not valid && drop_invalid )
+      continue;
+    
+    uint8_t* point = out + points * step;
+    points++;
+    
+    switch ( encoding )
+    {
+      case CLOUD_FLOAT32:
+      {
+        float xyz[3] = { nan, nan, nan };
+        if ( valid )
+        {
+          const float z = d * 0.001f;
+          xyz[0] = z * ray_x[i];
+          xyz[1] = z * ray_y[i];
+          xyz[2] = z;
+        }
+        memcpy( point, xyz, sizeof(xyz) );
+        break;
+      }
+      case CLOUD_INT16_MM:
+      {
+        int16_t xyz[3] = { 0, 0, 0 };
+        if ( valid )
+        {
+          const float z = d;
+          xyz[0] = static_cast<int16_t>( std::max( -32768.0f, std::min( 32767.0f, floorf( z * ray_x[i] + 0.5f ) ) ) );
+          xyz[1] = static_cast<int16_t>( std::max( -32768.0f, std::min( 32767.0f, floorf( z * ray_y[i] + 0.5f ) ) ) );
+          xyz[2] = static_cast<int16_t>( d );
+        }
+        memcpy( point, xyz, sizeof(xyz) );
+        break;
+      }
+      case CLOUD_FLOAT16:
+      {
+        uint16_t xyz[3] = { 0x7E00, 0x7E00, 0x7E00 };
+        if ( valid )
+        {
+          const float z = d * 0.001f;
+          xyz[0] = floatToHalf( z * ray_x[i] );
+          xyz[1] = floatToHalf( z * ray_y[i] );
+          xyz[2] = floatToHalf( z );
+        }
+        memcpy( point, xyz, sizeof(xyz) );
+        break;
+      }
+    }
+  }
+  
+  return points;
+}
+
+};
@@ -0,0 +1,247 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cis_camera/frame_kernels.h"
+#include "cis_camera/pixel_kernels.h"
+#include "cis_camera/stage_timer.h"
+
+
+using namespace cis_camera;
+
+
+static void printUsage()
+{
+  printf( "Usage: kernel_benchmark [options]\n"
+          "  --repeat N             frames per stage and kernel set (default: 200)\n"
+          "  --level LEVEL          auto, all, scalar, sse2, avx2 or neon (default: all supported)\n"
+          "  --geometry W H C       frame width, height and color width (default: 1920 960 1280)\n" );
+}
+
+
+/**
+ * @brief Frame holds a synthetic raw frame, the calibration and the output images of one kernel set.
+ */
+struct Frame
+{
+  FrameGeometry         geometry;
+  std::vector<uint16_t> raw;
+  std::vector<float>    inv_norm;
+  std::vector<uint8_t>  bgr8;
+  std::vector<uint16_t> depth;
+  std::vector<uint16_t> ir;
+
+  explicit Frame( const FrameGeometry& g ) :
+      geometry( g ),
+      raw( g.frame_width * g.frame_height ),
+      inv_norm( g.depthWidth() * g.depthHeight() ),
+      bgr8( g.color_width * g.frame_height * 3 ),
+      depth( g.depthWidth() * g.depthHeight() ),
+      ir( g.depthWidth() * g.depthHeight() )
+  {
+    for ( size_t i = 0; i < raw.size(); i++ )
+      raw[i] = static_cast<uint16_t>( rand() );
+
+    for ( size_t i = 0; i < inv_norm.size(); i++ )
+      inv_norm[i] = 0.8f + 0.2f * ( rand() % 1000 ) / 1000.0f;
+  }
+};
+
+
+/**
+ * @brief runStages runs every frame stage of a kernel set once and laps the timer after each.
+ */
+static void runStages( const FrameKernels& kernels, const std::string& suffix, Frame& frame, StageTimer& timer )
+{
+  const ColorGains gains( 1.2f, 1.0f, 1.1f );
+  const int        color_step = frame.geometry.color_width * 3;
+
+  timer.start();
+  kernels.convert_color( &(frame.raw[0]), frame.geometry, gains, &(frame.bgr8[0]), color_step );
+  timer.lap( "color " + suffix );
+
+  kernels.bin_color( &(frame.raw[0]), frame.geometry, 2, gains, &(frame.bgr8[0]), color_step / 2 );
+  timer.lap( "bin2 " + suffix );
+
+  kernels.bin_color( &(frame.raw[0]), frame.geometry, 4, gains, &(frame.bgr8[0]), color_step / 4 );
+  timer.lap( "bin4 " + suffix );
+
+  kernels.deinterlace( &(frame.raw[0]), frame.geometry, &(frame.inv_norm[0]), 2.0, 0.0,
+                       &(frame.depth[0]), &(frame.ir[0]) );
+  timer.lap( "deinterlace " + suffix );
+}
+
+
+/**
+ * @brief sameOutputs checks that two kernel sets produce the same images from the same frame.
+ */
+static bool sameOutputs( const FrameKernels& a, const FrameKernels& b, Frame& frame )
+{
+  StageTimer timer;
+  Frame      other( frame.geometry );
+  other.raw      = frame.raw;
+  other.inv_norm = frame.inv_norm;
+
+  runStages( a, "a", frame, timer );
+  runStages( b, "b", other, timer );
+
+  return frame.bgr8 == other.bgr8 && frame.depth == other.depth && frame.ir == other.ir;
+}
+
+
+/**
+ * @brief benchmarkLevel times the generic and the specialized frame kernels of one level.
+ */
+static void benchmarkLevel( CpuLevel level, Frame& frame, int repeat )
+{
+  selectPixelKernels( level );
+
+  const FrameKernels& generic = genericFrameKernels();
+  const FrameKernels& fixed   = frameKernels( frame.geometry );
+  const bool          compare = ( &fixed != &generic );
+
+  printf( "\n[%s] %s\n", cpuLevelName( level ),
+          compare ? fixed.name : "no specialized kernels for this level and geometry" );
+
+  if ( compare && not sameOutputs( generic, fixed, frame ) )
+    printf( "WARNING: the specialized kernels give other images than the generic ones\n" );
+
+  StageTimer timer( repeat );
+
+  // Alternate the kernel sets frame by frame, so both see the same cache and clock conditions
+  for ( int i = 0; i < repeat; i++ )
+  {
+    runStages( generic, "generic", frame, timer );
+    if ( compare )
+      runStages( fixed, "fixed", frame, timer );
+  }
+
+  const char* stages[] = { "color", "bin2", "bin4", "deinterlace" };
+
+  for ( int s = 0; s < 4; s++ )
+  {
+    StageTimer::Stats g = timer.stats( std::string( stages[s] ) + " generic" );
+
+    if ( compare )
+    {
+      StageTimer::Stats f = timer.stats( std::string( stages[s] ) + " fixed" );
+      printf( "%-12s generic p50 %8.3f mean %8.3f  fixed p50 %8.3f mean %8.3f [ms]  speedup %5.2fx\n",
+              stages[s], g.p50, g.mean, f.p50, f.mean, ( 0.0 < f.p50 ) ? g.p50 / f.p50 : 0.0 );
+    }
+    else
+    {
+      printf( "%-12s generic p50 %8.3f mean %8.3f [ms]\n", stages[s], g.p50, g.mean );
+    }
+  }
+}
+
+
+int main( int argc, char *argv[] )
+{
+  int           repeat = 200;
+  std::string   level_name = "all";
+  FrameGeometry geometry( DefaultFrameLayout::FRAME_WIDTH, DefaultFrameLayout::FRAME_HEIGHT,
+                          DefaultFrameLayout::COLOR_WIDTH );
+
+  for ( int i = 1; i < argc; i++ )
+  {
+    std::string arg( argv[i] );
+
+    if ( arg == "--repeat" && i + 1 < argc )
+    {
+      repeat = std::max( 1, atoi( argv[++i] ) );
+    }
+    else if ( arg == "--level" && i + 1 < argc )
+    {
+      level_name = argv[++i];
+    }
+    else if ( arg == "--geometry" && i + 3 < argc )
+    {
+      geometry = FrameGeometry( atoi( argv[i + 1] ), atoi( argv[i + 2] ), atoi( argv[i + 3] ) );
+      i += 3;
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if ( geometry.frame_width <= geometry.color_width || geometry.color_width < 2 || geometry.frame_height < 4 ||
+       geometry.color_width % 2 != 0 )
+  {
+    fprintf( stderr, "Invalid geometry %d x %d with color width %d.\n",
+             geometry.frame_width, geometry.frame_height, geometry.color_width );
+    return 1;
+  }
+
+  std::vector<CpuLevel> levels;
+
+  if ( level_name == "all" )
+  {
+    for ( int l = CPU_SCALAR; l < CPU_LEVELS; l++ )
+    {
+      if ( pixelKernels( static_cast<CpuLevel>( l ) ) != NULL )
+        levels.push_back( static_cast<CpuLevel>( l ) );
+    }
+  }
+  else
+  {
+    CpuLevel level;
+    if ( not parseCpuLevel( level_name, level ) || pixelKernels( level ) == NULL )
+    {
+      fprintf( stderr, "Instruction set %s is unknown or not supported here.\n", level_name.c_str() );
+      return 1;
+    }
+    levels.push_back( level );
+  }
+
+  printf( "Frame %d x %d, color width %d, %d frames per stage, detected %s\n",
+          geometry.frame_width, geometry.frame_height, geometry.color_width, repeat,
+          cpuLevelName( detectCpuLevel() ) );
+
+  Frame frame( geometry );
+
+  for ( size_t l = 0; l < levels.size(); l++ )
+    benchmarkLevel( levels[l], frame, repeat );
+
+  return 0;
+}
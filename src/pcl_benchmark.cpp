@@ -0,0 +1,373 @@
+/*
+ *  This example is based on "Building a Perception Pipleline" of ROS Industrial Training
+ *
+ *  * https://industrial-training-master.readthedocs.io/en/melodic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-master.readthedocs.io/en/kinetic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-jp.readthedocs.io/ja/latest/_source/session5_JP/Building-a-Perception-Pipeline_JP.html
+ *
+ *  Offline benchmark of the PCL example pipeline. The clouds come from PCD files
+ *  or a bag, the camera to world transform is fixed, so neither a ROS master nor
+ *  a TF tree is needed. Every frame runs through PclPipeline as fast as possible
+ *  and the per-stage latency percentiles and the throughput are printed.
+ *
+ *  $ rosrun cis_camera pcl_benchmark <pcd directory | file.pcd | file.bag> [options] [name:=value ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/common/centroid.h>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include "cis_camera/pcl_pipeline.h"
+
+
+using cis_camera::PclPipeline;
+using cis_camera::StageTimer;
+
+typedef std::chrono::steady_clock Clock;
+
+
+static void printUsage()
+{
+  printf( "Usage: pcl_benchmark <pcd directory | file.pcd | file.bag> [options] [name:=value ...]\n"
+          "  --topic TOPIC          PointCloud2 topic in a bag (default: all PointCloud2 messages)\n"
+          "  --repeat N             process the frames N times (default: 1)\n"
+          "  --warmup N             frames processed before the timing starts (default: 1)\n"
+          "  --transform X Y Z QX QY QZ QW\n"
+          "                         fixed camera to world transform (default: identity)\n"
+          "  name:=value            pipeline parameter as for pcl_example, e.g. leaf_size:=0.005 plane_mode:=organized\n" );
+}
+
+
+/**
+ * @brief setParameter sets one pipeline parameter by its pcl_example parameter name.
+ * @return bool false when the name or the value is unknown
+ */
+static bool setParameter( PclPipeline::Parameters& params, const std::string& name, const std::string& value )
+{
+  const char* v = value.c_str();
+  bool flag = ( value == "true" || value == "1" );
+
+  if      ( name == "fused_front_end" )         params.fused_front_end         = flag;
+  else if ( name == "compare_front_end" )       params.compare_front_end       = flag;
+  else if ( name == "threads" )                 params.threads                 = atoi( v );
+  else if ( name == "leaf_size" )               params.leaf_size               = atof( v );
+  else if ( name == "min_x" )                   params.min_x                   = atof( v );
+  else if ( name == "max_x" )                   params.max_x                   = atof( v );
+  else if ( name == "min_y" )                   params.min_y                   = atof( v );
+  else if ( name == "max_y" )                   params.max_y                   = atof( v );
+  else if ( name == "min_z" )                   params.min_z                   = atof( v );
+  else if ( name == "max_z" )                   params.max_z                   = atof( v );
+  else if ( name == "compare_outlier_filter" )  params.compare_outlier_filter  = flag;
+  else if ( name == "sor_mean_k" )              params.sor_mean_k              = atoi( v );
+  else if ( name == "sor_stddev" )              params.sor_stddev              = atof( v );
+  else if ( name == "outlier_window" )          params.outlier_window          = atoi( v );
+  else if ( name == "outlier_stddev" )          params.outlier_stddev          = atof( v );
+  else if ( name == "outlier_min_neighbors" )   params.outlier_min_neighbors   = atoi( v );
+  else if ( name == "plane_max_iterations" )    params.plane_max_iterations    = atoi( v );
+  else if ( name == "plane_distance" )          params.plane_distance          = atof( v );
+  else if ( name == "plane_cache" )             params.plane_cache             = flag;
+  else if ( name == "plane_cache_samples" )     params.plane_cache_samples     = atoi( v );
+  else if ( name == "plane_cache_min_ratio" )   params.plane_cache_min_ratio   = atof( v );
+  else if ( name == "plane_min_inliers" )       params.plane_min_inliers       = atoi( v );
+  else if ( name == "plane_angular_threshold" ) params.plane_angular_threshold = atof( v );
+  else if ( name == "cluster_tolerance" )       params.cluster_tolerance       = atof( v );
+  else if ( name == "cluster_min_size" )        params.cluster_min_size        = atoi( v );
+  else if ( name == "cluster_max_size" )        params.cluster_max_size        = atoi( v );
+  else if ( name == "cluster_depth_jump" )      params.cluster_depth_jump      = atof( v );
+  else if ( name == "cluster_min_pixels" )      params.cluster_min_pixels      = atoi( v );
+  else if ( name == "cluster_max_pixels" )      params.cluster_max_pixels      = atoi( v );
+  else if ( name == "tracking" )                params.tracking                = flag;
+  else if ( name == "track_margin" )            params.track_margin            = atof( v );
+  else if ( name == "full_search_interval" )    params.full_search_interval    = atoi( v );
+  else if ( name == "plane_mode" )
+  {
+    if      ( value == "sac" )       params.plane_mode = PclPipeline::PLANE_SAC;
+    else if ( value == "organized" ) params.plane_mode = PclPipeline::PLANE_ORGANIZED;
+    else return false;
+  }
+  else if ( name == "cluster_mode" )
+  {
+    if      ( value == "euclidean" ) params.cluster_mode = PclPipeline::CLUSTER_EUCLIDEAN;
+    else if ( value == "connected" ) params.cluster_mode = PclPipeline::CLUSTER_CONNECTED;
+    else return false;
+  }
+  else if ( name == "outlier_filter" )
+  {
+    if      ( value == "sor" )       params.outlier_filter = PclPipeline::OUTLIER_SOR;
+    else if ( value == "organized" ) params.outlier_filter = PclPipeline::OUTLIER_ORGANIZED;
+    else if ( value == "none" )      params.outlier_filter = PclPipeline::OUTLIER_NONE;
+    else return false;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * @brief loadFrames reads all clouds up front, so the file access is not timed.
+ * A directory is read in file name order, a bag in message order.
+ */
+static bool loadFrames( const std::string& path, const std::string& topic,
+                        std::vector<PclPipeline::Cloud::Ptr>& frames )
+{
+  namespace fs = boost::filesystem;
+
+  std::vector<std::string> pcd_files;
+
+  if ( fs::is_directory( path ) )
+  {
+    for ( fs::directory_iterator it( path ); it != fs::directory_iterator(); ++it )
+    {
+      if ( it->path().extension() == ".pcd" )
+        pcd_files.push_back( it->path().string() );
+    }
+    std::sort( pcd_files.begin(), pcd_files.end() );
+  }
+  else if ( fs::path( path ).extension() == ".pcd" )
+  {
+    pcd_files.push_back( path );
+  }
+  else if ( fs::path( path ).extension() == ".bag" )
+  {
+    try
+    {
+      rosbag::Bag bag( path, rosbag::bagmode::Read );
+
+      rosbag::View view;
+      if ( topic.empty() )
+        view.addQuery( bag );
+      else
+        view.addQuery( bag, rosbag::TopicQuery( topic ) );
+
+      BOOST_FOREACH( const rosbag::MessageInstance& m, view )
+      {
+        sensor_msgs::PointCloud2::ConstPtr msg = m.instantiate<sensor_msgs::PointCloud2>();
+        if ( not msg )
+          continue;
+
+        PclPipeline::Cloud::Ptr cloud( new PclPipeline::Cloud );
+        pcl::fromROSMsg( *msg, *cloud );
+        frames.push_back( cloud );
+      }
+    }
+    catch ( rosbag::BagException& ex )
+    {
+      fprintf( stderr, "Unable to read %s: %s\n", path.c_str(), ex.what() );
+      return false;
+    }
+  }
+  else
+  {
+    fprintf( stderr, "%s is neither a directory, a PCD file nor a bag.\n", path.c_str() );
+    return false;
+  }
+
+  for ( size_t i = 0; i < pcd_files.size(); i++ )
+  {
+    PclPipeline::Cloud::Ptr cloud( new PclPipeline::Cloud );
+    if ( pcl::io::loadPCDFile( pcd_files[i], *cloud ) < 0 )
+    {
+      fprintf( stderr, "Unable to read %s\n", pcd_files[i].c_str() );
+      return false;
+    }
+    frames.push_back( cloud );
+  }
+
+  return true;
+}
+
+
+/**
+ * @brief fillInput copies a frame into the pipeline input like PclExampleNodelet does
+ * with a live cloud: organized in the camera frame, or transformed without invalid points.
+ * @return size_t number of points of the frame
+ */
+static size_t fillInput( PclPipeline& pipeline, const PclPipeline::Cloud& frame, const Eigen::Affine3f& transform )
+{
+  if ( pipeline.usesOrganizedInput() )
+  {
+    pipeline.organizedInput() = frame;
+    pipeline.setSensorTransform( transform );
+    return frame.points.size();
+  }
+
+  PclPipeline::Cloud& cloud = pipeline.input();
+  cloud.points.resize( frame.points.size() );
+
+  size_t n = 0;
+  for ( size_t i = 0; i < frame.points.size(); i++ )
+  {
+    const PclPipeline::Point& p = frame.points[i];
+    if ( not pcl_isfinite( p.x ) || not pcl_isfinite( p.y ) || not pcl_isfinite( p.z ) )
+      continue;
+
+    cloud.points[n++].getVector3fMap() = transform * p.getVector3fMap();
+  }
+
+  cloud.points.resize( n );
+  cloud.width    = n;
+  cloud.height   = 1;
+  cloud.is_dense = true;
+  cloud.header   = frame.header;
+
+  return frame.points.size();
+}
+
+
+int main( int argc, char *argv[] )
+{
+  if ( argc < 2 )
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::string path( argv[1] );
+  std::string topic;
+  int repeat = 1;
+  int warmup = 1;
+  Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+  PclPipeline::Parameters params;
+
+  for ( int i = 2; i < argc; i++ )
+  {
+    std::string arg( argv[i] );
+    size_t assign = arg.find( ":=" );
+
+    if ( arg == "--topic" && i + 1 < argc )
+    {
+      topic = argv[++i];
+    }
+    else if ( arg == "--repeat" && i + 1 < argc )
+    {
+      repeat = std::max( 1, atoi( argv[++i] ) );
+    }
+    else if ( arg == "--warmup" && i + 1 < argc )
+    {
+      warmup = std::max( 0, atoi( argv[++i] ) );
+    }
+    else if ( arg == "--transform" && i + 7 < argc )
+    {
+      Eigen::Vector3f t( atof( argv[i + 1] ), atof( argv[i + 2] ), atof( argv[i + 3] ) );
+      Eigen::Quaternionf q( atof( argv[i + 7] ), atof( argv[i + 4] ), atof( argv[i + 5] ), atof( argv[i + 6] ) );
+      transform = Eigen::Translation3f( t ) * q.normalized();
+      i += 7;
+    }
+    else if ( assign != std::string::npos )
+    {
+      // Accept the rosrun private parameter form _name:=value as well
+      std::string name = arg.substr( arg[0] == '_' ? 1 : 0, arg[0] == '_' ? assign - 1 : assign );
+      if ( not setParameter( params, name, arg.substr( assign + 2 ) ) )
+      {
+        fprintf( stderr, "Unknown parameter or value: %s\n", arg.c_str() );
+        return 1;
+      }
+    }
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if ( params.outlier_window != 3 && params.outlier_window != 5 )
+  {
+    fprintf( stderr, "outlier_window must be 3 or 5.\n" );
+    return 1;
+  }
+
+  if ( params.compare_outlier_filter && params.outlier_filter != PclPipeline::OUTLIER_ORGANIZED )
+  {
+    fprintf( stderr, "compare_outlier_filter needs outlier_filter:=organized.\n" );
+    return 1;
+  }
+
+  std::vector<PclPipeline::Cloud::Ptr> frames;
+  if ( not loadFrames( path, topic, frames ) )
+    return 1;
+
+  if ( frames.empty() )
+  {
+    fprintf( stderr, "No point clouds found in %s\n", path.c_str() );
+    return 1;
+  }
+
+  PclPipeline pipeline( params );
+  StageTimer& timer = pipeline.timer();
+
+  size_t total_frames = frames.size() * repeat;
+  timer.setWindow( total_frames );
+
+  printf( "%zu clouds (%u x %u) from %s, %d repeats, %d warmup frames\n",
+          frames.size(), frames[0]->width, frames[0]->height, path.c_str(), repeat, warmup );
+
+  for ( int i = 0; i < warmup; i++ )
+  {
+    fillInput( pipeline, *frames[ i % frames.size() ], transform );
+    pipeline.process();
+  }
+  pipeline.resetTracking();
+  timer.clear();
+
+  size_t points = 0;
+  size_t found  = 0;
+  double busy   = 0.0;
+
+  for ( size_t f = 0; f < total_frames; f++ )
+  {
+    Clock::time_point frame_start = Clock::now();
+
+    timer.start();
+    points += fillInput( pipeline, *frames[ f % frames.size() ], transform );
+    timer.lap( "input" );
+
+    if ( pipeline.process() )
+    {
+      // Centroid of the largest cluster, the TF of the object in pcl_example
+      Eigen::Vector4f xyz_centroid;
+      pcl::compute3DCentroid( pipeline.largestCluster(), xyz_centroid );
+      timer.lap( "centroid" );
+      found++;
+    }
+
+    double msec = std::chrono::duration<double, std::milli>( Clock::now() - frame_start ).count();
+    timer.add( "total", msec );
+    busy += msec;
+  }
+
+  printf( "\n%s", timer.report().c_str() );
+  printf( "\n%zu frames, %zu with a cluster, %.1f frames/s, %.3f Mpoints/s\n",
+          total_frames, found, total_frames / ( busy / 1000.0 ), points / ( busy / 1000.0 ) / 1.0e6 );
+
+  if ( params.plane_cache )
+    printf( "Plane cache: %zu hits, %zu RANSAC fits\n", pipeline.planeCacheHits(), pipeline.planeCacheMisses() );
+
+  if ( params.compare_front_end )
+    printf( "Front end comparison (last frame): %zu / %zu voxels, max centroid deviation %g m\n",
+            pipeline.frontEndSize(), pipeline.frontEndReferenceSize(), pipeline.frontEndDeviation() );
+
+  if ( params.compare_outlier_filter )
+    printf( "Outlier filter comparison (last frame): organized removed %zu, StatisticalOutlierRemoval removed %zu of %zu points\n",
+            pipeline.outlierRemoved(), pipeline.outlierReferenceRemoved(), pipeline.outlierInputSize() );
+
+  return 0;
+}
@@ -0,0 +1,566 @@
+/*
+ *  This example is based on "Building a Perception Pipleline" of ROS Industrial Training
+ *
+ *  * https://industrial-training-master.readthedocs.io/en/melodic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-master.readthedocs.io/en/kinetic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-jp.readthedocs.io/ja/latest/_source/session5_JP/Building-a-Perception-Pipeline_JP.html
+ *
+ */
+
+#include <algorithm>
+
+#include <ros/ros.h>
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+#include <tf/transform_listener.h>
+#include <tf/transform_broadcaster.h>
+#include <tf_conversions/tf_eigen.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <pcl_msgs/ModelCoefficients.h>
+
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/common/centroid.h>
+
+#include "cis_camera/frame_pipeline.h"
+#include "cis_camera/pcl_pipeline.h"
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief PclExampleNodelet runs PclPipeline on the latest point cloud.
+ * Loaded into the camera nodelet manager the clouds are passed as shared
+ * pointers without serialization. The subscription keeps only the latest
+ * cloud, the TF listener lives as long as the nodelet and all intermediate
+ * clouds are owned by the pipeline and reused across frames.
+ * With pipelined the callback only converts the cloud into a pooled frame, and
+ * filtering, segmentation and clustering with publishing run on their own
+ * threads behind bounded queues which drop the oldest frame when a stage falls behind.
+ */
+class PclExampleNodelet : public nodelet::Nodelet
+{
+public:
+
+  PclExampleNodelet() : pipelined_( false ) {}
+
+private:
+
+  virtual void onInit();
+
+  void loadParameters( ros::NodeHandle& priv_nh );
+  void cloudCallback( const sensor_msgs::PointCloud2::ConstPtr& msg );
+  bool lookupTransform( const std_msgs::Header& header, Eigen::Affine3f& transform );
+  bool fillInput( const sensor_msgs::PointCloud2& msg, PclPipeline::Frame& frame );
+  bool fillOrganizedInput( const sensor_msgs::PointCloud2& msg, PclPipeline::Frame& frame );
+  void publish( const PclPipeline::Frame& frame );
+  void reportTiming();
+  void startStages( int queue_size );
+
+  std::string world_frame_;
+  double      tf_timeout_;
+
+  // Per-stage timing output
+  bool          timing_;
+  double        timing_period_;
+  ros::WallTime last_report_;
+
+  boost::shared_ptr<tf::TransformListener>  listener_;
+  boost::shared_ptr<tf::TransformBroadcaster> broadcaster_;
+
+  ros::Subscriber cloud_sub_;
+  ros::Publisher  object_pub_;
+  ros::Publisher  cluster_pub_;
+  ros::Publisher  plane_pub_;
+
+  PclPipeline pipeline_;
+
+  // Pipelined Execution: one timer per stage thread, declared before the frame
+  // pipeline so its threads are joined before the timers and the pipeline go away
+  bool        pipelined_;
+  StageTimer  input_timer_;
+  StageTimer  filter_timer_;
+  StageTimer  segment_timer_;
+  StageTimer  publish_timer_;
+
+  boost::shared_ptr<FramePipeline<PclPipeline::Frame> > frame_pipeline_;
+};
+
+
+void PclExampleNodelet::onInit()
+{
+  ros::NodeHandle nh( getNodeHandle() );
+  ros::NodeHandle priv_nh( getPrivateNodeHandle() );
+
+  loadParameters( priv_nh );
+
+  std::string cloud_topic;
+  priv_nh.param<std::string>( "cloud_topic", cloud_topic, "/camera/depth/points" );
+
+  listener_.reset( new tf::TransformListener( nh ) );
+  broadcaster_.reset( new tf::TransformBroadcaster() );
+
+  object_pub_  = nh.advertise<sensor_msgs::PointCloud2>( "object_cluster" , 1 );
+  cluster_pub_ = nh.advertise<sensor_msgs::PointCloud2>( "primary_cluster", 1 );
+  plane_pub_   = nh.advertise<pcl_msgs::ModelCoefficients>( "plane_model", 1 );
+
+  int queue_size;
+  priv_nh.param( "pipelined" , pipelined_, false );
+  priv_nh.param( "queue_size", queue_size, 1 );
+  if ( pipelined_ && not pipeline_.supportsStages() )
+  {
+    NODELET_WARN( "pipelined needs cluster_mode 'euclidean' without tracking and comparisons - Run serially." );
+    pipelined_ = false;
+  }
+  if ( pipelined_ )
+    startStages( queue_size );
+
+  // Queue size 1 drops stale clouds while a frame is being processed
+  cloud_sub_ = nh.subscribe( cloud_topic, 1, &PclExampleNodelet::cloudCallback, this );
+
+  NODELET_INFO_STREAM( "PCL example: listening for a PointCloud2 on topic " << nh.resolveName( cloud_topic ) );
+}
+
+
+/**
+ * @brief startStages starts the filter, segmentation and cluster/publish threads.
+ * @param queue_size int frames waiting in front of each stage
+ */
+void PclExampleNodelet::startStages( int queue_size )
+{
+  frame_pipeline_.reset( new FramePipeline<PclPipeline::Frame>( std::max( 1, queue_size ) ) );
+
+  frame_pipeline_->addStage( [this]( PclPipeline::Frame& frame )
+  {
+    filter_timer_.start();
+    pipeline_.filterStage( frame, filter_timer_ );
+    return true;
+  } );
+
+  frame_pipeline_->addStage( [this]( PclPipeline::Frame& frame )
+  {
+    segment_timer_.start();
+    if ( frame.filtered && not frame.filtered->empty() )
+      pipeline_.segmentStage( frame, segment_timer_ );
+    return true;
+  } );
+
+  frame_pipeline_->addStage( [this]( PclPipeline::Frame& frame )
+  {
+    publish_timer_.start();
+    if ( frame.objects && not frame.objects->empty() )
+      pipeline_.clusterStage( frame, publish_timer_ );
+    publish( frame );
+    publish_timer_.lap( "publish" );
+
+    if ( timing_ )
+    {
+      std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - frame.received;
+      publish_timer_.add( "latency", latency.count() );
+      reportTiming();
+    }
+    return true;
+  } );
+
+  frame_pipeline_->start( []() { return boost::shared_ptr<PclPipeline::Frame>( new PclPipeline::Frame ); } );
+
+  NODELET_INFO( "PCL example: pipelined execution, %d frame(s) queued per stage.", std::max( 1, queue_size ) );
+}
+
+
+/**
+ * @brief loadParameters reads the frames and the pipeline parameters.
+ * The defaults are the values of the original ROS Industrial example.
+ */
+void PclExampleNodelet::loadParameters( ros::NodeHandle& priv_nh )
+{
+  priv_nh.param<std::string>( "world_frame", world_frame_, "map" );
+  priv_nh.param( "tf_timeout", tf_timeout_, 0.1 );
+
+  priv_nh.param( "timing"       , timing_       , false );
+  priv_nh.param( "timing_period", timing_period_, 5.0 );
+
+  PclPipeline::Parameters params;
+  priv_nh.param( "fused_front_end"  , params.fused_front_end  , params.fused_front_end );
+  priv_nh.param( "compare_front_end", params.compare_front_end, params.compare_front_end );
+  priv_nh.param( "threads"          , params.threads          , params.threads );
+
+  std::string plane_mode;
+  priv_nh.param<std::string>( "plane_mode", plane_mode, "sac" );
+  if ( plane_mode == "organized" )
+  {
+    params.plane_mode = PclPipeline::PLANE_ORGANIZED;
+  }
+  else if ( plane_mode != "sac" )
+  {
+    NODELET_WARN( "Unknown plane_mode '%s' - Use 'sac'.", plane_mode.c_str() );
+  }
+
+  double leaf_size = params.leaf_size;
+  double min_x = params.min_x, max_x = params.max_x;
+  double min_y = params.min_y, max_y = params.max_y;
+  double min_z = params.min_z, max_z = params.max_z;
+
+  priv_nh.param( "leaf_size", leaf_size, leaf_size );
+  priv_nh.param( "min_x", min_x, min_x );
+  priv_nh.param( "max_x", max_x, max_x );
+  priv_nh.param( "min_y", min_y, min_y );
+  priv_nh.param( "max_y", max_y, max_y );
+  priv_nh.param( "min_z", min_z, min_z );
+  priv_nh.param( "max_z", max_z, max_z );
+
+  params.leaf_size = static_cast<float>( leaf_size );
+  params.min_x = static_cast<float>( min_x );
+  params.max_x = static_cast<float>( max_x );
+  params.min_y = static_cast<float>( min_y );
+  params.max_y = static_cast<float>( max_y );
+  params.min_z = static_cast<float>( min_z );
+  params.max_z = static_cast<float>( max_z );
+
+  std::string outlier_filter;
+  priv_nh.param<std::string>( "outlier_filter", outlier_filter, "sor" );
+  if ( outlier_filter == "organized" )
+  {
+    params.outlier_filter = PclPipeline::OUTLIER_ORGANIZED;
+  }
+  else if ( outlier_filter == "none" )
+  {
+    params.outlier_filter = PclPipeline::OUTLIER_NONE;
+  }
+  else if ( outlier_filter != "sor" )
+  {
+    NODELET_WARN( "Unknown outlier_filter '%s' - Use 'sor'.", outlier_filter.c_str() );
+  }
+
+  priv_nh.param( "compare_outlier_filter", params.compare_outlier_filter, params.compare_outlier_filter );
+  if ( params.compare_outlier_filter && params.outlier_filter != PclPipeline::OUTLIER_ORGANIZED )
+  {
+    NODELET_WARN( "compare_outlier_filter needs outlier_filter 'organized' - Comparison disabled." );
+    params.compare_outlier_filter = false;
+  }
+
+  priv_nh.param( "sor_mean_k", params.sor_mean_k, params.sor_mean_k );
+  priv_nh.param( "sor_stddev", params.sor_stddev, params.sor_stddev );
+
+  priv_nh.param( "outlier_window"       , params.outlier_window       , params.outlier_window );
+  priv_nh.param( "outlier_stddev"       , params.outlier_stddev       , params.outlier_stddev );
+  priv_nh.param( "outlier_min_neighbors", params.outlier_min_neighbors, params.outlier_min_neighbors );
+  if ( params.outlier_window != 3 && params.outlier_window != 5 )
+  {
+    NODELET_WARN( "outlier_window must be 3 or 5 - Use 3." );
+    params.outlier_window = 3;
+  }
+
+  priv_nh.param( "plane_max_iterations", params.plane_max_iterations, params.plane_max_iterations );
+  priv_nh.param( "plane_distance"      , params.plane_distance      , params.plane_distance );
+  priv_nh.param( "plane_min_inliers"   , params.plane_min_inliers   , params.plane_min_inliers );
+  priv_nh.param( "plane_angular_threshold", params.plane_angular_threshold, params.plane_angular_threshold );
+
+  priv_nh.param( "plane_cache"          , params.plane_cache          , params.plane_cache );
+  priv_nh.param( "plane_cache_samples"  , params.plane_cache_samples  , params.plane_cache_samples );
+  priv_nh.param( "plane_cache_min_ratio", params.plane_cache_min_ratio, params.plane_cache_min_ratio );
+
+  priv_nh.param( "cluster_tolerance", params.cluster_tolerance, params.cluster_tolerance );
+  priv_nh.param( "cluster_min_size" , params.cluster_min_size , params.cluster_min_size );
+  priv_nh.param( "cluster_max_size" , params.cluster_max_size , params.cluster_max_size );
+
+  std::string cluster_mode;
+  priv_nh.param<std::string>( "cluster_mode", cluster_mode, "euclidean" );
+  if ( cluster_mode == "connected" )
+  {
+    params.cluster_mode = PclPipeline::CLUSTER_CONNECTED;
+  }
+  else if ( cluster_mode != "euclidean" )
+  {
+    NODELET_WARN( "Unknown cluster_mode '%s' - Use 'euclidean'.", cluster_mode.c_str() );
+  }
+
+  double cluster_depth_jump = params.cluster_depth_jump;
+  priv_nh.param( "cluster_depth_jump", cluster_depth_jump, cluster_depth_jump );
+  params.cluster_depth_jump = static_cast<float>( cluster_depth_jump );
+
+  priv_nh.param( "cluster_min_pixels", params.cluster_min_pixels, params.cluster_min_pixels );
+  priv_nh.param( "cluster_max_pixels", params.cluster_max_pixels, params.cluster_max_pixels );
+
+  double track_margin = params.track_margin;
+  priv_nh.param( "tracking"            , params.tracking            , params.tracking );
+  priv_nh.param( "track_margin"        , track_margin               , track_margin );
+  priv_nh.param( "full_search_interval", params.full_search_interval, params.full_search_interval );
+  params.track_margin = static_cast<float>( track_margin );
+  if ( params.tracking && params.cluster_mode == PclPipeline::CLUSTER_CONNECTED )
+    NODELET_WARN( "tracking needs cluster_mode 'euclidean' - Search every frame." );
+
+  pipeline_.setParameters( params );
+}
+
+
+/**
+ * @brief lookupTransform gets the transform from the cloud frame to the world frame.
+ * @param header const std_msgs::Header& header of the cloud
+ * @param transform Eigen::Affine3f& transform to the world frame
+ * @return bool false when the transform is not available
+ */
+bool PclExampleNodelet::lookupTransform( const std_msgs::Header& header, Eigen::Affine3f& transform )
+{
+  transform = Eigen::Affine3f::Identity();
+
+  if ( header.frame_id == world_frame_ )
+    return true;
+
+  tf::StampedTransform stransform;
+  try
+  {
+    listener_->waitForTransform( world_frame_, header.frame_id, header.stamp, ros::Duration( tf_timeout_ ) );
+    listener_->lookupTransform( world_frame_, header.frame_id, header.stamp, stransform );
+  }
+  catch ( tf::TransformException& ex )
+  {
+    NODELET_WARN_THROTTLE( 1.0, "%s", ex.what() );
+    return false;
+  }
+
+  Eigen::Affine3d transform_d;
+  tf::transformTFToEigen( stransform, transform_d );
+  transform = transform_d.cast<float>();
+
+  return true;
+}
+
+
+/**
+ * @brief fillInput transforms the cloud to the world frame while converting it
+ * into the pipeline input in a single pass. Invalid points are dropped here.
+ * @param msg const sensor_msgs::PointCloud2& cloud in the camera frame
+ * @return bool false when the transform is not available
+ */
+bool PclExampleNodelet::fillInput( const sensor_msgs::PointCloud2& msg, PclPipeline::Frame& frame )
+{
+  Eigen::Affine3f transform;
+  if ( not lookupTransform( msg.header, transform ) )
+    return false;
+
+  PclPipeline::Cloud& cloud = *frame.input;
+  cloud.points.resize( msg.width * msg.height );
+
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x( msg, "x" );
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y( msg, "y" );
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z( msg, "z" );
+
+  size_t n = 0;
+  for ( ; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z )
+  {
+    if ( not pcl_isfinite( *iter_x ) || not pcl_isfinite( *iter_y ) || not pcl_isfinite( *iter_z ) )
+      continue;
+
+    cloud.points[n].getVector3fMap() = transform * Eigen::Vector3f( *iter_x, *iter_y, *iter_z );
+    n++;
+  }
+
+  cloud.points.resize( n );
+  cloud.width    = n;
+  cloud.height   = 1;
+  cloud.is_dense = true;
+  pcl_conversions::toPCL( msg.header, cloud.header );
+  cloud.header.frame_id = world_frame_;
+  frame.stamp = msg.header.stamp.toNSec();
+
+  return true;
+}
+
+
+/**
+ * @brief fillOrganizedInput converts the cloud into the organized pipeline input,
+ * keeping the camera frame, the row/column structure and invalid points as NaN.
+ * @param msg const sensor_msgs::PointCloud2& organized cloud in the camera frame
+ * @return bool false when the cloud is not organized or the transform is not available
+ */
+bool PclExampleNodelet::fillOrganizedInput( const sensor_msgs::PointCloud2& msg, PclPipeline::Frame& frame )
+{
+  if ( msg.height < 2 )
+  {
+    NODELET_WARN_THROTTLE( 1.0, "plane_mode 'organized' and cluster_mode 'connected' need an organized cloud (height %u).",
+                           msg.height );
+    return false;
+  }
+
+  Eigen::Affine3f transform;
+  if ( not lookupTransform( msg.header, transform ) )
+    return false;
+
+  frame.sensor_transform = transform;
+
+  PclPipeline::Cloud& cloud = *frame.organized;
+  cloud.points.resize( msg.width * msg.height );
+
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x( msg, "x" );
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y( msg, "y" );
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z( msg, "z" );
+
+  for ( size_t i = 0; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z, ++i )
+  {
+    PclPipeline::Point& p = cloud.points[i];
+    p.x = *iter_x;
+    p.y = *iter_y;
+    p.z = *iter_z;
+  }
+
+  cloud.width    = msg.width;
+  cloud.height   = msg.height;
+  cloud.is_dense = false;
+  pcl_conversions::toPCL( msg.header, cloud.header );
+  frame.stamp = msg.header.stamp.toNSec();
+
+  return true;
+}
+
+
+/**
+ * @brief reportTiming prints the per-stage latencies every timing_period seconds.
+ */
+void PclExampleNodelet::reportTiming()
+{
+  ros::WallTime now = ros::WallTime::now();
+  if ( ( now - last_report_ ).toSec() < timing_period_ )
+    return;
+  last_report_ = now;
+
+  if ( pipelined_ )
+  {
+    // Stage threads report without the pipeline state of other stages
+    NODELET_INFO_STREAM( "PCL example pipelined stage timing, " << frame_pipeline_->completed() << " frames, "
+                         << frame_pipeline_->dropped() << " dropped:\n"
+                         << input_timer_.report() << filter_timer_.report()
+                         << segment_timer_.report() << publish_timer_.report() );
+    return;
+  }
+
+  NODELET_INFO_STREAM( "PCL example stage timing (" << ( pipeline_.getParameters().fused_front_end ? "fused" : "pcl" )
+                       << " front end):\n" << pipeline_.timer().report() );
+
+  if ( pipeline_.getParameters().plane_cache )
+  {
+    NODELET_INFO( "Plane cache: %zu hits, %zu RANSAC fits", pipeline_.planeCacheHits(), pipeline_.planeCacheMisses() );
+  }
+
+  if ( pipeline_.getParameters().compare_front_end )
+  {
+    NODELET_INFO( "Front end comparison: %zu / %zu voxels, max centroid deviation %g m",
+                  pipeline_.frontEndSize(), pipeline_.frontEndReferenceSize(), pipeline_.frontEndDeviation() );
+  }
+
+  if ( pipeline_.getParameters().compare_outlier_filter )
+  {
+    NODELET_INFO( "Outlier filter comparison: organized removed %zu, StatisticalOutlierRemoval removed %zu of %zu points",
+                  pipeline_.outlierRemoved(), pipeline_.outlierReferenceRemoved(), pipeline_.outlierInputSize() );
+  }
+}
+
+
+void PclExampleNodelet::cloudCallback( const sensor_msgs::PointCloud2::ConstPtr& msg )
+{
+  if ( pipelined_ )
+  {
+    // Conversion stage: fill a pooled frame and hand it to the filter thread
+    FramePipeline<PclPipeline::Frame>::FramePtr frame = frame_pipeline_->acquire();
+    if ( not frame )
+      return;
+
+    input_timer_.start();
+    frame->reset();
+    frame->received = std::chrono::steady_clock::now();
+
+    bool filled = pipeline_.usesOrganizedInput() ? fillOrganizedInput( *msg, *frame ) : fillInput( *msg, *frame );
+    if ( not filled )
+    {
+      frame_pipeline_->release( frame );
+      return;
+    }
+    input_timer_.lap( "input" );
+
+    frame_pipeline_->push( frame );
+    return;
+  }
+
+  ros::WallTime frame_start = ros::WallTime::now();
+  StageTimer& timer = pipeline_.timer();
+
+  timer.start();
+  PclPipeline::Frame& frame = pipeline_.frame();
+  bool filled = pipeline_.usesOrganizedInput() ? fillOrganizedInput( *msg, frame ) : fillInput( *msg, frame );
+  if ( not filled )
+    return;
+  timer.lap( "input" );
+
+  pipeline_.process();
+
+  if ( timing_ )
+  {
+    timer.add( "total", ( ros::WallTime::now() - frame_start ).toSec() * 1000.0 );
+    reportTiming();
+  }
+
+  publish( frame );
+}
+
+
+/**
+ * @brief publish sends the plane model, the "part" TF on the centroid of the
+ * largest cluster and the cluster itself, stamped with the cloud of the frame.
+ * @param frame const PclPipeline::Frame& processed frame
+ */
+void PclExampleNodelet::publish( const PclPipeline::Frame& frame )
+{
+  ros::Time stamp;
+  stamp.fromNSec( frame.stamp );
+
+  // Plane Model in the world frame, for other nodes to reuse
+  // Only the plane segmented on this frame, a frame without segmentation has none
+  const pcl::ModelCoefficients& plane = *frame.coefficients;
+  if ( frame.plane_valid && 0 < plane_pub_.getNumSubscribers() )
+  {
+    pcl_msgs::ModelCoefficients::Ptr plane_msg( new pcl_msgs::ModelCoefficients );
+    plane_msg->header.frame_id = world_frame_;
+    plane_msg->header.stamp    = stamp;
+    plane_msg->values          = plane.values;
+    plane_pub_.publish( plane_msg );
+  }
+
+  if ( not frame.found )
+  {
+    NODELET_WARN_THROTTLE( 1.0, "Could not extract an object cluster (plane: %zu points).", frame.inliers->indices.size() );
+    return;
+  }
+
+  const PclPipeline::Cloud& cluster = *frame.cluster;
+
+  NODELET_DEBUG( "%s - Plane: %zu points, Clusters: %zu, Largest cluster: %zu points.",
+                 pipelined_ ? "Pipelined" : ( pipeline_.lastFrameTracked() ? "Tracked" : "Full search" ),
+                 frame.inliers->indices.size(), frame.cluster_indices.size(), cluster.size() );
+
+  // Broadcast a TF on the centroid of the largest cluster
+  Eigen::Vector4f xyz_centroid;
+  pcl::compute3DCentroid( cluster, xyz_centroid );
+
+  tf::Transform part_transform;
+  part_transform.setOrigin( tf::Vector3( xyz_centroid[0], xyz_centroid[1], xyz_centroid[2] ) );
+  part_transform.setRotation( tf::Quaternion::getIdentity() );
+
+  broadcaster_->sendTransform( tf::StampedTransform( part_transform, stamp, world_frame_, "part" ) );
+
+  if ( 0 < object_pub_.getNumSubscribers() )
+  {
+    sensor_msgs::PointCloud2::Ptr pc2_cloud( new sensor_msgs::PointCloud2 );
+    pcl::toROSMsg( cluster, *pc2_cloud );
+    pc2_cloud->header.frame_id = world_frame_;
+    pc2_cloud->header.stamp    = stamp;
+    object_pub_.publish( pc2_cloud );
+  }
+}
+
+};
+
+// Register this plugin with pluginlib.
+//
+// parameters are: class type, base class type
+PLUGINLIB_EXPORT_CLASS( cis_camera::PclExampleNodelet, nodelet::Nodelet )
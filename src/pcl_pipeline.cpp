@@ -0,0 +1,754 @@
+/*
+ *  This example is based on "Building a Perception Pipleline" of ROS Industrial Training
+ *
+ *  * https://industrial-training-master.readthedocs.io/en/melodic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-master.readthedocs.io/en/kinetic/_source/session5/Building-a-Perception-Pipeline.html
+ *  * https://industrial-training-jp.readthedocs.io/ja/latest/_source/session5_JP/Building-a-Perception-Pipeline_JP.html
+ *
+ */
+
+#include "cis_camera/pcl_pipeline.h"
+
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/model_types.h>
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+
+namespace cis_camera
+{
+
+PclPipeline::Frame::Frame() :
+    input( new Cloud ),
+    organized( new Cloud ),
+    sensor_transform( Eigen::Affine3f::Identity() ),
+    stamp( 0 ),
+    cropped( new Cloud ),
+    sor( new Cloud ),
+    extracted( new Cloud ),
+    cluster( new Cloud ),
+    inliers( new pcl::PointIndices ),
+    coefficients( new pcl::ModelCoefficients ),
+    outliers_removed( false ),
+    plane_valid( false ),
+    plane_cached( false ),
+    found( false )
+{
+}
+
+
+void PclPipeline::Frame::reset()
+{
+  cluster->clear();
+  cluster_indices.clear();
+  inliers->indices.clear();
+  filtered.reset();
+  objects.reset();
+
+  outliers_removed = false;
+  plane_valid      = false;
+  plane_cached     = false;
+  found            = false;
+}
+
+
+PclPipeline::PclPipeline( const Parameters& params ) :
+    tree_( new pcl::search::KdTree<Point> ),
+    voxel_( new Cloud ),
+    reference_( new Cloud ),
+    normals_( new pcl::PointCloud<pcl::Normal> ),
+    tracked_( false ),
+    last_frame_tracked_( false ),
+    frames_since_search_( 0 ),
+    track_min_( Eigen::Vector3f::Zero() ),
+    track_max_( Eigen::Vector3f::Zero() ),
+    track_plane_( Eigen::Vector4f::Zero() ),
+    track_plane_valid_( false ),
+    front_end_deviation_( 0.0 ),
+    outlier_input_size_( 0 ),
+    outlier_removed_( 0 ),
+    outlier_reference_removed_( 0 )
+{
+  seg_.setOptimizeCoefficients( true );
+  seg_.setModelType( pcl::SACMODEL_PLANE );
+  seg_.setMethodType( pcl::SAC_RANSAC );
+
+  ec_.setSearchMethod( tree_ );
+
+  ne_.setNormalEstimationMethod( ne_.AVERAGE_3D_GRADIENT );
+  ne_.setDepthDependentSmoothing( true );
+
+  setParameters( params );
+}
+
+
+/**
+ * @brief setParameters applies new parameters to the persistent filters.
+ * @param params const Parameters& parameters to apply
+ */
+void PclPipeline::setParameters( const Parameters& params )
+{
+  if ( not pool_ || params.threads != params_.threads )
+    pool_.reset( new ThreadPool( std::max( 0, params.threads ) ) );
+
+  params_ = params;
+
+  voxel_filter_.setLeafSize( params.leaf_size, params.leaf_size, params.leaf_size );
+
+  voxel_crop_filter_.setLeafSize( params.leaf_size );
+  voxel_crop_filter_.setCrop( Eigen::Vector3f( params.min_x, params.min_y, params.min_z ),
+                              Eigen::Vector3f( params.max_x, params.max_y, params.max_z ) );
+
+  // One crop box replaces the three pass through filters for x, y and z
+  crop_filter_.setMin( Eigen::Vector4f( params.min_x, params.min_y, params.min_z, 1.0f ) );
+  crop_filter_.setMax( Eigen::Vector4f( params.max_x, params.max_y, params.max_z, 1.0f ) );
+
+  sor_filter_.setMeanK( params.sor_mean_k );
+  sor_filter_.setStddevMulThresh( params.sor_stddev );
+
+  depth_outlier_.setWindowSize( params.outlier_window );
+  depth_outlier_.setStddevMulThresh( params.outlier_stddev );
+  depth_outlier_.setMinNeighbors( params.outlier_min_neighbors );
+
+  seg_.setMaxIterations( params.plane_max_iterations );
+  seg_.setDistanceThreshold( params.plane_distance );
+
+  plane_cache_.setDistanceThreshold( params.plane_distance );
+  plane_cache_.setSampleSize( params.plane_cache_samples );
+  plane_cache_.setMinInlierRatio( params.plane_cache_min_ratio );
+  plane_cache_.reset();
+
+  ec_.setClusterTolerance( params.cluster_tolerance );
+  ec_.setMinClusterSize( params.cluster_min_size );
+  ec_.setMaxClusterSize( params.cluster_max_size );
+
+  ne_.setMaxDepthChangeFactor( params.normal_depth_change );
+  ne_.setNormalSmoothingSize( params.normal_smoothing );
+
+  mps_.setMinInliers( params.plane_min_inliers );
+  mps_.setAngularThreshold( params.plane_angular_threshold * M_PI / 180.0 );
+  mps_.setDistanceThreshold( params.plane_distance );
+
+  cc_.setDepthJump( params.cluster_depth_jump );
+  cc_.setMinClusterSize( params.cluster_min_pixels );
+  cc_.setMaxClusterSize( params.cluster_max_pixels );
+
+  tracked_ = false;
+}
+
+
+/**
+ * @brief process extracts the largest object cluster from input().
+ * While an object is tracked only the box around it is processed, a full
+ * search runs on track loss and every full_search_interval frames.
+ * With OUTLIER_ORGANIZED the organized input is filtered first, for both searches.
+ * @return bool true when a cluster was found, the cluster is then in largestCluster()
+ */
+bool PclPipeline::process()
+{
+  frame_.reset();
+  last_frame_tracked_ = false;
+
+  if ( usesTracking() && tracked_ && frames_since_search_ < params_.full_search_interval )
+  {
+    frames_since_search_++;
+
+    if ( processTracked() )
+    {
+      last_frame_tracked_ = true;
+      frame_.found = true;
+      updateTrack();
+      return true;
+    }
+
+    // Track lost, search the whole scene on this frame
+    frame_.cluster->clear();
+    frame_.cluster_indices.clear();
+    frame_.inliers->indices.clear();
+  }
+
+  bool found = processFull();
+
+  tracked_ = found;
+  frames_since_search_ = 0;
+  if ( found )
+  {
+    updateTrack();
+
+    // The tracked frames remove this plane by distance
+    track_plane_valid_ = frame_.plane_valid;
+    if ( frame_.plane_valid )
+    {
+      const std::vector<float>& c = frame_.coefficients->values;
+      track_plane_ = Eigen::Vector4f( c[0], c[1], c[2], c[3] );
+    }
+  }
+
+  return found;
+}
+
+
+/**
+ * @brief processTracked looks for the object only inside the previous cluster bounds
+ * grown by track_margin. The plane of the last full search is removed by distance instead of being
+ * segmented again, and the euclidean clustering runs on the few remaining voxels.
+ * @return bool true when a cluster of at least cluster_min_size voxels was found
+ */
+bool PclPipeline::processTracked()
+{
+  const Eigen::Vector3f crop_min( params_.min_x, params_.min_y, params_.min_z );
+  const Eigen::Vector3f crop_max( params_.max_x, params_.max_y, params_.max_z );
+  const Eigen::Vector3f margin = Eigen::Vector3f::Constant( params_.track_margin );
+
+  Eigen::Vector3f roi_min = ( track_min_ - margin ).cwiseMax( crop_min );
+  Eigen::Vector3f roi_max = ( track_max_ + margin ).cwiseMin( crop_max );
+
+  if ( ( roi_max.array() < roi_min.array() ).any() )
+    return false;
+
+  if ( usesOrganizedInput() )
+  {
+    if ( not organizedValid( frame_ ) )
+      return false;
+
+    filterOrganizedOutliers( frame_, timer_ );
+    extractWorldPoints( frame_, false, timer_ );
+  }
+
+  // Voxel Grid restricted to the ROI
+  voxel_crop_filter_.setCrop( roi_min, roi_max );
+  voxel_crop_filter_.filter( *frame_.input, *frame_.cropped, pool_.get() );
+  voxel_crop_filter_.setCrop( crop_min, crop_max );
+  timer_.lap( "track_crop" );
+
+  // Previous Plane
+  const Eigen::Vector4f& plane = track_plane_;
+
+  const Cloud& cropped = *frame_.cropped;
+  Cloud& objects = *frame_.extracted;
+  objects.points.resize( cropped.points.size() );
+
+  size_t n = 0;
+  for ( size_t i = 0; i < cropped.points.size(); i++ )
+  {
+    const Point& p = cropped.points[i];
+    if ( track_plane_valid_ && fabs( plane.head<3>().dot( p.getVector3fMap() ) + plane[3] ) <= params_.plane_distance )
+      continue;
+    objects.points[n++] = p;
+  }
+
+  objects.points.resize( n );
+  objects.width    = n;
+  objects.height   = 1;
+  objects.is_dense = true;
+  timer_.lap( "track_plane" );
+
+  if ( objects.empty() )
+    return false;
+
+  // Euclidean Cluster Extraction in the ROI
+  tree_->setInputCloud( frame_.extracted );
+  ec_.setInputCloud( frame_.extracted );
+  ec_.extract( frame_.cluster_indices );
+  timer_.lap( "track_cluster" );
+
+  if ( frame_.cluster_indices.empty() )
+    return false;
+
+  const std::vector<int>& indices = frame_.cluster_indices[0].indices;
+
+  Cloud& cluster = *frame_.cluster;
+  cluster.points.resize( indices.size() );
+  for ( size_t i = 0; i < indices.size(); i++ )
+    cluster.points[i] = objects.points[ indices[i] ];
+
+  cluster.width    = cluster.points.size();
+  cluster.height   = 1;
+  cluster.is_dense = true;
+
+  return true;
+}
+
+
+/**
+ * @brief segmentPlane finds the dominant plane of cloud into the frame inliers and coefficients.
+ * With plane_cache the previous plane is checked and refined first, RANSAC only
+ * runs when it no longer fits.
+ * @param frame Frame& frame to store the plane in
+ * @param cloud const Cloud::Ptr& cloud to segment
+ */
+void PclPipeline::segmentPlane( Frame& frame, const Cloud::Ptr& cloud )
+{
+  if ( params_.plane_cache && plane_cache_.check( *cloud, *frame.coefficients, *frame.inliers ) )
+  {
+    frame.plane_cached = true;
+    frame.plane_valid  = true;
+    return;
+  }
+
+  seg_.setInputCloud( cloud );
+  seg_.segment( *frame.inliers, *frame.coefficients );
+  frame.plane_valid = not frame.inliers->indices.empty() && frame.coefficients->values.size() == 4;
+
+  if ( params_.plane_cache )
+    plane_cache_.store( *cloud, *frame.coefficients, *frame.inliers );
+}
+
+
+/**
+ * @brief updateTrack keeps the bounds of the current cluster for the next frame.
+ */
+void PclPipeline::updateTrack()
+{
+  track_min_ = Eigen::Vector3f::Constant(  std::numeric_limits<float>::max() );
+  track_max_ = Eigen::Vector3f::Constant( -std::numeric_limits<float>::max() );
+
+  const Cloud& cluster = *frame_.cluster;
+  for ( size_t i = 0; i < cluster.points.size(); i++ )
+  {
+    track_min_ = track_min_.cwiseMin( cluster.points[i].getVector3fMap() );
+    track_max_ = track_max_.cwiseMax( cluster.points[i].getVector3fMap() );
+  }
+}
+
+
+/**
+ * @brief processFull searches the object in the whole crop box.
+ * @return bool true when a cluster was found
+ */
+bool PclPipeline::processFull()
+{
+  if ( params_.cluster_mode == CLUSTER_CONNECTED )
+  {
+    if ( not organizedValid( frame_ ) )
+      return false;
+
+    filterOrganizedOutliers( frame_, timer_ );
+    return processConnected();
+  }
+
+  return filterStage( frame_, timer_ ) && segmentStage( frame_, timer_ ) && clusterStage( frame_, timer_ );
+}
+
+
+/**
+ * @brief filterStage prepares the points of a full search: organized outlier
+ * filter and plane removal with organized input, then voxel grid, crop box and
+ * statistical outlier removal.
+ * @param frame Frame& frame with its input filled in
+ * @param timer StageTimer& timer of the calling thread
+ * @return bool false when no point is left
+ */
+bool PclPipeline::filterStage( Frame& frame, StageTimer& timer )
+{
+  if ( usesOrganizedInput() )
+  {
+    if ( not organizedValid( frame ) )
+      return false;
+
+    filterOrganizedOutliers( frame, timer );
+
+    // Organized Plane Removal, the input gets the remaining points
+    if ( params_.plane_mode == PLANE_ORGANIZED )
+      segmentOrganizedPlane( frame, timer );
+    extractWorldPoints( frame, params_.plane_mode == PLANE_ORGANIZED, timer );
+  }
+
+  // Voxel Grid and Crop Box
+  if ( params_.fused_front_end )
+    voxel_crop_filter_.filter( *frame.input, *frame.cropped, pool_.get() );
+  else
+    filterPcl( frame, *frame.cropped );
+  timer.lap( "voxel_crop" );
+
+  // The reference front end is timed on its own and excluded from the next stage
+  if ( params_.compare_front_end )
+  {
+    timer.start();
+    compareFrontEnd( frame, timer );
+    timer.start();
+  }
+
+  // Statistical Outlier Removal, OUTLIER_ORGANIZED already filtered the organized input
+  frame.filtered = frame.cropped;
+  if ( params_.outlier_filter == OUTLIER_SOR )
+  {
+    if ( not frame.cropped->empty() )
+    {
+      sor_filter_.setInputCloud( frame.cropped );
+      sor_filter_.filter( *frame.sor );
+      frame.filtered = frame.sor;
+    }
+    timer.lap( "outlier" );
+  }
+
+  return not frame.filtered->empty();
+}
+
+
+/**
+ * @brief segmentStage removes the RANSAC plane from the filtered points.
+ * With PLANE_ORGANIZED the plane is already gone and the points pass through.
+ * @param frame Frame& frame after filterStage()
+ * @param timer StageTimer& timer of the calling thread
+ * @return bool false when no point is left
+ */
+bool PclPipeline::segmentStage( Frame& frame, StageTimer& timer )
+{
+  frame.objects = frame.filtered;
+  if ( params_.plane_mode != PLANE_SAC )
+    return frame.objects && not frame.objects->empty();
+
+  segmentPlane( frame, frame.filtered );
+  timer.lap( "plane" );
+
+  // Remove the planar inliers, extract the rest
+  extract_.setInputCloud( frame.filtered );
+  extract_.setIndices( frame.inliers );
+  extract_.setNegative( true );
+  extract_.filter( *frame.extracted );
+  timer.lap( "extract" );
+
+  frame.objects = frame.extracted;
+
+  return not frame.objects->empty();
+}
+
+
+/**
+ * @brief clusterStage extracts the largest euclidean cluster of the object points.
+ * @param frame Frame& frame after segmentStage()
+ * @param timer StageTimer& timer of the calling thread
+ * @return bool true when a cluster was found, it is then in frame.cluster
+ */
+bool PclPipeline::clusterStage( Frame& frame, StageTimer& timer )
+{
+  const Cloud::Ptr& objects = frame.objects;
+
+  tree_->setInputCloud( objects );
+  ec_.setInputCloud( objects );
+  ec_.extract( frame.cluster_indices );
+  timer.lap( "cluster" );
+
+  if ( frame.cluster_indices.empty() )
+    return false;
+
+  // Clusters are sorted by size, the first one is the largest
+  const std::vector<int>& indices = frame.cluster_indices[0].indices;
+
+  Cloud& cluster = *frame.cluster;
+  cluster.points.resize( indices.size() );
+  for ( size_t i = 0; i < indices.size(); i++ )
+    cluster.points[i] = objects->points[ indices[i] ];
+
+  cluster.width    = cluster.points.size();
+  cluster.height   = 1;
+  cluster.is_dense = true;
+
+  frame.found = true;
+
+  return true;
+}
+
+
+/**
+ * @brief processConnected clusters the organized input by connected components.
+ * The plane comes from PLANE_ORGANIZED, or from RANSAC on the voxelized cloud
+ * with PLANE_SAC and is then removed by its distance. Pixels outside the crop
+ * box are dropped, and the points of the largest component, unvoxelized, are the cluster.
+ * @return bool true when a cluster was found
+ */
+bool PclPipeline::processConnected()
+{
+  const Cloud& organized = *frame_.organized;
+  const Eigen::Affine3f& sensor_transform = frame_.sensor_transform;
+
+  // Plane
+  bool sac_plane = false;
+  if ( params_.plane_mode == PLANE_ORGANIZED )
+  {
+    segmentOrganizedPlane( frame_, timer_ );
+  }
+  else
+  {
+    extractWorldPoints( frame_, false, timer_ );
+    voxel_crop_filter_.filter( *frame_.input, *frame_.cropped, pool_.get() );
+    timer_.lap( "voxel_crop" );
+
+    if ( not frame_.cropped->empty() )
+    {
+      segmentPlane( frame_, frame_.cropped );
+      sac_plane = frame_.plane_valid;
+    }
+    timer_.lap( "plane" );
+  }
+
+  // Valid Pixels: finite, off the plane and inside the crop box
+  const Eigen::Vector3f crop_min( params_.min_x, params_.min_y, params_.min_z );
+  const Eigen::Vector3f crop_max( params_.max_x, params_.max_y, params_.max_z );
+
+  Eigen::Vector4f plane( 0.0f, 0.0f, 0.0f, 0.0f );
+  if ( sac_plane )
+  {
+    const std::vector<float>& c = frame_.coefficients->values;
+    plane = Eigen::Vector4f( c[0], c[1], c[2], c[3] );
+  }
+
+  const size_t pixels = organized.points.size();
+  valid_mask_.assign( pixels, 0 );
+
+  for ( size_t i = 0; i < pixels; i++ )
+  {
+    const Point& p = organized.points[i];
+    if ( not pcl_isfinite( p.x ) || not pcl_isfinite( p.y ) || not pcl_isfinite( p.z ) )
+      continue;
+
+    if ( params_.plane_mode == PLANE_ORGANIZED && plane_mask_[i] )
+      continue;
+
+    Eigen::Vector3f w = sensor_transform * p.getVector3fMap();
+
+    if ( ( w.array() < crop_min.array() ).any() || ( crop_max.array() < w.array() ).any() )
+      continue;
+
+    if ( sac_plane && fabs( plane.head<3>().dot( w ) + plane[3] ) <= params_.plane_distance )
+      continue;
+
+    valid_mask_[i] = 1;
+  }
+  timer_.lap( "mask" );
+
+  // Connected Components on the Depth Image
+  cc_.segment( organized, valid_mask_, frame_.cluster_indices, pool_.get() );
+  timer_.lap( "cluster" );
+
+  if ( frame_.cluster_indices.empty() )
+    return false;
+
+  const std::vector<int>& indices = frame_.cluster_indices[0].indices;
+
+  Cloud& cluster = *frame_.cluster;
+  cluster.points.resize( indices.size() );
+  for ( size_t i = 0; i < indices.size(); i++ )
+    cluster.points[i].getVector3fMap() = sensor_transform * organized.points[ indices[i] ].getVector3fMap();
+
+  cluster.width    = cluster.points.size();
+  cluster.height   = 1;
+  cluster.is_dense = true;
+
+  frame_.found = true;
+
+  return true;
+}
+
+
+/**
+ * @brief organizedValid checks that the organized input of frame is an image.
+ */
+bool PclPipeline::organizedValid( const Frame& frame ) const
+{
+  const Cloud& organized = *frame.organized;
+  return 2 <= organized.height && organized.points.size() == organized.width * organized.height;
+}
+
+
+/**
+ * @brief filterOrganizedOutliers runs DepthOutlierFilter on the organized input
+ * once per frame with OUTLIER_ORGANIZED, and the comparison with compare_outlier_filter.
+ * @param frame Frame& frame with the organized input filled in
+ * @param timer StageTimer& timer of the calling thread
+ */
+void PclPipeline::filterOrganizedOutliers( Frame& frame, StageTimer& timer )
+{
+  if ( params_.outlier_filter != OUTLIER_ORGANIZED || frame.outliers_removed )
+    return;
+
+  // The reference filter is timed on its own and sees the unfiltered cloud
+  if ( params_.compare_outlier_filter )
+  {
+    timer.start();
+    compareOutlierFilter( frame, timer );
+    timer.start();
+  }
+
+  outlier_removed_ = depth_outlier_.filter( *frame.organized, pool_.get() );
+  frame.outliers_removed = true;
+  timer.lap( "outlier" );
+}
+
+
+/**
+ * @brief segmentOrganizedPlane finds the dominant plane of the organized input and
+ * marks its pixels in plane_mask_. Normals come from integral images and the
+ * planes from one region growing pass of OrganizedMultiPlaneSegmentation, so the
+ * time is linear in pixels. The plane coefficients are converted to the world frame.
+ * @param frame Frame& frame with the organized input filled in
+ * @param timer StageTimer& timer of the calling thread
+ */
+void PclPipeline::segmentOrganizedPlane( Frame& frame, StageTimer& timer )
+{
+  const Cloud& organized = *frame.organized;
+
+  // Integral Image Normals
+  ne_.setInputCloud( frame.organized );
+  ne_.compute( *normals_ );
+  timer.lap( "normals" );
+
+  // Organized Multi-Plane Segmentation, the largest plane is the dominant one
+  plane_coefficients_.clear();
+  plane_inliers_.clear();
+
+  mps_.setInputNormals( normals_ );
+  mps_.setInputCloud( frame.organized );
+  mps_.segment( plane_coefficients_, plane_inliers_ );
+
+  size_t dominant = plane_inliers_.size();
+  for ( size_t i = 0; i < plane_inliers_.size(); i++ )
+  {
+    if ( dominant == plane_inliers_.size() ||
+         plane_inliers_[ dominant ].indices.size() < plane_inliers_[i].indices.size() )
+      dominant = i;
+  }
+
+  plane_mask_.assign( organized.points.size(), 0 );
+  frame.coefficients->values.assign( 4, 0.0f );
+
+  if ( dominant < plane_inliers_.size() )
+  {
+    frame.inliers->indices.swap( plane_inliers_[ dominant ].indices );
+    for ( size_t i = 0; i < frame.inliers->indices.size(); i++ )
+      plane_mask_[ frame.inliers->indices[i] ] = 1;
+
+    // n_w = R n_s, d_w = d_s - n_w . t
+    const Eigen::Affine3f& sensor_transform = frame.sensor_transform;
+    const std::vector<float>& c = plane_coefficients_[ dominant ].values;
+    Eigen::Vector3f normal = sensor_transform.linear() * Eigen::Vector3f( c[0], c[1], c[2] );
+    float d = c[3] - normal.dot( sensor_transform.translation() );
+
+    frame.coefficients->values[0] = normal[0];
+    frame.coefficients->values[1] = normal[1];
+    frame.coefficients->values[2] = normal[2];
+    frame.coefficients->values[3] = d;
+    frame.plane_valid = true;
+  }
+  timer.lap( "plane" );
+}
+
+
+/**
+ * @brief extractWorldPoints fills the frame input with the valid points of the
+ * organized input in the world frame.
+ * @param frame Frame& frame with the organized input filled in
+ * @param skip_plane bool true to leave out the pixels in plane_mask_
+ * @param timer StageTimer& timer of the calling thread
+ */
+void PclPipeline::extractWorldPoints( Frame& frame, bool skip_plane, StageTimer& timer )
+{
+  const Cloud& organized = *frame.organized;
+  Cloud& input = *frame.input;
+  input.points.resize( organized.points.size() );
+
+  size_t n = 0;
+  for ( size_t i = 0; i < organized.points.size(); i++ )
+  {
+    const Point& p = organized.points[i];
+    if ( ( skip_plane && plane_mask_[i] ) ||
+         not pcl_isfinite( p.x ) || not pcl_isfinite( p.y ) || not pcl_isfinite( p.z ) )
+      continue;
+
+    input.points[n++].getVector3fMap() = frame.sensor_transform * p.getVector3fMap();
+  }
+
+  input.points.resize( n );
+  input.width    = n;
+  input.height   = 1;
+  input.is_dense = true;
+  input.header   = organized.header;
+  timer.lap( "extract" );
+}
+
+
+/**
+ * @brief filterPcl is the PCL front end: VoxelGrid followed by CropBox.
+ * @param frame const Frame& frame with the input filled in
+ * @param output Cloud& cropped voxel centroids
+ */
+void PclPipeline::filterPcl( const Frame& frame, Cloud& output )
+{
+  voxel_filter_.setInputCloud( frame.input );
+  voxel_filter_.filter( *voxel_ );
+
+  crop_filter_.setInputCloud( voxel_ );
+  crop_filter_.filter( output );
+}
+
+
+/**
+ * @brief compareFrontEnd runs the front end which is not selected on the same input,
+ * times it as "voxel_crop_ref" and records the largest centroid deviation.
+ * Both front ends emit the centroids in voxel index order, so they compare point by point.
+ */
+void PclPipeline::compareFrontEnd( Frame& frame, StageTimer& timer )
+{
+  if ( params_.fused_front_end )
+    filterPcl( frame, *reference_ );
+  else
+    voxel_crop_filter_.filter( *frame.input, *reference_, pool_.get() );
+  timer.lap( "voxel_crop_ref" );
+
+  const Cloud& cropped = *frame.cropped;
+  if ( reference_->size() != cropped.size() )
+  {
+    front_end_deviation_ = std::numeric_limits<double>::infinity();
+    return;
+  }
+
+  double deviation = 0.0;
+  for ( size_t i = 0; i < cropped.size(); i++ )
+  {
+    Eigen::Vector3f d = cropped.points[i].getVector3fMap() - reference_->points[i].getVector3fMap();
+    deviation = std::max( deviation, static_cast<double>( d.norm() ) );
+  }
+  front_end_deviation_ = deviation;
+}
+
+
+/**
+ * @brief compareOutlierFilter runs StatisticalOutlierRemoval on the finite points of
+ * the unfiltered organized input, the cloud DepthOutlierFilter gets next, and times
+ * it as "outlier_ref". Only the numbers of removed points are kept.
+ */
+void PclPipeline::compareOutlierFilter( Frame& frame, StageTimer& timer )
+{
+  const Cloud& organized = *frame.organized;
+  Cloud& reference = *reference_;
+  reference.points.resize( organized.points.size() );
+
+  size_t n = 0;
+  for ( size_t i = 0; i < organized.points.size(); i++ )
+  {
+    const Point& p = organized.points[i];
+    if ( pcl_isfinite( p.x ) && pcl_isfinite( p.y ) && pcl_isfinite( p.z ) )
+      reference.points[n++] = p;
+  }
+
+  reference.points.resize( n );
+  reference.width    = n;
+  reference.height   = 1;
+  reference.is_dense = true;
+
+  outlier_input_size_        = n;
+  outlier_reference_removed_ = 0;
+
+  if ( n > 0 )
+  {
+    sor_filter_.setInputCloud( reference_ );
+    sor_filter_.filter( *frame.sor );
+    outlier_reference_removed_ = n - frame.sor->size();
+  }
+  timer.lap( "outlier_ref" );
+}
+
+};
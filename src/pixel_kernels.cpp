@@ -0,0 +1,191 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include "cis_camera/pixel_kernels.h"
+
+#include <atomic>
+
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+
+namespace cis_camera
+{
+
+// Active kernels, NULL until the first kernel call or selectPixelKernels()
+static std::atomic<const PixelKernels*> active_kernels( NULL );
+
+
+const PixelKernels& scalarPixelKernels()
+{
+  static const PixelKernels kernels =
+  {
+    CPU_SCALAR,
+    correctDepthScalar,
+    convertUYVYToBGR8Scalar,
+    binUYVYToBGR8Scalar,
+    computeTileSADScalar,
+    NULL
+  };
+  
+  return kernels;
+}
+
+
+bool cpuSupports( CpuLevel level )
+{
+  switch ( level )
+  {
+    case CPU_SCALAR:
+      return true;
+#if defined(__x86_64__) || defined(__i386__)
+    case CPU_SSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "sse2" );
+    case CPU_AVX2:
+      // Also checks that the OS saves the YMM registers (XGETBV)
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "avx2" );
+#endif
+#if defined(__aarch64__)
+    case CPU_NEON:
+      return true;  // Advanced SIMD is mandatory on AArch64
+#elif defined(__arm__) && defined(__linux__)
+    case CPU_NEON:
+      return ( getauxval( AT_HWCAP ) & HWCAP_NEON ) != 0;
+#endif
+    default:
+      return false;
+  }
+}
+
+
+const PixelKernels* pixelKernels( CpuLevel level )
+{
+  // Check the CPU first, the table getters are compiled for their instruction set
+  if ( not cpuSupports( level ) )
+    return NULL;
+  
+  const PixelKernels* kernels = NULL;
+  
+  switch ( level )
+  {
+    case CPU_SCALAR: kernels = &scalarPixelKernels(); break;
+    case CPU_SSE2:   kernels = sse2PixelKernels();    break;
+    case CPU_AVX2:   kernels = avx2PixelKernels();    break;
+    case CPU_NEON:   kernels = neonPixelKernels();    break;
+    default:         break;
+  }
+  
+  return kernels;
+}
+
+
+CpuLevel detectCpuLevel()
+{
+  for ( int level = CPU_LEVELS - 1; CPU_SCALAR < level; level-- )
+  {
+    if ( pixelKernels( static_cast<CpuLevel>( level ) ) != NULL )
+      return static_cast<CpuLevel>( level );
+  }
+  
+  return CPU_SCALAR;
+}
+
+
+const PixelKernels& pixelKernels()
+{
+  const PixelKernels* kernels = active_kernels.load( std::memory_order_acquire );
+  
+  if ( kernels == NULL )
+  {
+    // Concurrent first calls detect the same level, so racing stores are harmless
+    kernels = pixelKernels( detectCpuLevel() );
+    active_kernels.store( kernels, std::memory_order_release );
+  }
+  
+  return *kernels;
+}
+
+
+CpuLevel selectPixelKernels( CpuLevel level )
+{
+  const PixelKernels* kernels = pixelKernels( level );
+  
+  if ( kernels == NULL )
+    kernels = pixelKernels( detectCpuLevel() );
+  
+  active_kernels.store( kernels, std::memory_order_release );
+  
+  return kernels->level;
+}
+
+
+const char* cpuLevelName( CpuLevel level )
+{
+  switch ( level )
+  {
+    case CPU_SCALAR: return "scalar";
+    case CPU_SSE2:   return "sse2";
+    case CPU_AVX2:   return "avx2";
+    case CPU_NEON:   return "neon";
+    default:         return "unknown";
+  }
+}
+
+
+bool parseCpuLevel( const std::string& name, CpuLevel& level )
+{
+  if ( name == "auto" || name.empty() )
+  {
+    level = detectCpuLevel();
+    return true;
+  }
+  
+  for ( int i = CPU_SCALAR; i < CPU_LEVELS; i++ )
+  {
+    if ( name == cpuLevelName( static_cast<CpuLevel>( i ) ) )
+    {
+      level = static_cast<CpuLevel>( i );
+      return true;
+    }
+  }
+  
+  return false;
+}
+
+};
@@ -0,0 +1,384 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include "cis_camera/pixel_kernels.h"
+#include "cis_camera/frame_kernels.h"
+
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+namespace cis_camera
+{
+
+#ifdef __AVX2__
+
+// This file is compiled with -mavx2 and only runs after the CPU check of pixelKernels().
+// It must not instantiate templates or inline functions which other files use as well
+// (std::min, std::vector, ...): the linker may keep the AVX2 copy for the whole binary.
+// The binning template below is static, so every copy stays here.
+
+/**
+ * @brief correctDepthAVX2 is the AVX2 version of correctDepth, 8 samples per step.
+ */
+static void correctDepthAVX2( const uint16_t* src, const float* inv_norm, int count,
+                              double scale, double offset, uint16_t* dst )
+{
+  const __m256d scale4  = _mm256_set1_pd( scale );
+  const __m256d offset4 = _mm256_set1_pd( offset );
+  const __m256d half    = _mm256_set1_pd( 0.5 );
+  const __m256d lower   = _mm256_setzero_pd();
+  const __m256d upper   = _mm256_set1_pd( 65535.0 );
+  
+  int i = 0;
+  for ( ; i + 8 <= count; i += 8 )
+  {
+    const __m256i d   = _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) );
+    const __m256  inv = _mm256_loadu_ps( inv_norm + i );
+    
+    // Same operations in double precision as correctDepthScalar, so the results are identical
+    __m256d lo = _mm256_cvtepi32_pd( _mm256_castsi256_si128( d ) );
+    __m256d hi = _mm256_cvtepi32_pd( _mm256_extracti128_si256( d, 1 ) );
+    lo = _mm256_mul_pd( _mm256_add_pd( _mm256_mul_pd( lo, scale4 ), offset4 ),
+                        _mm256_cvtps_pd( _mm256_castps256_ps128( inv ) ) );
+    hi = _mm256_mul_pd( _mm256_add_pd( _mm256_mul_pd( hi, scale4 ), offset4 ),
+                        _mm256_cvtps_pd( _mm256_extractf128_ps( inv, 1 ) ) );
+    lo = _mm256_min_pd( _mm256_max_pd( _mm256_floor_pd( _mm256_add_pd( lo, half ) ), lower ), upper );
+    hi = _mm256_min_pd( _mm256_max_pd( _mm256_floor_pd( _mm256_add_pd( hi, half ) ), lower ), upper );
+    
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ),
+                      _mm_packus_epi32( _mm256_cvttpd_epi32( lo ), _mm256_cvttpd_epi32( hi ) ) );
+  }
+  
+  correctDepthScalar( src + i, inv_norm + i, count - i, scale, offset, dst + i );
+}
+
+
+/**
+ * @brief ChromaAVX2 holds the chroma terms of yuvToBGR8 for 8 pixels.
+ */
+struct ChromaAVX2
+{
+  __m256 b;
+  __m256 g;
+  __m256 r;
+};
+
+
+/**
+ * @brief chromaAVX2 computes the chroma terms of yuvToBGR8 from U and V.
+ */
+static inline void chromaAVX2( __m256 u, __m256 v, ChromaAVX2& c )
+{
+  const __m256 center = _mm256_set1_ps( 128.0f );
+  
+  u = _mm256_sub_ps( u, center );
+  v = _mm256_sub_ps( v, center );
+  
+  c.r = _mm256_mul_ps( _mm256_set1_ps( 1.574800f ), v );
+  c.g = _mm256_sub_ps( _mm256_mul_ps( _mm256_set1_ps( 0.187324f ), u ),
+                       _mm256_mul_ps( _mm256_set1_ps( 0.468124f ), v ) );
+  c.b = _mm256_mul_ps( _mm256_set1_ps( 1.855600f ), u );
+}
+
+
+/**
+ * @brief clampToByteAVX2 limits to 0-255 and truncates like clampToByte.
+ */
+static inline __m256i clampToByteAVX2( __m256 x )
+{
+  return _mm256_cvttps_epi32( _mm256_min_ps( _mm256_max_ps( x, _mm256_setzero_ps() ),
+                                             _mm256_set1_ps( 255.0f ) ) );
+}
+
+
+/**
+ * @brief packBGR8AVX2 converts the luma of 8 pixels to BGR8, one pixel per 32 bit lane (B G R 0 in memory).
+ */
+static inline __m256i packBGR8AVX2( __m256 y, const ChromaAVX2& c, const ChromaAVX2& gains )
+{
+  const __m256i b = clampToByteAVX2( _mm256_mul_ps( _mm256_add_ps( y, c.b ), gains.b ) );
+  const __m256i g = clampToByteAVX2( _mm256_mul_ps( _mm256_add_ps( y, c.g ), gains.g ) );
+  const __m256i r = clampToByteAVX2( _mm256_mul_ps( _mm256_add_ps( y, c.r ), gains.r ) );
+  
+  return _mm256_or_si256( b, _mm256_or_si256( _mm256_slli_epi32( g, 8 ), _mm256_slli_epi32( r, 16 ) ) );
+}
+
+
+/**
+ * @brief convertUYVYToBGR8AVX2 is the AVX2 version of convertUYVYToBGR8, 16 pixels per step.
+ */
+static void convertUYVYToBGR8AVX2( const uint16_t* src, int src_stride, int width, int height,
+                                   const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  const int     pairs = width / 2;
+  const __m256i mask  = _mm256_set1_epi32( 0xFF );
+  
+  ChromaAVX2 gains8;
+  gains8.b = _mm256_set1_ps( gains.b );
+  gains8.g = _mm256_set1_ps( gains.g );
+  gains8.r = _mm256_set1_ps( gains.r );
+  
+  for ( int v = 0; v < height; v++ )
+  {
+    const uint8_t* uyvy = reinterpret_cast<const uint8_t*>( src + v * src_stride );
+    uint8_t*       bgr  = dst + v * dst_step;
+    
+    int p = 0;
+    for ( ; p + 8 <= pairs; p += 8, uyvy += 32, bgr += 48 )
+    {
+      // One U Y0 V Y1 pair per 32 bit lane
+      const __m256i w = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( uyvy ) );
+      
+      const __m256 u0 = _mm256_cvtepi32_ps( _mm256_and_si256( w, mask ) );
+      const __m256 y0 = _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( w, 8 ), mask ) );
+      const __m256 v0 = _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( w, 16 ), mask ) );
+      const __m256 y1 = _mm256_cvtepi32_ps( _mm256_srli_epi32( w, 24 ) );
+      
+      ChromaAVX2 c;
+      chromaAVX2( u0, v0, c );
+      
+      alignas(32) uint32_t even[8];
+      alignas(32) uint32_t odd[8];
+      _mm256_store_si256( reinterpret_cast<__m256i*>( even ), packBGR8AVX2( y0, c, gains8 ) );
+      _mm256_store_si256( reinterpret_cast<__m256i*>( odd  ), packBGR8AVX2( y1, c, gains8 ) );
+      
+      for ( int k = 0; k < 8; k++ )
+      {
+        memcpy( bgr + 6 * k    , &(even[k]), 3 );
+        memcpy( bgr + 6 * k + 3, &(odd[k]) , 3 );
+      }
+    }
+    
+    if ( p < pairs )
+      convertUYVYToBGR8Scalar( src + v * src_stride + 2 * p, src_stride, 2 * ( pairs - p ), 1, gains, bgr, dst_step );
+  }
+}
+
+
+/**
+ * @brief sumRowAVX2 adds U, Y and V of one source row of 8 binned output pixels.
+ * @param uyvy const uint8_t* first UYVY pair of the row
+ * @param factor int binning factor (2 or 4)
+ */
+static inline void sumRowAVX2( const uint8_t* uyvy, int factor, __m256i& sum_u, __m256i& sum_y, __m256i& sum_v )
+{
+  const __m256i mask = _mm256_set1_epi32( 0xFF );
+  
+  __m256i w = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( uyvy ) );
+  __m256i u = _mm256_and_si256( w, mask );
+  __m256i y = _mm256_add_epi32( _mm256_and_si256( _mm256_srli_epi32( w, 8 ), mask ), _mm256_srli_epi32( w, 24 ) );
+  __m256i v = _mm256_and_si256( _mm256_srli_epi32( w, 16 ), mask );
+  
+  if ( factor == 4 )
+  {
+    // Two pairs per output pixel: add neighboring lanes of both halves and restore the pixel order
+    const __m256i w1 = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( uyvy + 32 ) );
+    const __m256i u1 = _mm256_and_si256( w1, mask );
+    const __m256i y1 = _mm256_add_epi32( _mm256_and_si256( _mm256_srli_epi32( w1, 8 ), mask ), _mm256_srli_epi32( w1, 24 ) );
+    const __m256i v1 = _mm256_and_si256( _mm256_srli_epi32( w1, 16 ), mask );
+    
+    u = _mm256_permute4x64_epi64( _mm256_hadd_epi32( u, u1 ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    y = _mm256_permute4x64_epi64( _mm256_hadd_epi32( y, y1 ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    v = _mm256_permute4x64_epi64( _mm256_hadd_epi32( v, v1 ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+  }
+  
+  sum_u = _mm256_add_epi32( sum_u, u );
+  sum_y = _mm256_add_epi32( sum_y, y );
+  sum_v = _mm256_add_epi32( sum_v, v );
+}
+
+
+/**
+ * @brief binUYVYToBGR8AVX2 is the AVX2 version of binUYVYToBGR8, 8 output pixels per step.
+ * @tparam SRC_STRIDE WIDTH HEIGHT FACTOR source stride, size and binning factor, 0 = the arguments
+ */
+template <int SRC_STRIDE, int WIDTH, int HEIGHT, int FACTOR>
+static void binUYVYToBGR8AVX2( const uint16_t* src, int src_stride, int width, int height, int factor,
+                               const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  if ( SRC_STRIDE ) src_stride = SRC_STRIDE;
+  if ( WIDTH )      width      = WIDTH;
+  if ( HEIGHT )     height     = HEIGHT;
+  if ( FACTOR )     factor     = FACTOR;
+  
+  if ( factor != 2 && factor != 4 )
+  {
+    binUYVYToBGR8Scalar( src, src_stride, width, height, factor, gains, dst, dst_step );
+    return;
+  }
+  
+  const int    dst_width  = width  / factor;
+  const int    dst_height = height / factor;
+  const __m256 y_norm     = _mm256_set1_ps( 1.0f / ( factor * factor ) );
+  const __m256 c_norm     = _mm256_set1_ps( 2.0f / ( factor * factor ) );
+  
+  ChromaAVX2 gains8;
+  gains8.b = _mm256_set1_ps( gains.b );
+  gains8.g = _mm256_set1_ps( gains.g );
+  gains8.r = _mm256_set1_ps( gains.r );
+  
+  for ( int v = 0; v < dst_height; v++ )
+  {
+    const uint16_t* row = src + v * factor * src_stride;
+    uint8_t*        bgr = dst + v * dst_step;
+    
+    int u = 0;
+    for ( ; u + 8 <= dst_width; u += 8, bgr += 24 )
+    {
+      __m256i sum_u = _mm256_setzero_si256();
+      __m256i sum_y = _mm256_setzero_si256();
+      __m256i sum_v = _mm256_setzero_si256();
+      
+      for ( int dy = 0; dy < factor; dy++ )
+        sumRowAVX2( reinterpret_cast<const uint8_t*>( row + dy * src_stride + u * factor ), factor, sum_u, sum_y, sum_v );
+      
+      ChromaAVX2 c;
+      chromaAVX2( _mm256_mul_ps( _mm256_cvtepi32_ps( sum_u ), c_norm ),
+                  _mm256_mul_ps( _mm256_cvtepi32_ps( sum_v ), c_norm ), c );
+      
+      alignas(32) uint32_t pixels[8];
+      _mm256_store_si256( reinterpret_cast<__m256i*>( pixels ),
+                          packBGR8AVX2( _mm256_mul_ps( _mm256_cvtepi32_ps( sum_y ), y_norm ), c, gains8 ) );
+      
+      for ( int k = 0; k < 8; k++ )
+        memcpy( bgr + 3 * k, &(pixels[k]), 3 );
+    }
+    
+    if ( u < dst_width )
+      binUYVYToBGR8Scalar( row + u * factor, src_stride, ( dst_width - u ) * factor, factor, factor,
+                           gains, bgr, dst_step );
+  }
+}
+
+
+/**
+ * @brief computeTileSADAVX2 is the AVX2 version of computeTileSAD.
+ * Each tile is summed down its rows in 32 bit lanes and reduced once.
+ */
+static void computeTileSADAVX2( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad )
+{
+  const int tiles_x = ( width  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int tiles_y = ( height + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int full_x  = width / CHANGE_TILE_SIZE;
+  
+  const __m256i zero = _mm256_setzero_si256();
+  
+  for ( int ty = 0; ty < tiles_y; ty++ )
+  {
+    const int row_begin = ty * CHANGE_TILE_SIZE;
+    const int row_end   = ( height < row_begin + CHANGE_TILE_SIZE ) ? height : row_begin + CHANGE_TILE_SIZE;
+    uint32_t* ps        = sad + ty * tiles_x;
+    
+    for ( int tx = 0; tx < full_x; tx++ )
+    {
+      __m256i acc = zero;
+      
+      for ( int v = row_begin; v < row_end; v++ )
+      {
+        const __m256i pa = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( a + v * width + tx * CHANGE_TILE_SIZE ) );
+        const __m256i pb = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( b + v * width + tx * CHANGE_TILE_SIZE ) );
+        
+        // |a - b| of unsigned 16 bit values, widened to 32 bit
+        const __m256i d = _mm256_or_si256( _mm256_subs_epu16( pa, pb ), _mm256_subs_epu16( pb, pa ) );
+        acc = _mm256_add_epi32( acc, _mm256_add_epi32( _mm256_unpacklo_epi16( d, zero ), _mm256_unpackhi_epi16( d, zero ) ) );
+      }
+      
+      __m128i s = _mm_add_epi32( _mm256_castsi256_si128( acc ), _mm256_extracti128_si256( acc, 1 ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+      ps[tx] = static_cast<uint32_t>( _mm_cvtsi128_si32( s ) );
+    }
+    
+    if ( full_x < tiles_x )
+    {
+      uint32_t sum = 0;
+      
+      for ( int v = row_begin; v < row_end; v++ )
+      {
+        for ( int u = full_x * CHANGE_TILE_SIZE; u < width; u++ )
+        {
+          const int d = static_cast<int>( a[ v * width + u ] ) - static_cast<int>( b[ v * width + u ] );
+          sum += ( d < 0 ) ? -d : d;
+        }
+      }
+      
+      ps[full_x] = sum;
+    }
+  }
+}
+
+
+/**
+ * @brief bin2FixedAVX2 is bin_uyvy by 2 on the color crop of a DefaultFrameLayout frame,
+ * instantiated with constant loop bounds and factor.
+ */
+static void bin2FixedAVX2( const uint16_t* frame, const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  typedef DefaultFrameLayout L;
+  
+  binUYVYToBGR8AVX2<L::FRAME_WIDTH, L::COLOR_WIDTH, L::FRAME_HEIGHT, 2>( frame, L::FRAME_WIDTH, L::COLOR_WIDTH, L::FRAME_HEIGHT,
+                                                                          2, gains, dst, dst_step );
+}
+
+
+const PixelKernels* avx2PixelKernels()
+{
+  static const PixelKernels kernels =
+  {
+    CPU_AVX2,
+    correctDepthAVX2,
+    convertUYVYToBGR8AVX2,
+    binUYVYToBGR8AVX2<0, 0, 0, 0>,
+    computeTileSADAVX2,
+    bin2FixedAVX2
+  };
+  
+  return &kernels;
+}
+
+#else
+
+const PixelKernels* avx2PixelKernels()
+{
+  return NULL;
+}
+
+#endif
+
+};
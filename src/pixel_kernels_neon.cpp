@@ -0,0 +1,419 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include "cis_camera/pixel_kernels.h"
+#include "cis_camera/frame_kernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+namespace cis_camera
+{
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+// 32 bit ARM builds this file with -mfpu=neon and checks the hwcaps before using it,
+// so like the AVX2 file it must not instantiate templates or inline functions shared
+// with other files. The binning template below is static, so every copy stays here.
+
+#if defined(__aarch64__)
+
+/**
+ * @brief correctDepth2NEON corrects two depth samples in double precision like correctDepthScalar.
+ */
+static inline uint32x2_t correctDepth2NEON( uint32x2_t d, float32x2_t inv, double scale, double offset )
+{
+  float64x2_t x = vcvtq_f64_u64( vmovl_u32( d ) );
+  
+  x = vmulq_f64( vaddq_f64( vmulq_f64( x, vdupq_n_f64( scale ) ), vdupq_n_f64( offset ) ), vcvt_f64_f32( inv ) );
+  x = vminq_f64( vmaxq_f64( vrndmq_f64( vaddq_f64( x, vdupq_n_f64( 0.5 ) ) ), vdupq_n_f64( 0.0 ) ),
+                 vdupq_n_f64( 65535.0 ) );
+  
+  return vmovn_u64( vcvtq_u64_f64( x ) );
+}
+
+
+/**
+ * @brief correctDepthNEON is the NEON version of correctDepth, 8 samples per step.
+ * Needs double precision vectors, so 32 bit ARM keeps the scalar version.
+ */
+static void correctDepthNEON( const uint16_t* src, const float* inv_norm, int count,
+                              double scale, double offset, uint16_t* dst )
+{
+  int i = 0;
+  for ( ; i + 8 <= count; i += 8 )
+  {
+    const uint16x8_t  d      = vld1q_u16( src + i );
+    const uint32x4_t  d_lo   = vmovl_u16( vget_low_u16( d ) );
+    const uint32x4_t  d_hi   = vmovl_u16( vget_high_u16( d ) );
+    const float32x4_t inv_lo = vld1q_f32( inv_norm + i );
+    const float32x4_t inv_hi = vld1q_f32( inv_norm + i + 4 );
+    
+    const uint32x4_t lo = vcombine_u32( correctDepth2NEON( vget_low_u32( d_lo ) , vget_low_f32( inv_lo ) , scale, offset ),
+                                        correctDepth2NEON( vget_high_u32( d_lo ), vget_high_f32( inv_lo ), scale, offset ) );
+    const uint32x4_t hi = vcombine_u32( correctDepth2NEON( vget_low_u32( d_hi ) , vget_low_f32( inv_hi ) , scale, offset ),
+                                        correctDepth2NEON( vget_high_u32( d_hi ), vget_high_f32( inv_hi ), scale, offset ) );
+    
+    vst1q_u16( dst + i, vcombine_u16( vmovn_u32( lo ), vmovn_u32( hi ) ) );
+  }
+  
+  correctDepthScalar( src + i, inv_norm + i, count - i, scale, offset, dst + i );
+}
+
+#endif
+
+
+/**
+ * @brief ChromaNEON holds the chroma terms of yuvToBGR8 for 4 pixels.
+ */
+struct ChromaNEON
+{
+  float32x4_t b;
+  float32x4_t g;
+  float32x4_t r;
+};
+
+
+/**
+ * @brief chromaNEON computes the chroma terms of yuvToBGR8 from U and V.
+ */
+static inline void chromaNEON( float32x4_t u, float32x4_t v, ChromaNEON& c )
+{
+  u = vsubq_f32( u, vdupq_n_f32( 128.0f ) );
+  v = vsubq_f32( v, vdupq_n_f32( 128.0f ) );
+  
+  c.r = vmulq_n_f32( v, 1.574800f );
+  c.g = vsubq_f32( vmulq_n_f32( u, 0.187324f ), vmulq_n_f32( v, 0.468124f ) );
+  c.b = vmulq_n_f32( u, 1.855600f );
+}
+
+
+/**
+ * @brief toFloatNEON widens 8 bytes to two float vectors.
+ */
+static inline void toFloatNEON( uint8x8_t x, float32x4_t& lo, float32x4_t& hi )
+{
+  const uint16x8_t w = vmovl_u8( x );
+  
+  lo = vcvtq_f32_u32( vmovl_u16( vget_low_u16( w ) ) );
+  hi = vcvtq_f32_u32( vmovl_u16( vget_high_u16( w ) ) );
+}
+
+
+/**
+ * @brief toFloatNEON widens 8 sums to two float vectors and scales them.
+ */
+static inline void toFloatNEON( uint16x8_t x, float norm, float32x4_t& lo, float32x4_t& hi )
+{
+  lo = vmulq_n_f32( vcvtq_f32_u32( vmovl_u16( vget_low_u16( x ) ) ), norm );
+  hi = vmulq_n_f32( vcvtq_f32_u32( vmovl_u16( vget_high_u16( x ) ) ), norm );
+}
+
+
+/**
+ * @brief clampToByteNEON limits to 0-255 and truncates like clampToByte.
+ */
+static inline uint32x4_t clampToByteNEON( float32x4_t x )
+{
+  return vcvtq_u32_f32( vminq_f32( vmaxq_f32( x, vdupq_n_f32( 0.0f ) ), vdupq_n_f32( 255.0f ) ) );
+}
+
+
+/**
+ * @brief channelNEON computes one BGR8 channel of 8 pixels from their luma and chroma term.
+ */
+static inline uint8x8_t channelNEON( float32x4_t y_lo, float32x4_t y_hi, float32x4_t c_lo, float32x4_t c_hi, float gain )
+{
+  const uint32x4_t lo = clampToByteNEON( vmulq_n_f32( vaddq_f32( y_lo, c_lo ), gain ) );
+  const uint32x4_t hi = clampToByteNEON( vmulq_n_f32( vaddq_f32( y_hi, c_hi ), gain ) );
+  
+  return vmovn_u16( vcombine_u16( vmovn_u32( lo ), vmovn_u32( hi ) ) );
+}
+
+
+/**
+ * @brief convertUYVYToBGR8NEON is the NEON version of convertUYVYToBGR8, 16 pixels per step.
+ */
+static void convertUYVYToBGR8NEON( const uint16_t* src, int src_stride, int width, int height,
+                                   const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  const int pairs = width / 2;
+  
+  for ( int v = 0; v < height; v++ )
+  {
+    const uint8_t* uyvy = reinterpret_cast<const uint8_t*>( src + v * src_stride );
+    uint8_t*       bgr  = dst + v * dst_step;
+    
+    int p = 0;
+    for ( ; p + 8 <= pairs; p += 8, uyvy += 32, bgr += 48 )
+    {
+      // Deinterleaves U, Y0, V and Y1 of 8 pairs
+      const uint8x8x4_t q = vld4_u8( uyvy );
+      
+      float32x4_t u_lo, u_hi, v_lo, v_hi, y0_lo, y0_hi, y1_lo, y1_hi;
+      toFloatNEON( q.val[0], u_lo , u_hi  );
+      toFloatNEON( q.val[1], y0_lo, y0_hi );
+      toFloatNEON( q.val[2], v_lo , v_hi  );
+      toFloatNEON( q.val[3], y1_lo, y1_hi );
+      
+      ChromaNEON c_lo, c_hi;
+      chromaNEON( u_lo, v_lo, c_lo );
+      chromaNEON( u_hi, v_hi, c_hi );
+      
+      // Even and odd pixels zipped back into pixel order
+      const uint8x8x2_t b = vzip_u8( channelNEON( y0_lo, y0_hi, c_lo.b, c_hi.b, gains.b ),
+                                     channelNEON( y1_lo, y1_hi, c_lo.b, c_hi.b, gains.b ) );
+      const uint8x8x2_t g = vzip_u8( channelNEON( y0_lo, y0_hi, c_lo.g, c_hi.g, gains.g ),
+                                     channelNEON( y1_lo, y1_hi, c_lo.g, c_hi.g, gains.g ) );
+      const uint8x8x2_t r = vzip_u8( channelNEON( y0_lo, y0_hi, c_lo.r, c_hi.r, gains.r ),
+                                     channelNEON( y1_lo, y1_hi, c_lo.r, c_hi.r, gains.r ) );
+      
+      uint8x8x3_t out;
+      out.val[0] = b.val[0];
+      out.val[1] = g.val[0];
+      out.val[2] = r.val[0];
+      vst3_u8( bgr, out );
+      
+      out.val[0] = b.val[1];
+      out.val[1] = g.val[1];
+      out.val[2] = r.val[1];
+      vst3_u8( bgr + 24, out );
+    }
+    
+    if ( p < pairs )
+      convertUYVYToBGR8Scalar( src + v * src_stride + 2 * p, src_stride, 2 * ( pairs - p ), 1, gains, bgr, dst_step );
+  }
+}
+
+
+/**
+ * @brief sumRowNEON adds U, Y and V of one source row of 8 binned output pixels.
+ * @param uyvy const uint8_t* first UYVY pair of the row
+ * @param factor int binning factor (2 or 4)
+ */
+static inline void sumRowNEON( const uint8_t* uyvy, int factor, uint16x8_t& sum_u, uint16x8_t& sum_y, uint16x8_t& sum_v )
+{
+  const uint8x8x4_t q0 = vld4_u8( uyvy );
+  
+  if ( factor == 2 )
+  {
+    sum_u = vaddw_u8( sum_u, q0.val[0] );
+    sum_y = vaddq_u16( sum_y, vaddl_u8( q0.val[1], q0.val[3] ) );
+    sum_v = vaddw_u8( sum_v, q0.val[2] );
+  }
+  else
+  {
+    // Two pairs per output pixel: add neighboring pairs
+    const uint8x8x4_t q1 = vld4_u8( uyvy + 32 );
+    
+    sum_u = vaddq_u16( sum_u, vcombine_u16( vpaddl_u8( q0.val[0] ), vpaddl_u8( q1.val[0] ) ) );
+    sum_y = vaddq_u16( sum_y, vcombine_u16( vadd_u16( vpaddl_u8( q0.val[1] ), vpaddl_u8( q0.val[3] ) ),
+                                            vadd_u16( vpaddl_u8( q1.val[1] ), vpaddl_u8( q1.val[3] ) ) ) );
+    sum_v = vaddq_u16( sum_v, vcombine_u16( vpaddl_u8( q0.val[2] ), vpaddl_u8( q1.val[2] ) ) );
+  }
+}
+
+
+/**
+ * @brief binUYVYToBGR8NEON is the NEON version of binUYVYToBGR8, 8 output pixels per step.
+ * @tparam SRC_STRIDE WIDTH HEIGHT FACTOR source stride, size and binning factor, 0 = the arguments
+ */
+template <int SRC_STRIDE, int WIDTH, int HEIGHT, int FACTOR>
+static void binUYVYToBGR8NEON( const uint16_t* src, int src_stride, int width, int height, int factor,
+                               const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  if ( SRC_STRIDE ) src_stride = SRC_STRIDE;
+  if ( WIDTH )      width      = WIDTH;
+  if ( HEIGHT )     height     = HEIGHT;
+  if ( FACTOR )     factor     = FACTOR;
+  
+  if ( factor != 2 && factor != 4 )
+  {
+    binUYVYToBGR8Scalar( src, src_stride, width, height, factor, gains, dst, dst_step );
+    return;
+  }
+  
+  const int   dst_width  = width  / factor;
+  const int   dst_height = height / factor;
+  const float y_norm     = 1.0f / ( factor * factor );
+  const float c_norm     = 2.0f / ( factor * factor );
+  
+  for ( int v = 0; v < dst_height; v++ )
+  {
+    const uint16_t* row = src + v * factor * src_stride;
+    uint8_t*        bgr = dst + v * dst_step;
+    
+    int u = 0;
+    for ( ; u + 8 <= dst_width; u += 8, bgr += 24 )
+    {
+      uint16x8_t sum_u = vdupq_n_u16( 0 );
+      uint16x8_t sum_y = vdupq_n_u16( 0 );
+      uint16x8_t sum_v = vdupq_n_u16( 0 );
+      
+      for ( int dy = 0; dy < factor; dy++ )
+        sumRowNEON( reinterpret_cast<const uint8_t*>( row + dy * src_stride + u * factor ), factor, sum_u, sum_y, sum_v );
+      
+      float32x4_t u_lo, u_hi, v_lo, v_hi, y_lo, y_hi;
+      toFloatNEON( sum_u, c_norm, u_lo, u_hi );
+      toFloatNEON( sum_y, y_norm, y_lo, y_hi );
+      toFloatNEON( sum_v, c_norm, v_lo, v_hi );
+      
+      ChromaNEON c_lo, c_hi;
+      chromaNEON( u_lo, v_lo, c_lo );
+      chromaNEON( u_hi, v_hi, c_hi );
+      
+      uint8x8x3_t out;
+      out.val[0] = channelNEON( y_lo, y_hi, c_lo.b, c_hi.b, gains.b );
+      out.val[1] = channelNEON( y_lo, y_hi, c_lo.g, c_hi.g, gains.g );
+      out.val[2] = channelNEON( y_lo, y_hi, c_lo.r, c_hi.r, gains.r );
+      vst3_u8( bgr, out );
+    }
+    
+    if ( u < dst_width )
+      binUYVYToBGR8Scalar( row + u * factor, src_stride, ( dst_width - u ) * factor, factor, factor,
+                           gains, bgr, dst_step );
+  }
+}
+
+
+/**
+ * @brief sumLanesNEON adds the four lanes of a vector.
+ */
+static inline uint32_t sumLanesNEON( uint32x4_t x )
+{
+#if defined(__aarch64__)
+  return vaddvq_u32( x );
+#else
+  uint32x2_t s = vadd_u32( vget_low_u32( x ), vget_high_u32( x ) );
+  return vget_lane_u32( vpadd_u32( s, s ), 0 );
+#endif
+}
+
+
+/**
+ * @brief computeTileSADNEON is the NEON version of computeTileSAD.
+ * Each tile is summed down its rows in 32 bit lanes and reduced once.
+ */
+static void computeTileSADNEON( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad )
+{
+  const int tiles_x = ( width  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int tiles_y = ( height + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int full_x  = width / CHANGE_TILE_SIZE;
+  
+  for ( int ty = 0; ty < tiles_y; ty++ )
+  {
+    const int row_begin = ty * CHANGE_TILE_SIZE;
+    const int row_end   = ( height < row_begin + CHANGE_TILE_SIZE ) ? height : row_begin + CHANGE_TILE_SIZE;
+    uint32_t* ps        = sad + ty * tiles_x;
+    
+    for ( int tx = 0; tx < full_x; tx++ )
+    {
+      uint32x4_t acc = vdupq_n_u32( 0 );
+      
+      for ( int v = row_begin; v < row_end; v++ )
+      {
+        const uint16_t* pa = a + v * width + tx * CHANGE_TILE_SIZE;
+        const uint16_t* pb = b + v * width + tx * CHANGE_TILE_SIZE;
+        
+        acc = vpadalq_u16( acc, vabdq_u16( vld1q_u16( pa     ), vld1q_u16( pb     ) ) );
+        acc = vpadalq_u16( acc, vabdq_u16( vld1q_u16( pa + 8 ), vld1q_u16( pb + 8 ) ) );
+      }
+      
+      ps[tx] = sumLanesNEON( acc );
+    }
+    
+    if ( full_x < tiles_x )
+    {
+      uint32_t sum = 0;
+      
+      for ( int v = row_begin; v < row_end; v++ )
+      {
+        for ( int u = full_x * CHANGE_TILE_SIZE; u < width; u++ )
+        {
+          const int d = static_cast<int>( a[ v * width + u ] ) - static_cast<int>( b[ v * width + u ] );
+          sum += ( d < 0 ) ? -d : d;
+        }
+      }
+      
+      ps[full_x] = sum;
+    }
+  }
+}
+
+
+/**
+ * @brief bin2FixedNEON is bin_uyvy by 2 on the color crop of a DefaultFrameLayout frame,
+ * instantiated with constant loop bounds and factor.
+ */
+static void bin2FixedNEON( const uint16_t* frame, const ColorGains& gains, uint8_t* dst, int dst_step )
+{
+  typedef DefaultFrameLayout L;
+  
+  binUYVYToBGR8NEON<L::FRAME_WIDTH, L::COLOR_WIDTH, L::FRAME_HEIGHT, 2>( frame, L::FRAME_WIDTH, L::COLOR_WIDTH, L::FRAME_HEIGHT,
+                                                                          2, gains, dst, dst_step );
+}
+
+
+const PixelKernels* neonPixelKernels()
+{
+  static const PixelKernels kernels =
+  {
+    CPU_NEON,
+#if defined(__aarch64__)
+    correctDepthNEON,
+#else
+    correctDepthScalar,
+#endif
+    convertUYVYToBGR8NEON,
+    binUYVYToBGR8NEON<0, 0, 0, 0>,
+    computeTileSADNEON,
+    bin2FixedNEON
+  };
+  
+  return &kernels;
+}
+
+#else
+
+const PixelKernels* neonPixelKernels()
+{
+  return NULL;
+}
+
+#endif
+
+};
@@ -0,0 +1,120 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include "cis_camera/pixel_kernels.h"
+
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace cis_camera
+{
+
+#ifdef __SSE2__
+
+/**
+ * @brief computeTileSADSSE2 is the SSE2 version of computeTileSAD.
+ */
+static void computeTileSADSSE2( const uint16_t* a, const uint16_t* b, int width, int height, uint32_t* sad )
+{
+  const int tiles_x = ( width  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int tiles_y = ( height + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE;
+  const int full_x  = width / CHANGE_TILE_SIZE;
+  
+  for ( int i = 0; i < tiles_x * tiles_y; i++ )
+    sad[i] = 0;
+  
+  const __m128i zero = _mm_setzero_si128();
+  
+  for ( int v = 0; v < height; v++ )
+  {
+    const uint16_t* pa = a + v * width;
+    const uint16_t* pb = b + v * width;
+    uint32_t*       ps = sad + ( v / CHANGE_TILE_SIZE ) * tiles_x;
+    
+    for ( int t = 0; t < full_x; t++ )
+    {
+      const __m128i a0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pa + t * CHANGE_TILE_SIZE ) );
+      const __m128i a1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pa + t * CHANGE_TILE_SIZE + 8 ) );
+      const __m128i b0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pb + t * CHANGE_TILE_SIZE ) );
+      const __m128i b1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pb + t * CHANGE_TILE_SIZE + 8 ) );
+      
+      // |a - b| of unsigned 16 bit values with saturating subtractions
+      const __m128i d0 = _mm_or_si128( _mm_subs_epu16( a0, b0 ), _mm_subs_epu16( b0, a0 ) );
+      const __m128i d1 = _mm_or_si128( _mm_subs_epu16( a1, b1 ), _mm_subs_epu16( b1, a1 ) );
+      
+      // Widen to 32 bit and reduce the 16 differences
+      __m128i s = _mm_add_epi32( _mm_add_epi32( _mm_unpacklo_epi16( d0, zero ), _mm_unpackhi_epi16( d0, zero ) ),
+                                 _mm_add_epi32( _mm_unpacklo_epi16( d1, zero ), _mm_unpackhi_epi16( d1, zero ) ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+      s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+      ps[t] += static_cast<uint32_t>( _mm_cvtsi128_si32( s ) );
+    }
+    
+    for ( int u = full_x * CHANGE_TILE_SIZE; u < width; u++ )
+      ps[ u / CHANGE_TILE_SIZE ] += abs( static_cast<int>( pa[u] ) - static_cast<int>( pb[u] ) );
+  }
+}
+
+
+const PixelKernels* sse2PixelKernels()
+{
+  // Only the tile SAD has an SSE2 version, the float kernels need AVX2 to pay off
+  static const PixelKernels kernels =
+  {
+    CPU_SSE2,
+    correctDepthScalar,
+    convertUYVYToBGR8Scalar,
+    binUYVYToBGR8Scalar,
+    computeTileSADSSE2,
+    NULL
+  };
+  
+  return &kernels;
+}
+
+#else
+
+const PixelKernels* sse2PixelKernels()
+{
+  return NULL;
+}
+
+#endif
+
+};
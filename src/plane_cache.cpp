@@ -0,0 +1,172 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/plane_cache.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include <Eigen/Eigenvalues>
+
+
+namespace cis_camera
+{
+
+PlaneCache::PlaneCache() :
+    distance_( 0.02 ),
+    samples_( 200 ),
+    min_ratio_( 0.8 ),
+    valid_( false ),
+    plane_( Eigen::Vector4f::Zero() ),
+    reference_ratio_( 0.0 ),
+    hits_( 0 ),
+    misses_( 0 ),
+    rng_( 0 )
+{
+}
+
+
+void PlaneCache::findInliers( const Cloud& cloud, const Eigen::Vector4f& plane, std::vector<int>& inliers ) const
+{
+  inliers.clear();
+
+  for ( size_t i = 0; i < cloud.points.size(); i++ )
+  {
+    const Point& p = cloud.points[i];
+    if ( fabs( plane[0] * p.x + plane[1] * p.y + plane[2] * p.z + plane[3] ) <= distance_ )
+      inliers.push_back( i );
+  }
+}
+
+
+/**
+ * @brief refine fits a plane to the inliers by least squares: the normal is the
+ * eigenvector of the smallest eigenvalue of their covariance. The normal keeps
+ * the orientation of the previous plane.
+ */
+bool PlaneCache::refine( const Cloud& cloud, const std::vector<int>& inliers, Eigen::Vector4f& plane ) const
+{
+  if ( inliers.size() < 3 )
+    return false;
+
+  Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+  for ( size_t i = 0; i < inliers.size(); i++ )
+    mean += cloud.points[ inliers[i] ].getVector3fMap().cast<double>();
+  mean /= static_cast<double>( inliers.size() );
+
+  Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+  for ( size_t i = 0; i < inliers.size(); i++ )
+  {
+    Eigen::Vector3d d = cloud.points[ inliers[i] ].getVector3fMap().cast<double>() - mean;
+    covariance += d * d.transpose();
+  }
+
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver( covariance );
+  if ( solver.info() != Eigen::Success )
+    return false;
+
+  Eigen::Vector3d normal = solver.eigenvectors().col( 0 );
+  if ( normal.dot( plane.head<3>().cast<double>() ) < 0.0 )
+    normal = -normal;
+
+  plane.head<3>() = normal.cast<float>();
+  plane[3] = static_cast<float>( -normal.dot( mean ) );
+
+  return true;
+}
+
+
+bool PlaneCache::check( const Cloud& cloud, pcl::ModelCoefficients& coefficients, pcl::PointIndices& inliers )
+{
+  const size_t n = cloud.points.size();
+
+  if ( not valid_ || n == 0 )
+  {
+    misses_++;
+    return false;
+  }
+
+  // Inlier ratio of the cached plane on a random subset
+  std::uniform_int_distribution<size_t> pick( 0, n - 1 );
+  size_t samples = std::min( n, static_cast<size_t>( std::max( 1, samples_ ) ) );
+  size_t count   = 0;
+
+  for ( size_t i = 0; i < samples; i++ )
+  {
+    const Point& p = cloud.points[ pick( rng_ ) ];
+    if ( fabs( plane_[0] * p.x + plane_[1] * p.y + plane_[2] * p.z + plane_[3] ) <= distance_ )
+      count++;
+  }
+
+  double ratio = static_cast<double>( count ) / samples;
+  if ( ratio < min_ratio_ * reference_ratio_ )
+  {
+    valid_ = false;
+    misses_++;
+    return false;
+  }
+
+  // Least squares refinement on the inliers of the cached plane
+  Eigen::Vector4f plane = plane_;
+  findInliers( cloud, plane, inliers.indices );
+  if ( not refine( cloud, inliers.indices, plane ) )
+  {
+    valid_ = false;
+    misses_++;
+    return false;
+  }
+  findInliers( cloud, plane, inliers.indices );
+
+  plane_ = plane;
+  coefficients.values.assign( plane_.data(), plane_.data() + 4 );
+
+  hits_++;
+  return true;
+}
+
+
+void PlaneCache::store( const Cloud& cloud, const pcl::ModelCoefficients& coefficients, const pcl::PointIndices& inliers )
+{
+  if ( coefficients.values.size() != 4 || cloud.points.empty() || inliers.indices.empty() )
+  {
+    valid_ = false;
+    return;
+  }
+
+  plane_ = Eigen::Vector4f( coefficients.values[0], coefficients.values[1],
+                            coefficients.values[2], coefficients.values[3] );
+  reference_ratio_ = static_cast<double>( inliers.indices.size() ) / cloud.points.size();
+  valid_ = true;
+}
+
+};
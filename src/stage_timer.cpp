@@ -0,0 +1,157 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/stage_timer.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+
+namespace cis_camera
+{
+
+StageTimer::StageTimer( size_t window ) :
+    window_( std::max( static_cast<size_t>( 1 ), window ) ),
+    last_( Clock::now() )
+{
+}
+
+
+void StageTimer::start()
+{
+  last_ = Clock::now();
+}
+
+
+void StageTimer::lap( const std::string& stage )
+{
+  Clock::time_point now = Clock::now();
+  add( stage, std::chrono::duration<double, std::milli>( now - last_ ).count() );
+  last_ = now;
+}
+
+
+void StageTimer::add( const std::string& stage, double msec )
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+
+  std::map<std::string, std::deque<double> >::iterator it = samples_.find( stage );
+  if ( it == samples_.end() )
+  {
+    order_.push_back( stage );
+    it = samples_.insert( std::make_pair( stage, std::deque<double>() ) ).first;
+  }
+
+  it->second.push_back( msec );
+  while ( window_ < it->second.size() )
+    it->second.pop_front();
+}
+
+
+void StageTimer::clear()
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+  order_.clear();
+  samples_.clear();
+}
+
+
+void StageTimer::setWindow( size_t window )
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+  window_ = std::max( static_cast<size_t>( 1 ), window );
+}
+
+
+std::vector<std::string> StageTimer::stages() const
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+  return order_;
+}
+
+
+StageTimer::Stats StageTimer::stats( const std::string& stage ) const
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+  return statsLocked( stage );
+}
+
+
+StageTimer::Stats StageTimer::statsLocked( const std::string& stage ) const
+{
+  Stats stats;
+
+  std::map<std::string, std::deque<double> >::const_iterator it = samples_.find( stage );
+  if ( it == samples_.end() || it->second.empty() )
+    return stats;
+
+  std::vector<double> sorted( it->second.begin(), it->second.end() );
+  std::sort( sorted.begin(), sorted.end() );
+
+  double sum = 0.0;
+  for ( size_t i = 0; i < sorted.size(); i++ )
+    sum += sorted[i];
+
+  // Nearest rank percentiles
+  size_t n = sorted.size();
+  stats.count = n;
+  stats.mean  = sum / n;
+  stats.p50   = sorted[ std::min( n - 1, ( n * 50 ) / 100 ) ];
+  stats.p90   = sorted[ std::min( n - 1, ( n * 90 ) / 100 ) ];
+  stats.p99   = sorted[ std::min( n - 1, ( n * 99 ) / 100 ) ];
+  stats.max   = sorted[ n - 1 ];
+
+  return stats;
+}
+
+
+std::string StageTimer::report() const
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+
+  std::string text;
+  char line[256];
+
+  for ( size_t i = 0; i < order_.size(); i++ )
+  {
+    Stats s = statsLocked( order_[i] );
+    snprintf( line, sizeof(line),
+              "%-16s mean %8.3f  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f [ms] (%zu)\n",
+              order_[i].c_str(), s.mean, s.p50, s.p90, s.p99, s.max, s.count );
+    text += line;
+  }
+
+  return text;
+}
+
+};
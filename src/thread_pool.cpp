@@ -0,0 +1,140 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/thread_pool.h"
+
+#include <algorithm>
+
+
+namespace cis_camera
+{
+
+ThreadPool::ThreadPool( size_t threads ) :
+    job_( NULL ),
+    job_tasks_( 0 ),
+    next_task_( 0 ),
+    active_workers_( 0 ),
+    generation_( 0 ),
+    stop_( false )
+{
+  if ( threads == 0 )
+    threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+  for ( size_t i = 1; i < threads; i++ )
+    workers_.push_back( std::thread( &ThreadPool::workerLoop, this ) );
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+
+  for ( size_t i = 0; i < workers_.size(); i++ )
+    workers_[i].join();
+}
+
+
+void ThreadPool::run( size_t tasks, const std::function<void( size_t )>& fn )
+{
+  if ( tasks == 0 )
+    return;
+
+  // Nothing to share, run on the calling thread
+  if ( workers_.empty() || tasks == 1 )
+  {
+    for ( size_t i = 0; i < tasks; i++ )
+      fn( i );
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    job_            = &fn;
+    job_tasks_      = tasks;
+    next_task_      = 0;
+    active_workers_ = workers_.size();
+    generation_++;
+  }
+  start_cv_.notify_all();
+
+  drain();
+
+  std::unique_lock<std::mutex> lock( mutex_ );
+  done_cv_.wait( lock, [this]{ return active_workers_ == 0; } );
+  job_ = NULL;
+}
+
+
+void ThreadPool::splitRange( size_t n, size_t parts, size_t part, size_t& begin, size_t& end )
+{
+  begin = n * part / parts;
+  end   = n * ( part + 1 ) / parts;
+}
+
+
+void ThreadPool::drain()
+{
+  for ( size_t i = next_task_++; i < job_tasks_; i = next_task_++ )
+    ( *job_ )( i );
+}
+
+
+void ThreadPool::workerLoop()
+{
+  uint64_t generation = 0;
+
+  while ( true )
+  {
+    {
+      std::unique_lock<std::mutex> lock( mutex_ );
+      start_cv_.wait( lock, [&]{ return stop_ || generation_ != generation; } );
+      if ( stop_ )
+        return;
+      generation = generation_;
+    }
+
+    drain();
+
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      if ( --active_workers_ == 0 )
+        done_cv_.notify_one();
+    }
+  }
+}
+
+};
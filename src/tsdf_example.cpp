@@ -0,0 +1,59 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// The TSDF fusion itself lives in TsdfExampleNodelet (src/tsdf_example_nodelet.cpp).
+// This standalone node only loads that nodelet, so it can also be loaded next to
+// the camera nodelet with "nodelet load cis_camera/tsdf_example_nodelet".
+
+#include <ros/ros.h>
+#include <nodelet/loader.h>
+
+
+int main( int argc, char *argv[] )
+{
+  ros::init( argc, argv, "tsdf_example" );
+
+  nodelet::Loader nodelet;
+  nodelet::M_string remap( ros::names::getRemappings() );
+  nodelet::V_string nargv;
+
+  if ( not nodelet.load( ros::this_node::getName(), "cis_camera/tsdf_example_nodelet", remap, nargv ) )
+  {
+    ROS_ERROR( "Unable to load cis_camera/tsdf_example_nodelet." );
+    return 1;
+  }
+
+  ros::spin();
+
+  return 0;
+}
@@ -0,0 +1,326 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <mutex>
+
+#include <ros/ros.h>
+#include <pluginlib/class_list_macros.h>
+#include <nodelet/nodelet.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_srvs/Trigger.h>
+#include <tf/transform_listener.h>
+#include <tf_conversions/tf_eigen.h>
+
+#include <pcl_conversions/pcl_conversions.h>
+
+#include "cis_camera/stage_timer.h"
+#include "cis_camera/thread_pool.h"
+#include "cis_camera/tsdf_volume.h"
+
+
+namespace cis_camera
+{
+
+/**
+ * @brief TsdfExampleNodelet fuses the corrected depth images of the camera into a TsdfVolume.
+ * Every depth image is integrated at the camera pose looked up from TF in the world frame,
+ * so a moving camera (e.g. on an arm) builds up a map of the workspace. The surface is
+ * extracted as a cloud on demand through the extract_cloud service.
+ */
+class TsdfExampleNodelet : public nodelet::Nodelet
+{
+public:
+
+  TsdfExampleNodelet() : frames_( 0 ) {}
+
+private:
+
+  virtual void onInit();
+
+  void depthCallback( const sensor_msgs::ImageConstPtr& msg, const sensor_msgs::CameraInfoConstPtr& info );
+  bool lookupTransform( const std_msgs::Header& header, Eigen::Affine3f& transform );
+  bool extractCloud( std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res );
+  bool resetVolume( std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res );
+  void reportTiming();
+
+  std::string world_frame_;
+  double      tf_timeout_;
+  double      min_weight_;
+
+  // Per-stage timing output
+  bool          timing_;
+  double        timing_period_;
+  ros::WallTime last_report_;
+
+  boost::shared_ptr<tf::TransformListener> listener_;
+  boost::shared_ptr<ThreadPool>            pool_;
+
+  boost::shared_ptr<image_transport::ImageTransport> it_;
+  image_transport::CameraSubscriber                  depth_sub_;
+
+  ros::Publisher     cloud_pub_;
+  ros::ServiceServer extract_srv_;
+  ros::ServiceServer reset_srv_;
+
+  // The volume is shared by the depth callback and the services
+  std::mutex  mutex_;
+  TsdfVolume  volume_;
+  StageTimer  timer_;
+  size_t      frames_;
+  ros::Time   last_stamp_;
+};
+
+
+void TsdfExampleNodelet::onInit()
+{
+  ros::NodeHandle nh( getNodeHandle() );
+  ros::NodeHandle priv_nh( getPrivateNodeHandle() );
+
+  priv_nh.param<std::string>( "world_frame", world_frame_, "map" );
+  priv_nh.param( "tf_timeout", tf_timeout_, 0.1 );
+  priv_nh.param( "min_weight", min_weight_, 2.0 );
+
+  priv_nh.param( "timing"       , timing_       , false );
+  priv_nh.param( "timing_period", timing_period_, 5.0 );
+
+  TsdfVolume::Parameters params;
+  double voxel_size = params.voxel_size;
+  double truncation = params.truncation;
+  double max_weight = params.max_weight;
+  double min_depth  = params.min_depth;
+  double max_depth  = params.max_depth;
+  int    max_blocks = static_cast<int>( params.max_blocks );
+  int    threads    = 0;
+
+  priv_nh.param( "voxel_size", voxel_size, voxel_size );
+  priv_nh.param( "truncation", truncation, truncation );
+  priv_nh.param( "max_weight", max_weight, max_weight );
+  priv_nh.param( "min_depth" , min_depth , min_depth );
+  priv_nh.param( "max_depth" , max_depth , max_depth );
+  priv_nh.param( "max_blocks", max_blocks, max_blocks );
+  priv_nh.param( "allocation_stride", params.allocation_stride, params.allocation_stride );
+  priv_nh.param( "threads"   , threads   , threads );
+
+  params.voxel_size = static_cast<float>( std::max( 0.001, voxel_size ) );
+  params.truncation = static_cast<float>( truncation );
+  params.max_weight = static_cast<float>( max_weight );
+  params.min_depth  = static_cast<float>( min_depth );
+  params.max_depth  = static_cast<float>( max_depth );
+  params.max_blocks = static_cast<size_t>( std::max( 1, max_blocks ) );
+  volume_ = TsdfVolume( params );
+
+  pool_.reset( new ThreadPool( std::max( 0, threads ) ) );
+  listener_.reset( new tf::TransformListener( nh ) );
+
+  std::string depth_topic;
+  priv_nh.param<std::string>( "depth_topic", depth_topic, "/camera/depth/image_raw" );
+
+  // Latched, the cloud is only published when extract_cloud is called
+  cloud_pub_   = nh.advertise<sensor_msgs::PointCloud2>( "tsdf_cloud", 1, true );
+  extract_srv_ = priv_nh.advertiseService( "extract_cloud", &TsdfExampleNodelet::extractCloud, this );
+  reset_srv_   = priv_nh.advertiseService( "reset", &TsdfExampleNodelet::resetVolume, this );
+
+  // Queue size 1 drops stale frames while a frame is being integrated
+  it_.reset( new image_transport::ImageTransport( nh ) );
+  depth_sub_ = it_->subscribeCamera( depth_topic, 1, &TsdfExampleNodelet::depthCallback, this );
+
+  NODELET_INFO( "TSDF example: %.3f m voxels, %.3f m truncation, at most %d blocks (%.1f MB), %d threads.",
+                params.voxel_size, params.truncation, max_blocks,
+                max_blocks * TsdfVolume::BLOCK_VOXELS * 8.0 / ( 1024.0 * 1024.0 ), static_cast<int>( pool_->size() ) );
+  NODELET_INFO_STREAM( "TSDF example: integrating depth images of topic " << nh.resolveName( depth_topic )
+                       << " in frame " << world_frame_ );
+}
+
+
+/**
+ * @brief lookupTransform gets the pose of the depth optical frame in the world frame.
+ * @param header const std_msgs::Header& header of the depth image
+ * @param transform Eigen::Affine3f& pose in the world frame
+ * @return bool false when the transform is not available
+ */
+bool TsdfExampleNodelet::lookupTransform( const std_msgs::Header& header, Eigen::Affine3f& transform )
+{
+  transform = Eigen::Affine3f::Identity();
+
+  if ( header.frame_id == world_frame_ )
+    return true;
+
+  tf::StampedTransform stransform;
+  try
+  {
+    listener_->waitForTransform( world_frame_, header.frame_id, header.stamp, ros::Duration( tf_timeout_ ) );
+    listener_->lookupTransform( world_frame_, header.frame_id, header.stamp, stransform );
+  }
+  catch ( tf::TransformException& ex )
+  {
+    NODELET_WARN_THROTTLE( 1.0, "%s", ex.what() );
+    return false;
+  }
+
+  Eigen::Affine3d transform_d;
+  tf::transformTFToEigen( stransform, transform_d );
+  transform = transform_d.cast<float>();
+
+  return true;
+}
+
+
+/**
+ * @brief depthCallback integrates a depth image at its camera pose.
+ * @param msg const sensor_msgs::ImageConstPtr& 16UC1 depth image [mm]
+ * @param info const sensor_msgs::CameraInfoConstPtr& camera info of the depth image
+ */
+void TsdfExampleNodelet::depthCallback( const sensor_msgs::ImageConstPtr& msg, const sensor_msgs::CameraInfoConstPtr& info )
+{
+  if ( msg->encoding != sensor_msgs::image_encodings::TYPE_16UC1 || msg->step != msg->width * 2 )
+  {
+    NODELET_WARN_THROTTLE( 1.0, "TSDF example needs packed 16UC1 depth images, got %s.", msg->encoding.c_str() );
+    return;
+  }
+
+  Eigen::Affine3f transform;
+  if ( not lookupTransform( msg->header, transform ) )
+    return;
+
+  std::lock_guard<std::mutex> lock( mutex_ );
+  timer_.start();
+
+  TsdfVolume::Camera camera;
+  camera.width  = msg->width;
+  camera.height = msg->height;
+  camera.fx = info->K[0];
+  camera.fy = info->K[4];
+  camera.cx = info->K[2];
+  camera.cy = info->K[5];
+  if ( 5 <= info->D.size() )
+  {
+    camera.k1 = info->D[0];
+    camera.k2 = info->D[1];
+    camera.p1 = info->D[2];
+    camera.p2 = info->D[3];
+    camera.k3 = info->D[4];
+  }
+
+  if ( camera.fx <= 0.0 || camera.fy <= 0.0 )
+  {
+    NODELET_WARN_THROTTLE( 1.0, "TSDF example: depth camera info is not calibrated." );
+    return;
+  }
+
+  if ( not ( camera == volume_.camera() ) )
+  {
+    volume_.setCamera( camera );
+    timer_.lap( "camera" );
+  }
+
+  volume_.integrate( reinterpret_cast<const uint16_t*>( &(msg->data[0]) ), transform, pool_.get() );
+  timer_.lap( "integrate" );
+
+  frames_++;
+  last_stamp_ = msg->header.stamp;
+
+  if ( timing_ )
+    reportTiming();
+}
+
+
+/**
+ * @brief extractCloud publishes the surface of the volume on tsdf_cloud.
+ */
+bool TsdfExampleNodelet::extractCloud( std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res )
+{
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  ros::Time stamp;
+  size_t    blocks;
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    timer_.start();
+    volume_.extractCloud( cloud, static_cast<float>( min_weight_ ) );
+    timer_.lap( "extract" );
+    stamp  = last_stamp_;
+    blocks = volume_.blocks();
+  }
+
+  sensor_msgs::PointCloud2::Ptr msg( new sensor_msgs::PointCloud2 );
+  pcl::toROSMsg( cloud, *msg );
+  msg->header.frame_id = world_frame_;
+  msg->header.stamp    = stamp;
+  cloud_pub_.publish( msg );
+
+  res.success = true;
+  res.message = "Published " + std::to_string( cloud.size() ) + " surface points of " +
+                std::to_string( blocks ) + " blocks on tsdf_cloud.";
+  return true;
+}
+
+
+/**
+ * @brief resetVolume clears the volume.
+ */
+bool TsdfExampleNodelet::resetVolume( std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res )
+{
+  std::lock_guard<std::mutex> lock( mutex_ );
+  volume_.reset();
+  frames_ = 0;
+
+  res.success = true;
+  res.message = "TSDF volume cleared.";
+  return true;
+}
+
+
+/**
+ * @brief reportTiming prints the integration latencies and the volume size every timing_period seconds.
+ * The caller must hold mutex_.
+ */
+void TsdfExampleNodelet::reportTiming()
+{
+  ros::WallTime now = ros::WallTime::now();
+  if ( ( now - last_report_ ).toSec() < timing_period_ )
+    return;
+  last_report_ = now;
+
+  NODELET_INFO_STREAM( "TSDF example timing, " << frames_ << " frames, " << volume_.blocks() << " blocks ("
+                       << volume_.visibleBlocks() << " visible, " << volume_.evictedBlocks() << " evicted, "
+                       << volume_.droppedBlocks() << " dropped):\n" << timer_.report() );
+}
+
+};
+
+// Register this plugin with pluginlib.
+//
+// parameters are: class type, base class type
+PLUGINLIB_EXPORT_CLASS( cis_camera::TsdfExampleNodelet, nodelet::Nodelet )
@@ -0,0 +1,458 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/tsdf_volume.h"
+
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+
+namespace cis_camera
+{
+
+const int TsdfVolume::BLOCK_SIZE;
+const int TsdfVolume::BLOCK_VOXELS;
+
+
+TsdfVolume::TsdfVolume( const Parameters& params ) :
+    params_( params ),
+    frame_( 0 ),
+    evicted_( 0 ),
+    dropped_( 0 )
+{
+  params_.max_blocks        = std::max<size_t>( 1, params_.max_blocks );
+  params_.allocation_stride = std::max( 1, params_.allocation_stride );
+  params_.truncation        = std::max( params_.truncation, params_.voxel_size );
+}
+
+
+/**
+ * @brief setCamera sets the depth camera and builds its undistorted ray table.
+ * The plumb bob model is inverted by fixed point iteration as in cv::undistortPoints.
+ */
+void TsdfVolume::setCamera( const Camera& camera )
+{
+  camera_ = camera;
+
+  const size_t pixels = static_cast<size_t>( camera.width ) * camera.height;
+  ray_x_.resize( pixels );
+  ray_y_.resize( pixels );
+
+  for ( int v = 0; v < camera.height; v++ )
+  {
+    for ( int u = 0; u < camera.width; u++ )
+    {
+      const double x0 = ( u - camera.cx ) / camera.fx;
+      const double y0 = ( v - camera.cy ) / camera.fy;
+      double x = x0, y = y0;
+
+      for ( int k = 0; k < 5; k++ )
+      {
+        double r2 = x * x + y * y;
+        double icdist = 1.0 / ( 1.0 + ( ( camera.k3 * r2 + camera.k2 ) * r2 + camera.k1 ) * r2 );
+        double dx = 2.0 * camera.p1 * x * y + camera.p2 * ( r2 + 2.0 * x * x );
+        double dy = camera.p1 * ( r2 + 2.0 * y * y ) + 2.0 * camera.p2 * x * y;
+        x = ( x0 - dx ) * icdist;
+        y = ( y0 - dy ) * icdist;
+      }
+
+      ray_x_[ v * camera.width + u ] = static_cast<float>( x );
+      ray_y_[ v * camera.width + u ] = static_cast<float>( y );
+    }
+  }
+}
+
+
+void TsdfVolume::reset()
+{
+  hash_.clear();
+  blocks_.clear();
+  free_.clear();
+  visible_.clear();
+  frame_   = 0;
+  evicted_ = 0;
+  dropped_ = 0;
+}
+
+
+/**
+ * @brief blockKey packs a block index into 21 bits per axis.
+ */
+uint64_t TsdfVolume::blockKey( const Eigen::Vector3i& index )
+{
+  const uint64_t mask = ( 1u << 21 ) - 1;
+  return ( ( static_cast<uint64_t>( index.x() ) & mask ) << 42 ) |
+         ( ( static_cast<uint64_t>( index.y() ) & mask ) << 21 ) |
+         (   static_cast<uint64_t>( index.z() ) & mask );
+}
+
+
+/**
+ * @brief project projects a point of the optical frame to the nearest distorted pixel.
+ */
+bool TsdfVolume::project( const Eigen::Vector3f& p, int& u, int& v ) const
+{
+  if ( p.z() <= 0.0f )
+    return false;
+
+  const float x  = p.x() / p.z();
+  const float y  = p.y() / p.z();
+  const float r2 = x * x + y * y;
+  const float k  = 1.0f + ( ( camera_.k3 * r2 + camera_.k2 ) * r2 + camera_.k1 ) * r2;
+  const float xd = x * k + 2.0f * camera_.p1 * x * y + camera_.p2 * ( r2 + 2.0f * x * x );
+  const float yd = y * k + camera_.p1 * ( r2 + 2.0f * y * y ) + 2.0f * camera_.p2 * x * y;
+
+  u = static_cast<int>( floorf( camera_.fx * xd + camera_.cx + 0.5f ) );
+  v = static_cast<int>( floorf( camera_.fy * yd + camera_.cy + 0.5f ) );
+
+  return 0 <= u && u < camera_.width && 0 <= v && v < camera_.height;
+}
+
+
+/**
+ * @brief collectBlocks collects the blocks within the truncation band around the
+ * depth of every allocation_stride-th pixel of rows [ row_begin, row_end ).
+ */
+void TsdfVolume::collectBlocks( const uint16_t* depth, const Eigen::Affine3f& world_from_camera,
+                                size_t row_begin, size_t row_end, std::vector<uint64_t>& keys ) const
+{
+  const int   stride      = params_.allocation_stride;
+  const float block_scale = 1.0f / ( params_.voxel_size * BLOCK_SIZE );
+  const float offsets[3]  = { -params_.truncation, 0.0f, params_.truncation };
+
+  keys.clear();
+
+  for ( size_t v = row_begin; v < row_end; v++ )
+  {
+    if ( v % stride != 0 )
+      continue;
+
+    for ( int u = 0; u < camera_.width; u += stride )
+    {
+      const size_t i = v * camera_.width + u;
+      const float  z = depth[i] * 0.001f;
+      if ( z < params_.min_depth || params_.max_depth < z )
+        continue;
+
+      for ( int k = 0; k < 3; k++ )
+      {
+        const float zk = z + offsets[k];
+        if ( zk <= 0.0f )
+          continue;
+
+        Eigen::Vector3f p = world_from_camera * Eigen::Vector3f( zk * ray_x_[i], zk * ray_y_[i], zk );
+        Eigen::Vector3i index( static_cast<int>( floorf( p.x() * block_scale ) ),
+                               static_cast<int>( floorf( p.y() * block_scale ) ),
+                               static_cast<int>( floorf( p.z() * block_scale ) ) );
+        keys.push_back( blockKey( index ) );
+
+        // Neighbor keys repeat along a ray, the sort below removes the rest
+        if ( 2 <= keys.size() && keys[ keys.size() - 2 ] == keys.back() )
+          keys.pop_back();
+      }
+    }
+  }
+
+  std::sort( keys.begin(), keys.end() );
+  keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+}
+
+
+/**
+ * @brief evictBlocks frees up to needed blocks which are not visible in the current
+ * frame, least recently integrated first.
+ */
+void TsdfVolume::evictBlocks( size_t needed )
+{
+  std::vector< std::pair<uint64_t, uint32_t> > candidates;
+  candidates.reserve( hash_.size() );
+
+  for ( std::unordered_map<uint64_t, uint32_t>::const_iterator it = hash_.begin(); it != hash_.end(); ++it )
+  {
+    const Block& block = blocks_[ it->second ];
+    if ( block.last_used < frame_ )
+      candidates.push_back( std::make_pair( block.last_used, it->second ) );
+  }
+
+  needed = std::min( needed, candidates.size() );
+  if ( needed == 0 )
+    return;
+
+  std::nth_element( candidates.begin(), candidates.begin() + ( needed - 1 ), candidates.end() );
+
+  for ( size_t i = 0; i < needed; i++ )
+  {
+    const uint32_t slot = candidates[i].second;
+    hash_.erase( blockKey( blocks_[ slot ].index ) );
+    free_.push_back( slot );
+  }
+  evicted_ += needed;
+}
+
+
+/**
+ * @brief allocateBlocks marks the collected blocks visible, allocating the new ones.
+ */
+void TsdfVolume::allocateBlocks( const std::vector< std::vector<uint64_t> >& keys )
+{
+  std::vector<uint64_t> created;
+
+  visible_.clear();
+  for ( size_t part = 0; part < keys.size(); part++ )
+  {
+    for ( size_t k = 0; k < keys[part].size(); k++ )
+    {
+      std::unordered_map<uint64_t, uint32_t>::const_iterator it = hash_.find( keys[part][k] );
+      if ( it == hash_.end() )
+      {
+        created.push_back( keys[part][k] );
+      }
+      else if ( blocks_[ it->second ].last_used != frame_ )
+      {
+        blocks_[ it->second ].last_used = frame_;
+        visible_.push_back( it->second );
+      }
+    }
+  }
+
+  // Strips overlap at their borders
+  std::sort( created.begin(), created.end() );
+  created.erase( std::unique( created.begin(), created.end() ), created.end() );
+
+  const size_t capacity = params_.max_blocks - hash_.size();
+  if ( capacity < created.size() )
+    evictBlocks( created.size() - capacity );
+
+  if ( blocks_.capacity() < params_.max_blocks )
+    blocks_.reserve( params_.max_blocks );
+
+  for ( size_t k = 0; k < created.size(); k++ )
+  {
+    uint32_t slot;
+    if ( not free_.empty() )
+    {
+      slot = free_.back();
+      free_.pop_back();
+    }
+    else if ( blocks_.size() < params_.max_blocks )
+    {
+      slot = static_cast<uint32_t>( blocks_.size() );
+      blocks_.push_back( Block() );
+    }
+    else
+    {
+      dropped_ += created.size() - k;
+      break;
+    }
+
+    // Unpack the sign extended 21 bit indices
+    const uint64_t key = created[k];
+    Block& block = blocks_[ slot ];
+    block.index = Eigen::Vector3i( static_cast<int32_t>( ( key >> 42 ) << 11 ) >> 11,
+                                   static_cast<int32_t>( ( ( key >> 21 ) & ( ( 1u << 21 ) - 1 ) ) << 11 ) >> 11,
+                                   static_cast<int32_t>( ( key & ( ( 1u << 21 ) - 1 ) ) << 11 ) >> 11 );
+    block.last_used = frame_;
+    for ( int i = 0; i < BLOCK_VOXELS; i++ )
+    {
+      block.voxels[i].tsdf   = 1.0f;
+      block.voxels[i].weight = 0.0f;
+    }
+
+    hash_[ key ] = slot;
+    visible_.push_back( slot );
+  }
+}
+
+
+/**
+ * @brief integrateBlock updates the running average of every voxel of a block
+ * with the projective distance to the depth measured at the voxel pixel.
+ */
+void TsdfVolume::integrateBlock( Block& block, const uint16_t* depth, const Eigen::Affine3f& camera_from_world ) const
+{
+  const float voxel      = params_.voxel_size;
+  const float truncation = params_.truncation;
+  const float inv_trunc  = 1.0f / truncation;
+
+  const Eigen::Vector3f origin = ( block.index.cast<float>() * BLOCK_SIZE + Eigen::Vector3f::Constant( 0.5f ) ) * voxel;
+  const Eigen::Matrix3f step   = camera_from_world.linear() * voxel;
+  const Eigen::Vector3f base   = camera_from_world * origin;
+
+  int i = 0;
+  for ( int z = 0; z < BLOCK_SIZE; z++ )
+  {
+    for ( int y = 0; y < BLOCK_SIZE; y++ )
+    {
+      Eigen::Vector3f p = base + step.col( 1 ) * y + step.col( 2 ) * z;
+
+      for ( int x = 0; x < BLOCK_SIZE; x++, i++, p += step.col( 0 ) )
+      {
+        int u, v;
+        if ( not project( p, u, v ) )
+          continue;
+
+        const float d = depth[ v * camera_.width + u ] * 0.001f;
+        if ( d < params_.min_depth || params_.max_depth < d )
+          continue;
+
+        const float sdf = d - p.z();
+        if ( sdf < -truncation )
+          continue;
+
+        Voxel& voxel_data = block.voxels[i];
+        const float tsdf  = std::min( 1.0f, sdf * inv_trunc );
+        voxel_data.tsdf   = ( voxel_data.tsdf * voxel_data.weight + tsdf ) / ( voxel_data.weight + 1.0f );
+        voxel_data.weight = std::min( voxel_data.weight + 1.0f, params_.max_weight );
+      }
+    }
+  }
+}
+
+
+/**
+ * @brief integrate fuses one depth image taken at a camera pose.
+ */
+void TsdfVolume::integrate( const uint16_t* depth, const Eigen::Affine3f& world_from_camera, ThreadPool* pool )
+{
+  if ( ray_x_.empty() )
+    return;
+
+  frame_++;
+
+  const size_t parts = pool ? pool->size() : 1;
+  keys_.resize( parts );
+
+  std::function<void( size_t )> collect = [&]( size_t part )
+  {
+    size_t begin, end;
+    ThreadPool::splitRange( camera_.height, parts, part, begin, end );
+    collectBlocks( depth, world_from_camera, begin, end, keys_[part] );
+  };
+
+  const Eigen::Affine3f camera_from_world = world_from_camera.inverse();
+
+  std::function<void( size_t )> fuse = [&]( size_t part )
+  {
+    size_t begin, end;
+    ThreadPool::splitRange( visible_.size(), parts, part, begin, end );
+    for ( size_t b = begin; b < end; b++ )
+      integrateBlock( blocks_[ visible_[b] ], depth, camera_from_world );
+  };
+
+  if ( pool )
+    pool->run( parts, collect );
+  else
+    collect( 0 );
+
+  // The hash map is only modified here, on the calling thread
+  allocateBlocks( keys_ );
+
+  if ( pool )
+    pool->run( parts, fuse );
+  else
+    fuse( 0 );
+}
+
+
+const TsdfVolume::Voxel* TsdfVolume::voxelAt( const Eigen::Vector3i& voxel ) const
+{
+  Eigen::Vector3i index( voxel.x() >> 3, voxel.y() >> 3, voxel.z() >> 3 );
+
+  std::unordered_map<uint64_t, uint32_t>::const_iterator it = hash_.find( blockKey( index ) );
+  if ( it == hash_.end() )
+    return NULL;
+
+  Eigen::Vector3i local = voxel - index * BLOCK_SIZE;
+  return &( blocks_[ it->second ].voxels[ ( local.z() * BLOCK_SIZE + local.y() ) * BLOCK_SIZE + local.x() ] );
+}
+
+
+/**
+ * @brief extractCloud returns the zero crossings of the distance field as points in the world.
+ * Every voxel is compared to its +x, +y and +z neighbors, and a sign change between two
+ * observed voxels inside the truncation band gives a linearly interpolated surface point.
+ */
+void TsdfVolume::extractCloud( pcl::PointCloud<pcl::PointXYZ>& cloud, float min_weight ) const
+{
+  cloud.clear();
+
+  const float voxel = params_.voxel_size;
+  min_weight = std::max( min_weight, 1e-3f );
+
+  for ( std::unordered_map<uint64_t, uint32_t>::const_iterator it = hash_.begin(); it != hash_.end(); ++it )
+  {
+    const Block& block = blocks_[ it->second ];
+    const Eigen::Vector3i first = block.index * BLOCK_SIZE;
+
+    int i = 0;
+    for ( int z = 0; z < BLOCK_SIZE; z++ )
+    {
+      for ( int y = 0; y < BLOCK_SIZE; y++ )
+      {
+        for ( int x = 0; x < BLOCK_SIZE; x++, i++ )
+        {
+          const Voxel& v0 = block.voxels[i];
+          if ( v0.weight < min_weight || 1.0f <= fabsf( v0.tsdf ) )
+            continue;
+
+          const int local[3] = { x, y, z };
+          const int stride[3] = { 1, BLOCK_SIZE, BLOCK_SIZE * BLOCK_SIZE };
+
+          for ( int a = 0; a < 3; a++ )
+          {
+            const Voxel* v1;
+            if ( local[a] + 1 < BLOCK_SIZE )
+              v1 = &( block.voxels[ i + stride[a] ] );
+            else
+              v1 = voxelAt( first + Eigen::Vector3i( x, y, z ) + Eigen::Vector3i::Unit( a ) );
+
+            if ( not v1 || v1->weight < min_weight || 1.0f <= fabsf( v1->tsdf ) ||
+                 ( 0.0f < v0.tsdf ) == ( 0.0f < v1->tsdf ) )
+              continue;
+
+            Eigen::Vector3f p = ( ( first + Eigen::Vector3i( x, y, z ) ).cast<float>() + Eigen::Vector3f::Constant( 0.5f ) ) * voxel;
+            p[a] += voxel * v0.tsdf / ( v0.tsdf - v1->tsdf );
+            cloud.push_back( pcl::PointXYZ( p.x(), p.y(), p.z() ) );
+          }
+        }
+      }
+    }
+  }
+
+  cloud.width    = static_cast<uint32_t>( cloud.size() );
+  cloud.height   = 1;
+  cloud.is_dense = true;
+}
+
+};
@@ -0,0 +1,193 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cis_camera/voxel_crop_filter.h"
+
+#include <math.h>
+#include <algorithm>
+
+
+namespace cis_camera
+{
+
+// Voxel indices are packed into a 64 bit key, 21 bits per axis, z major.
+// Sorting by key then gives the same order as the linear index of pcl::VoxelGrid.
+static const int      KEY_BITS   = 21;
+static const int      KEY_OFFSET = 1 << ( KEY_BITS - 1 );
+
+static inline uint64_t packKey( int ix, int iy, int iz )
+{
+  return ( static_cast<uint64_t>( iz + KEY_OFFSET ) << ( 2 * KEY_BITS ) ) |
+         ( static_cast<uint64_t>( iy + KEY_OFFSET ) << KEY_BITS ) |
+           static_cast<uint64_t>( ix + KEY_OFFSET );
+}
+
+
+VoxelCropFilter::VoxelCropFilter() :
+    inverse_leaf_( 100.0f ),
+    crop_min_( -1.0f, -1.0f, -1.0f ),
+    crop_max_(  1.0f,  1.0f,  1.0f )
+{
+  setCrop( crop_min_, crop_max_ );
+}
+
+
+void VoxelCropFilter::setLeafSize( float leaf_size )
+{
+  inverse_leaf_ = 1.0f / leaf_size;
+  setCrop( crop_min_, crop_max_ );
+}
+
+
+void VoxelCropFilter::setCrop( const Eigen::Vector3f& min, const Eigen::Vector3f& max )
+{
+  crop_min_ = min;
+  crop_max_ = max;
+
+  // A voxel can only hold a centroid inside the box if its cell touches the box.
+  // One voxel of margin covers rounding of the index computation.
+  const double limit = KEY_OFFSET - 2;
+
+  for ( int i = 0; i < 3; i++ )
+  {
+    double lo = floor( min[i] * inverse_leaf_ ) - 1.0;
+    double hi = floor( max[i] * inverse_leaf_ ) + 1.0;
+    index_min_[i] = static_cast<int>( std::max( -limit, std::min( limit, lo ) ) );
+    index_max_[i] = static_cast<int>( std::max( -limit, std::min( limit, hi ) ) );
+  }
+}
+
+
+void VoxelCropFilter::hashRange( const Cloud& input, size_t begin, size_t end, VoxelMap& voxels ) const
+{
+  voxels.clear();
+
+  for ( size_t i = begin; i < end; i++ )
+  {
+    const Point& p = input.points[i];
+
+    if ( not pcl_isfinite( p.x ) || not pcl_isfinite( p.y ) || not pcl_isfinite( p.z ) )
+      continue;
+
+    // Same index computation as pcl::VoxelGrid
+    int ix = static_cast<int>( floor( p.x * inverse_leaf_ ) );
+    int iy = static_cast<int>( floor( p.y * inverse_leaf_ ) );
+    int iz = static_cast<int>( floor( p.z * inverse_leaf_ ) );
+
+    if ( ix < index_min_[0] || index_max_[0] < ix ||
+         iy < index_min_[1] || index_max_[1] < iy ||
+         iz < index_min_[2] || index_max_[2] < iz )
+      continue;
+
+    Accumulator& acc = voxels[ packKey( ix, iy, iz ) ];
+    acc.x += p.x;
+    acc.y += p.y;
+    acc.z += p.z;
+    acc.n++;
+  }
+}
+
+
+void VoxelCropFilter::filter( const Cloud& input, Cloud& output, ThreadPool* pool )
+{
+  size_t tasks = pool ? pool->size() : 1;
+  size_t n     = input.points.size();
+
+  if ( n < 4096 )
+    tasks = 1;
+
+  if ( voxels_.size() < tasks )
+    voxels_.resize( tasks );
+
+  if ( tasks == 1 )
+  {
+    hashRange( input, 0, n, voxels_[0] );
+  }
+  else
+  {
+    pool->run( tasks, [&]( size_t task )
+    {
+      size_t begin, end;
+      ThreadPool::splitRange( n, tasks, task, begin, end );
+      hashRange( input, begin, end, voxels_[task] );
+    } );
+  }
+
+  // Merge the per task maps into the first one
+  VoxelMap& voxels = voxels_[0];
+  for ( size_t t = 1; t < tasks; t++ )
+  {
+    for ( VoxelMap::const_iterator it = voxels_[t].begin(); it != voxels_[t].end(); ++it )
+    {
+      Accumulator& acc = voxels[ it->first ];
+      acc.x += it->second.x;
+      acc.y += it->second.y;
+      acc.z += it->second.z;
+      acc.n += it->second.n;
+    }
+  }
+
+  merged_.assign( voxels.begin(), voxels.end() );
+  std::sort( merged_.begin(), merged_.end(),
+             []( const std::pair<uint64_t, Accumulator>& a, const std::pair<uint64_t, Accumulator>& b )
+             { return a.first < b.first; } );
+
+  // Centroids, cropped as pcl::CropBox does (inclusive limits)
+  output.points.resize( merged_.size() );
+
+  size_t count = 0;
+  for ( size_t i = 0; i < merged_.size(); i++ )
+  {
+    const Accumulator& acc = merged_[i].second;
+    float inv_n = 1.0f / acc.n;
+
+    Point c;
+    c.x = static_cast<float>( acc.x ) * inv_n;
+    c.y = static_cast<float>( acc.y ) * inv_n;
+    c.z = static_cast<float>( acc.z ) * inv_n;
+
+    if ( c.x < crop_min_[0] || c.y < crop_min_[1] || c.z < crop_min_[2] ||
+         crop_max_[0] < c.x || crop_max_[1] < c.y || crop_max_[2] < c.z )
+      continue;
+
+    output.points[ count++ ] = c;
+  }
+
+  output.points.resize( count );
+  output.width    = count;
+  output.height   = 1;
+  output.is_dense = true;
+  output.header   = input.header;
+}
+
+};
@@ -0,0 +1,314 @@
+// Copyright (c) 2019, Analog Devices Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+//
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived
+//   from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <vector>
+
+#include "cis_camera/frame_kernels.h"
+#include "cis_camera/pixel_kernels.h"
+
+
+using namespace cis_camera;
+
+namespace
+{
+
+// Sizes which are no multiple of any vector width, so the remainder loops run as well
+const int WIDTH  = 1318;
+const int HEIGHT = 37;
+
+// The float kernels may differ by one level where a compiler fuses multiply-adds in
+// either the scalar or the vector version (e.g. GCC on AArch64), integer kernels are exact
+const int FLOAT_TOLERANCE = 1;
+
+
+/**
+ * @brief vectorKernels returns the kernels of every available level except scalar.
+ */
+std::vector<const PixelKernels*> vectorKernels()
+{
+  std::vector<const PixelKernels*> kernels;
+  
+  for ( int level = CPU_SCALAR + 1; level < CPU_LEVELS; level++ )
+  {
+    const PixelKernels* k = pixelKernels( static_cast<CpuLevel>( level ) );
+    
+    if ( k != NULL )
+      kernels.push_back( k );
+  }
+  
+  return kernels;
+}
+
+
+template <typename T>
+void fillRandom( std::vector<T>& data, int max_value )
+{
+  for ( size_t i = 0; i < data.size(); i++ )
+    data[i] = static_cast<T>( rand() % ( max_value + 1 ) );
+}
+
+
+template <typename T>
+int maxDifference( const std::vector<T>& a, const std::vector<T>& b )
+{
+  int diff = 0;
+  
+  for ( size_t i = 0; i < a.size(); i++ )
+    diff = std::max( diff, abs( static_cast<int>( a[i] ) - static_cast<int>( b[i] ) ) );
+  
+  return diff;
+}
+
+}
+
+
+TEST( PixelKernels, ScalarAlwaysAvailable )
+{
+  ASSERT_TRUE( pixelKernels( CPU_SCALAR ) != NULL );
+  EXPECT_TRUE( pixelKernels( detectCpuLevel() ) != NULL );
+}
+
+
+TEST( PixelKernels, ParseLevelNames )
+{
+  for ( int level = CPU_SCALAR; level < CPU_LEVELS; level++ )
+  {
+    CpuLevel parsed = CPU_LEVELS;
+    EXPECT_TRUE( parseCpuLevel( cpuLevelName( static_cast<CpuLevel>( level ) ), parsed ) );
+    EXPECT_EQ( level, parsed );
+  }
+  
+  CpuLevel parsed = CPU_LEVELS;
+  EXPECT_TRUE( parseCpuLevel( "auto", parsed ) );
+  EXPECT_EQ( detectCpuLevel(), parsed );
+  EXPECT_FALSE( parseCpuLevel( "avx512", parsed ) );
+}
+
+
+TEST( PixelKernels, SelectFallsBackToDetectedLevel )
+{
+  for ( int level = CPU_SCALAR; level < CPU_LEVELS; level++ )
+  {
+    const CpuLevel requested = static_cast<CpuLevel>( level );
+    const CpuLevel expected  = ( pixelKernels( requested ) != NULL ) ? requested : detectCpuLevel();
+    
+    EXPECT_EQ( expected, selectPixelKernels( requested ) );
+    EXPECT_EQ( expected, pixelKernels().level );
+  }
+  
+  selectPixelKernels( detectCpuLevel() );
+}
+
+
+TEST( PixelKernels, CorrectDepthMatchesScalar )
+{
+  const int count = WIDTH * HEIGHT;
+  
+  std::vector<uint16_t> raw( count );
+  std::vector<float>    inv_norm( count );
+  fillRandom( raw, 65535 );
+  raw[0] = 0;
+  raw[1] = 65535;
+  
+  for ( int i = 0; i < count; i++ )
+    inv_norm[i] = 0.8f + 0.2f * ( rand() % 1000 ) / 1000.0f;
+  
+  // Negative offsets and large gains reach both limits of the output
+  const double scales[]  = { 0.5 * 4.0, 0.123 * 4.0, 1.7 * 4.0 };
+  const double offsets[] = { 0.0, -250.0, 37.5 };
+  
+  std::vector<const PixelKernels*> kernels = vectorKernels();
+  
+  for ( size_t k = 0; k < kernels.size(); k++ )
+  {
+    SCOPED_TRACE( cpuLevelName( kernels[k]->level ) );
+    
+    for ( int s = 0; s < 3; s++ )
+    {
+      std::vector<uint16_t> expected( count ), actual( count );
+      correctDepthScalar( &(raw[0]), &(inv_norm[0]), count, scales[s], offsets[s], &(expected[0]) );
+      kernels[k]->correct_depth( &(raw[0]), &(inv_norm[0]), count, scales[s], offsets[s], &(actual[0]) );
+      
+      EXPECT_LE( maxDifference( expected, actual ), FLOAT_TOLERANCE );
+    }
+  }
+}
+
+
+TEST( PixelKernels, ConvertUYVYMatchesScalar )
+{
+  std::vector<uint16_t> uyvy( WIDTH * HEIGHT );
+  fillRandom( uyvy, 65535 );
+  
+  const ColorGains gains( 1.3f, 0.9f, 1.1f );
+  const int        dst_step = WIDTH * 3;
+  
+  std::vector<const PixelKernels*> kernels = vectorKernels();
+  
+  for ( size_t k = 0; k < kernels.size(); k++ )
+  {
+    SCOPED_TRACE( cpuLevelName( kernels[k]->level ) );
+    
+    // Full rows and a crop with a stride, like the color part of the frame
+    const int widths[] = { WIDTH, WIDTH - 302 };
+    
+    for ( int w = 0; w < 2; w++ )
+    {
+      std::vector<uint8_t> expected( dst_step * HEIGHT, 0 ), actual( dst_step * HEIGHT, 0 );
+      convertUYVYToBGR8Scalar( &(uyvy[0]), WIDTH, widths[w], HEIGHT, gains, &(expected[0]), dst_step );
+      kernels[k]->convert_uyvy( &(uyvy[0]), WIDTH, widths[w], HEIGHT, gains, &(actual[0]), dst_step );
+      
+      EXPECT_LE( maxDifference( expected, actual ), FLOAT_TOLERANCE );
+    }
+  }
+}
+
+
+TEST( PixelKernels, BinUYVYMatchesScalar )
+{
+  std::vector<uint16_t> uyvy( WIDTH * HEIGHT );
+  fillRandom( uyvy, 65535 );
+  
+  const ColorGains gains( 1.3f, 0.9f, 1.1f );
+  
+  std::vector<const PixelKernels*> kernels = vectorKernels();
+  
+  for ( size_t k = 0; k < kernels.size(); k++ )
+  {
+    SCOPED_TRACE( cpuLevelName( kernels[k]->level ) );
+    
+    for ( int factor = 2; factor <= 4; factor++ )
+    {
+      const int dst_step = ( WIDTH / factor ) * 3;
+      
+      std::vector<uint8_t> expected( dst_step * ( HEIGHT / factor ), 0 ), actual( dst_step * ( HEIGHT / factor ), 0 );
+      binUYVYToBGR8Scalar( &(uyvy[0]), WIDTH, WIDTH, HEIGHT, factor, gains, &(expected[0]), dst_step );
+      kernels[k]->bin_uyvy( &(uyvy[0]), WIDTH, WIDTH, HEIGHT, factor, gains, &(actual[0]), dst_step );
+      
+      EXPECT_LE( maxDifference( expected, actual ), FLOAT_TOLERANCE ) << "factor " << factor;
+    }
+  }
+}
+
+
+TEST( PixelKernels, TileSADMatchesScalar )
+{
+  std::vector<uint16_t> a( WIDTH * HEIGHT ), b( WIDTH * HEIGHT );
+  fillRandom( a, 65535 );
+  fillRandom( b, 65535 );
+  
+  const int tiles = ( ( WIDTH  + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE ) *
+                    ( ( HEIGHT + CHANGE_TILE_SIZE - 1 ) / CHANGE_TILE_SIZE );
+  
+  std::vector<const PixelKernels*> kernels = vectorKernels();
+  
+  for ( size_t k = 0; k < kernels.size(); k++ )
+  {
+    SCOPED_TRACE( cpuLevelName( kernels[k]->level ) );
+    
+    std::vector<uint32_t> expected( tiles, 1 ), actual( tiles, 1 );
+    computeTileSADScalar( &(a[0]), &(b[0]), WIDTH, HEIGHT, &(expected[0]) );
+    kernels[k]->tile_sad( &(a[0]), &(b[0]), WIDTH, HEIGHT, &(actual[0]) );
+    
+    EXPECT_EQ( expected, actual );
+  }
+}
+
+
+TEST( FrameKernels, FixedLayoutMatchesGeneric )
+{
+  const FrameGeometry geometry( DefaultFrameLayout::FRAME_WIDTH, DefaultFrameLayout::FRAME_HEIGHT,
+                                DefaultFrameLayout::COLOR_WIDTH );
+  const int depth_pixels = geometry.depthWidth() * geometry.depthHeight();
+  const int color_step   = geometry.color_width * 3;
+  
+  std::vector<uint16_t> frame( geometry.frame_width * geometry.frame_height );
+  std::vector<float>    inv_norm( depth_pixels, 0.9f );
+  fillRandom( frame, 65535 );
+  
+  const ColorGains gains( 1.3f, 0.9f, 1.1f );
+  
+  // Other geometries always take the generic kernels
+  EXPECT_EQ( &genericFrameKernels(), &frameKernels( FrameGeometry( 1920, 960, 1272 ) ) );
+  
+  for ( int level = CPU_SCALAR; level < CPU_LEVELS; level++ )
+  {
+    if ( pixelKernels( static_cast<CpuLevel>( level ) ) == NULL )
+      continue;
+    
+    SCOPED_TRACE( cpuLevelName( static_cast<CpuLevel>( level ) ) );
+    selectPixelKernels( static_cast<CpuLevel>( level ) );
+    
+    const FrameKernels& generic = genericFrameKernels();
+    const FrameKernels& fixed   = frameKernels( geometry );
+    
+    std::vector<uint8_t> expected( color_step * geometry.frame_height ), actual( color_step * geometry.frame_height );
+    generic.convert_color( &(frame[0]), geometry, gains, &(expected[0]), color_step );
+    fixed.convert_color( &(frame[0]), geometry, gains, &(actual[0]), color_step );
+    EXPECT_EQ( expected, actual );
+    
+    // Only factor 2 has a specialized version, the others fall back to the generic one
+    for ( int factor = 2; factor <= 4; factor++ )
+    {
+      generic.bin_color( &(frame[0]), geometry, factor, gains, &(expected[0]), color_step / factor );
+      fixed.bin_color( &(frame[0]), geometry, factor, gains, &(actual[0]), color_step / factor );
+      EXPECT_EQ( expected, actual ) << "factor " << factor;
+    }
+    
+    std::vector<uint16_t> depth_expected( depth_pixels ), depth_actual( depth_pixels );
+    std::vector<uint16_t> ir_expected( depth_pixels ), ir_actual( depth_pixels );
+    generic.deinterlace( &(frame[0]), geometry, &(inv_norm[0]), 2.0, -10.0, &(depth_expected[0]), &(ir_expected[0]) );
+    fixed.deinterlace( &(frame[0]), geometry, &(inv_norm[0]), 2.0, -10.0, &(depth_actual[0]), &(ir_actual[0]) );
+    EXPECT_EQ( depth_expected, depth_actual );
+    EXPECT_EQ( ir_expected, ir_actual );
+    
+    // The IR rows are the odd rows of the depth part of the frame
+    EXPECT_EQ( frame[ geometry.frame_width + geometry.color_width ], ir_actual[0] );
+  }
+  
+  selectPixelKernels( detectCpuLevel() );
+}
+
+
+int main( int argc, char** argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  srand( 49 );
+  
+  return RUN_ALL_TESTS();
+}